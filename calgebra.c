@@ -5,10 +5,27 @@
 
 #include "calgebra.h"
 
+#include <fcntl.h>
+#include <float.h>
+#include <limits.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define has_x86_simd
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#define has_neon
+#include <arm_neon.h>
+#endif
 
 #define true  1
 #define false 0
@@ -20,7 +37,7 @@
 
 // Public globals.
 
-const char *alg__err_str = NULL;
+_Thread_local const char *alg__err_str = NULL;
 
 
 // Internal types and globals.
@@ -30,7 +47,7 @@ typedef enum {
   phase2
 } Phase;
 
-static int dbg_verbosity = 0;
+static _Thread_local int dbg_verbosity = 0;
 
 // Internal functions.
 
@@ -41,230 +58,4993 @@ static int dbg_verbosity = 0;
 #define data_size(nrows, ncols) (sizeof(float) * nrows * ncols)
 #define num_cols(A) (A->is_transposed ? A->nrows : A->ncols)
 #define num_rows(A) (A->is_transposed ? A->ncols : A->nrows)
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
 #define elt(A, i, j) alg__elt(A, i, j)
 #define col_elt(A, i) elt(A, i, 0)
 
-// This sets the given entry to 1 by scaling its row
-// and clears the rest of its column with row operations.
-// The given entry is expected to be nonzero.
-static void make_col_a_01_col(alg__Mat A, int row, int col) {
-  // Normalize the row so that A_{row,col} = 1.
-  float scale = 1.0 / elt(A, row, col);
-  A->is_transposed = !A->is_transposed;
-  alg__scale(scale, A, row);
-  A->is_transposed = !A->is_transposed;
-  elt(A, row, col) = 1;  // Avoid precision errors.
+// Entry (i, j) of M in double precision, from data64 when M keeps it.
+#define elt64(M, i, j) ((M)->data64 ? alg__elt64(M, i, j) : (double)elt(M, i, j))
 
-  // Zero out all other entries in the col.
-  int n = num_rows(A);
-  A->is_transposed = true;
-  for (int r = 0; r < n; ++r) {
-    if (r == row) continue;
-    alg__mul_and_add(-elt(A, col, r), A, row, A, r);
-    // Set the same-column element explicitly to 0 to avoid precision errors.
-    elt(A, col, r) = 0;
+// Vector kernels.
+//
+// These are the level-1 operations on n floats at strides incx and incy.
+// Unit stride calls go to SIMD versions chosen once at runtime for the CPU -
+// AVX-512, AVX2 with FMA, or NEON - and other strides, along with CPUs
+// without these, use portable loops with several independent accumulators.
+
+// The 4x4 kernels work on a tile of four vectors against four others, so
+// that each vector is loaded once for four multiply-adds. The gemm tile is
+// the inner kernel of the matrix product; see gemm below.
+typedef struct {
+  float (*dot)  (int n, const float *x, const float *y);
+  void  (*axpy) (int n, float a, const float *x, float *y);
+  void  (*scal) (int n, float a, float *x);
+  void  (*dot4x4) (int n, const float *const *x, const float *const *y, float *out);
+  void  (*axpy4x4)(int n, const float *a, const float *const *x, float *const *y);
+  void  (*gemm_tile)(int k, const float *a, const float *b, float *c);
+} VecKernels;
+
+// A gemm tile is gemm_mr x gemm_nr; its accumulators fill most of the
+// vector registers of each of the SIMD instruction sets.
+#define gemm_mr 6
+#define gemm_nr 16
+
+static float dot_scalar(int n, const float *x, const float *y) {
+  float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+  int k = 0;
+  for (; k + 4 <= n; k += 4) {
+    s0 += x[k + 0] * y[k + 0];
+    s1 += x[k + 1] * y[k + 1];
+    s2 += x[k + 2] * y[k + 2];
+    s3 += x[k + 3] * y[k + 3];
   }
-  A->is_transposed = false;
+  for (; k < n; ++k) s0 += x[k] * y[k];
+  return (s0 + s1) + (s2 + s3);
 }
 
-static alg__Status apply_lp(alg__Mat tab, Phase phase) {
+static void axpy_scalar(int n, float a, const float *x, float *y) {
+  for (int k = 0; k < n; ++k) y[k] += a * x[k];
+}
 
-  dbg_printf("At start of apply_lp (phase %d), tableau is:\n",
-             phase == phase1 ? 1 : 2);
-  dbg_print_matrix(tab);
+static void scal_scalar(int n, float a, float *x) {
+  for (int k = 0; k < n; ++k) x[k] *= a;
+}
 
+// Sets out[4 * i + j] = <x[i], y[j]> for i, j < 4.
+static void dot4x4_scalar(int n, const float *const *x, const float *const *y, float *out) {
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 4; ++j) out[4 * i + j] = dot_scalar(n, x[i], y[j]);
+  }
+}
 
-  int pivot_row_start = (phase == phase1 ? 2 : 1);
-  int last_col = num_cols(tab) - 1;
+// Sets y[j] += sum_i a[4 * i + j] * x[i] for i, j < 4.
+static void axpy4x4_scalar(int n, const float *a, const float *const *x, float *const *y) {
+  for (int j = 0; j < 4; ++j) {
+    float *y_j = y[j];
+    for (int k = 0; k < n; ++k) {
+      y_j[k] += a[j] * x[0][k] + a[4 + j] * x[1][k] + a[8 + j] * x[2][k] + a[12 + j] * x[3][k];
+    }
+  }
+}
 
-  // In phase 1, we start by clearing the columns of the artificial variables.
-  if (phase == phase1) {
-    for (int c = 2; c < num_rows(tab); ++c) {
-      make_col_a_01_col(tab, c, c);
-      dbg_printf("After clearing column %d, tableau is:\n", c);
-      dbg_print_matrix(tab);
+// Sets the gemm_mr x gemm_nr row-major tile c to the product of the packed
+// panels a, with gemm_mr entries per step, and b, with gemm_nr per step.
+static void gemm_tile_scalar(int k, const float *a, const float *b, float *c) {
+  float acc[gemm_mr * gemm_nr] = {0};
+  for (int p = 0; p < k; ++p, a += gemm_mr, b += gemm_nr) {
+    for (int i = 0; i < gemm_mr; ++i) {
+      for (int j = 0; j < gemm_nr; ++j) acc[i * gemm_nr + j] += a[i] * b[j];
     }
   }
+  memcpy(c, acc, sizeof(acc));
+}
 
-  while (true) {
-    int pivot_col = 1;
-    for (; pivot_col < last_col && elt(tab, 0, pivot_col) < tol; ++pivot_col);
-    if (pivot_col == last_col) return alg__status_ok;
+#ifdef has_x86_simd
 
-    // Now tab_{0, pivot_col} is the 1st positive entry, ignoring tab_0,0, in the top row.
-    int   pivot_row = -1;
-    float pivot_ratio;
-    for (int r = pivot_row_start; r < num_rows(tab); ++r) {
-      if (elt(tab, r, pivot_col) < tol) continue;
-      float r_ratio = elt(tab, r, last_col) / elt(tab, r, pivot_col);
-      if (pivot_row == -1 || r_ratio < pivot_ratio) {
-        pivot_row   = r;
-        pivot_ratio = r_ratio;
-      }
+__attribute__((target("avx2,fma")))
+static float dot_avx2(int n, const float *x, const float *y) {
+  __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+  int k = 0;
+  for (; k + 16 <= n; k += 16) {
+    s0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + k),     _mm256_loadu_ps(y + k),     s0);
+    s1 = _mm256_fmadd_ps(_mm256_loadu_ps(x + k + 8), _mm256_loadu_ps(y + k + 8), s1);
+  }
+  for (; k + 8 <= n; k += 8) {
+    s0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + k), _mm256_loadu_ps(y + k), s0);
+  }
+  s0 = _mm256_add_ps(s0, s1);
+  __m128 h = _mm_add_ps(_mm256_castps256_ps128(s0), _mm256_extractf128_ps(s0, 1));
+  h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+  h = _mm_add_ss(h, _mm_movehdup_ps(h));
+  float sum = _mm_cvtss_f32(h);
+  for (; k < n; ++k) sum += x[k] * y[k];
+  return sum;
+}
+
+__attribute__((target("avx2,fma")))
+static void axpy_avx2(int n, float a, const float *x, float *y) {
+  __m256 av = _mm256_set1_ps(a);
+  int k = 0;
+  for (; k + 8 <= n; k += 8) {
+    _mm256_storeu_ps(y + k, _mm256_fmadd_ps(av, _mm256_loadu_ps(x + k), _mm256_loadu_ps(y + k)));
+  }
+  for (; k < n; ++k) y[k] += a * x[k];
+}
+
+__attribute__((target("avx2,fma")))
+static void scal_avx2(int n, float a, float *x) {
+  __m256 av = _mm256_set1_ps(a);
+  int k = 0;
+  for (; k + 8 <= n; k += 8) _mm256_storeu_ps(x + k, _mm256_mul_ps(av, _mm256_loadu_ps(x + k)));
+  for (; k < n; ++k) x[k] *= a;
+}
+
+__attribute__((target("avx2,fma")))
+static float hsum_avx2(__m256 v) {
+  __m128 h = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  h = _mm_add_ps(h, _mm_movehl_ps(h, h));
+  h = _mm_add_ss(h, _mm_movehdup_ps(h));
+  return _mm_cvtss_f32(h);
+}
+
+__attribute__((target("avx2,fma")))
+static void dot4x4_avx2(int n, const float *const *x, const float *const *y, float *out) {
+  const float *x0 = x[0], *x1 = x[1], *x2 = x[2], *x3 = x[3];
+  const float *y0 = y[0], *y1 = y[1], *y2 = y[2], *y3 = y[3];
+  __m256 s[16];
+  for (int t = 0; t < 16; ++t) s[t] = _mm256_setzero_ps();
+  int k = 0;
+  for (; k + 8 <= n; k += 8) {
+    __m256 yv0 = _mm256_loadu_ps(y0 + k), yv1 = _mm256_loadu_ps(y1 + k);
+    __m256 yv2 = _mm256_loadu_ps(y2 + k), yv3 = _mm256_loadu_ps(y3 + k);
+    __m256 xv[4] = { _mm256_loadu_ps(x0 + k), _mm256_loadu_ps(x1 + k),
+                     _mm256_loadu_ps(x2 + k), _mm256_loadu_ps(x3 + k) };
+    for (int i = 0; i < 4; ++i) {
+      s[4 * i + 0] = _mm256_fmadd_ps(xv[i], yv0, s[4 * i + 0]);
+      s[4 * i + 1] = _mm256_fmadd_ps(xv[i], yv1, s[4 * i + 1]);
+      s[4 * i + 2] = _mm256_fmadd_ps(xv[i], yv2, s[4 * i + 2]);
+      s[4 * i + 3] = _mm256_fmadd_ps(xv[i], yv3, s[4 * i + 3]);
     }
-    if (pivot_row == -1) {
-      alg__err_str = unbdd_soln_str;
-      return alg__status_unbdd_soln;
+  }
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      float sum = hsum_avx2(s[4 * i + j]);
+      for (int t = k; t < n; ++t) sum += x[i][t] * y[j][t];
+      out[4 * i + j] = sum;
     }
+  }
+}
 
-    dbg_printf("pivot is (0-indexed) row=%d, col=%d\n", pivot_row, pivot_col);
-    make_col_a_01_col(tab, pivot_row, pivot_col);
-    dbg_printf("After an iteration, the tableau is:\n");
-    dbg_print_matrix(tab);
+__attribute__((target("avx2,fma")))
+static void axpy4x4_avx2(int n, const float *a, const float *const *x, float *const *y) {
+  const float *x0 = x[0], *x1 = x[1], *x2 = x[2], *x3 = x[3];
+  float *y_ptrs[4] = { y[0], y[1], y[2], y[3] };
+  __m256 av[16];
+  for (int t = 0; t < 16; ++t) av[t] = _mm256_set1_ps(a[t]);
+  int k = 0;
+  for (; k + 8 <= n; k += 8) {
+    __m256 xv0 = _mm256_loadu_ps(x0 + k), xv1 = _mm256_loadu_ps(x1 + k);
+    __m256 xv2 = _mm256_loadu_ps(x2 + k), xv3 = _mm256_loadu_ps(x3 + k);
+    for (int j = 0; j < 4; ++j) {
+      __m256 yv = _mm256_loadu_ps(y_ptrs[j] + k);
+      yv = _mm256_fmadd_ps(av[j],      xv0, yv);
+      yv = _mm256_fmadd_ps(av[4 + j],  xv1, yv);
+      yv = _mm256_fmadd_ps(av[8 + j],  xv2, yv);
+      yv = _mm256_fmadd_ps(av[12 + j], xv3, yv);
+      _mm256_storeu_ps(y_ptrs[j] + k, yv);
+    }
+  }
+  for (; k < n; ++k) {
+    for (int j = 0; j < 4; ++j) {
+      y_ptrs[j][k] += a[j] * x0[k] + a[4 + j] * x1[k] + a[8 + j] * x2[k] + a[12 + j] * x3[k];
+    }
   }
 }
 
-// Accepts a matrix A and allocates a new one, A2, that's caller-owned.
-// Each implied variable x_i of A, corresponding to each column of A,
-// is split into a positive and negative part: x_i = x^+_i - x^-_i in A2.
-// So A2 is twice is wide as A. A2 is the return value.
-static alg__Mat convert_to_restricted_vars(alg__Mat A) {
-  alg__Mat A2 = alg__alloc_matrix(num_rows(A), 2 * num_cols(A));
-  for (int r = 0; r < num_rows(A); ++r) {
-    for (int c = 0; c < num_cols(A); ++c) {
-      float src_val = elt(A, r, c);
-      elt(A2, r, 2 * c + 0) =  src_val;
-      elt(A2, r, 2 * c + 1) = -src_val;
+__attribute__((target("avx2,fma")))
+static void gemm_tile_avx2(int k, const float *a, const float *b, float *c) {
+  __m256 c0[gemm_mr], c1[gemm_mr];
+  for (int i = 0; i < gemm_mr; ++i) c0[i] = c1[i] = _mm256_setzero_ps();
+  for (int p = 0; p < k; ++p, a += gemm_mr, b += gemm_nr) {
+    __m256 b0 = _mm256_loadu_ps(b), b1 = _mm256_loadu_ps(b + 8);
+    for (int i = 0; i < gemm_mr; ++i) {
+      __m256 a_i = _mm256_broadcast_ss(a + i);
+      c0[i] = _mm256_fmadd_ps(a_i, b0, c0[i]);
+      c1[i] = _mm256_fmadd_ps(a_i, b1, c1[i]);
     }
   }
-  return A2;
+  for (int i = 0; i < gemm_mr; ++i) {
+    _mm256_storeu_ps(c + i * gemm_nr,     c0[i]);
+    _mm256_storeu_ps(c + i * gemm_nr + 8, c1[i]);
+  }
 }
 
+// The AVX-512 versions handle the tail of each vector with a masked load.
 
-// Public functions.
+__attribute__((target("avx512f")))
+static float dot_avx512(int n, const float *x, const float *y) {
+  __m512 s0 = _mm512_setzero_ps(), s1 = _mm512_setzero_ps();
+  int k = 0;
+  for (; k + 32 <= n; k += 32) {
+    s0 = _mm512_fmadd_ps(_mm512_loadu_ps(x + k),      _mm512_loadu_ps(y + k),      s0);
+    s1 = _mm512_fmadd_ps(_mm512_loadu_ps(x + k + 16), _mm512_loadu_ps(y + k + 16), s1);
+  }
+  for (; k < n; k += 16) {
+    __mmask16 m = (n - k >= 16 ? 0xffff : (__mmask16)((1u << (n - k)) - 1));
+    s0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, x + k), _mm512_maskz_loadu_ps(m, y + k), s0);
+  }
+  return _mm512_reduce_add_ps(_mm512_add_ps(s0, s1));
+}
 
-// 1. Create. copy, destroy, or print a matrix.
+__attribute__((target("avx512f")))
+static void axpy_avx512(int n, float a, const float *x, float *y) {
+  __m512 av = _mm512_set1_ps(a);
+  for (int k = 0; k < n; k += 16) {
+    __mmask16 m = (n - k >= 16 ? 0xffff : (__mmask16)((1u << (n - k)) - 1));
+    __m512 yv = _mm512_fmadd_ps(av, _mm512_maskz_loadu_ps(m, x + k), _mm512_maskz_loadu_ps(m, y + k));
+    _mm512_mask_storeu_ps(y + k, m, yv);
+  }
+}
 
-alg__Mat alg__alloc_matrix(int nrows, int ncols) {
-  alg__Mat M = malloc(sizeof(alg__MatStruct));
+__attribute__((target("avx512f")))
+static void scal_avx512(int n, float a, float *x) {
+  __m512 av = _mm512_set1_ps(a);
+  for (int k = 0; k < n; k += 16) {
+    __mmask16 m = (n - k >= 16 ? 0xffff : (__mmask16)((1u << (n - k)) - 1));
+    _mm512_mask_storeu_ps(x + k, m, _mm512_mul_ps(av, _mm512_maskz_loadu_ps(m, x + k)));
+  }
+}
+
+__attribute__((target("avx512f")))
+static void dot4x4_avx512(int n, const float *const *x, const float *const *y, float *out) {
+  const float *x0 = x[0], *x1 = x[1], *x2 = x[2], *x3 = x[3];
+  const float *y0 = y[0], *y1 = y[1], *y2 = y[2], *y3 = y[3];
+  __m512 s[16];
+  for (int t = 0; t < 16; ++t) s[t] = _mm512_setzero_ps();
+  for (int k = 0; k < n; k += 16) {
+    __mmask16 m = (n - k >= 16 ? 0xffff : (__mmask16)((1u << (n - k)) - 1));
+    __m512 yv0 = _mm512_maskz_loadu_ps(m, y0 + k), yv1 = _mm512_maskz_loadu_ps(m, y1 + k);
+    __m512 yv2 = _mm512_maskz_loadu_ps(m, y2 + k), yv3 = _mm512_maskz_loadu_ps(m, y3 + k);
+    __m512 xv[4] = { _mm512_maskz_loadu_ps(m, x0 + k), _mm512_maskz_loadu_ps(m, x1 + k),
+                     _mm512_maskz_loadu_ps(m, x2 + k), _mm512_maskz_loadu_ps(m, x3 + k) };
+    for (int i = 0; i < 4; ++i) {
+      s[4 * i + 0] = _mm512_fmadd_ps(xv[i], yv0, s[4 * i + 0]);
+      s[4 * i + 1] = _mm512_fmadd_ps(xv[i], yv1, s[4 * i + 1]);
+      s[4 * i + 2] = _mm512_fmadd_ps(xv[i], yv2, s[4 * i + 2]);
+      s[4 * i + 3] = _mm512_fmadd_ps(xv[i], yv3, s[4 * i + 3]);
+    }
+  }
+  for (int t = 0; t < 16; ++t) out[t] = _mm512_reduce_add_ps(s[t]);
+}
+
+__attribute__((target("avx512f")))
+static void axpy4x4_avx512(int n, const float *a, const float *const *x, float *const *y) {
+  const float *x0 = x[0], *x1 = x[1], *x2 = x[2], *x3 = x[3];
+  float *y_ptrs[4] = { y[0], y[1], y[2], y[3] };
+  __m512 av[16];
+  for (int t = 0; t < 16; ++t) av[t] = _mm512_set1_ps(a[t]);
+  for (int k = 0; k < n; k += 16) {
+    __mmask16 m = (n - k >= 16 ? 0xffff : (__mmask16)((1u << (n - k)) - 1));
+    __m512 xv0 = _mm512_maskz_loadu_ps(m, x0 + k), xv1 = _mm512_maskz_loadu_ps(m, x1 + k);
+    __m512 xv2 = _mm512_maskz_loadu_ps(m, x2 + k), xv3 = _mm512_maskz_loadu_ps(m, x3 + k);
+    for (int j = 0; j < 4; ++j) {
+      __m512 yv = _mm512_maskz_loadu_ps(m, y_ptrs[j] + k);
+      yv = _mm512_fmadd_ps(av[j],      xv0, yv);
+      yv = _mm512_fmadd_ps(av[4 + j],  xv1, yv);
+      yv = _mm512_fmadd_ps(av[8 + j],  xv2, yv);
+      yv = _mm512_fmadd_ps(av[12 + j], xv3, yv);
+      _mm512_mask_storeu_ps(y_ptrs[j] + k, m, yv);
+    }
+  }
+}
+
+// Even and odd steps go to separate accumulators, as one row of the tile
+// fits in a single register.
+__attribute__((target("avx512f")))
+static void gemm_tile_avx512(int k, const float *a, const float *b, float *c) {
+  __m512 c0[gemm_mr], c1[gemm_mr];
+  for (int i = 0; i < gemm_mr; ++i) c0[i] = c1[i] = _mm512_setzero_ps();
+  int p = 0;
+  for (; p + 2 <= k; p += 2, a += 2 * gemm_mr, b += 2 * gemm_nr) {
+    __m512 b0 = _mm512_loadu_ps(b), b1 = _mm512_loadu_ps(b + gemm_nr);
+    for (int i = 0; i < gemm_mr; ++i) {
+      c0[i] = _mm512_fmadd_ps(_mm512_set1_ps(a[i]),           b0, c0[i]);
+      c1[i] = _mm512_fmadd_ps(_mm512_set1_ps(a[gemm_mr + i]), b1, c1[i]);
+    }
+  }
+  if (p < k) {
+    __m512 b0 = _mm512_loadu_ps(b);
+    for (int i = 0; i < gemm_mr; ++i) c0[i] = _mm512_fmadd_ps(_mm512_set1_ps(a[i]), b0, c0[i]);
+  }
+  for (int i = 0; i < gemm_mr; ++i) _mm512_storeu_ps(c + i * gemm_nr, _mm512_add_ps(c0[i], c1[i]));
+}
+
+#endif  // has_x86_simd
+
+#ifdef has_neon
+
+static float dot_neon(int n, const float *x, const float *y) {
+  float32x4_t s0 = vdupq_n_f32(0), s1 = vdupq_n_f32(0);
+  int k = 0;
+  for (; k + 8 <= n; k += 8) {
+    s0 = vfmaq_f32(s0, vld1q_f32(x + k),     vld1q_f32(y + k));
+    s1 = vfmaq_f32(s1, vld1q_f32(x + k + 4), vld1q_f32(y + k + 4));
+  }
+  float sum = vaddvq_f32(vaddq_f32(s0, s1));
+  for (; k < n; ++k) sum += x[k] * y[k];
+  return sum;
+}
+
+static void axpy_neon(int n, float a, const float *x, float *y) {
+  int k = 0;
+  for (; k + 4 <= n; k += 4) vst1q_f32(y + k, vfmaq_n_f32(vld1q_f32(y + k), vld1q_f32(x + k), a));
+  for (; k < n; ++k) y[k] += a * x[k];
+}
+
+static void scal_neon(int n, float a, float *x) {
+  int k = 0;
+  for (; k + 4 <= n; k += 4) vst1q_f32(x + k, vmulq_n_f32(vld1q_f32(x + k), a));
+  for (; k < n; ++k) x[k] *= a;
+}
+
+static void dot4x4_neon(int n, const float *const *x, const float *const *y, float *out) {
+  float32x4_t s[16];
+  for (int t = 0; t < 16; ++t) s[t] = vdupq_n_f32(0);
+  int k = 0;
+  for (; k + 4 <= n; k += 4) {
+    float32x4_t yv[4];
+    for (int j = 0; j < 4; ++j) yv[j] = vld1q_f32(y[j] + k);
+    for (int i = 0; i < 4; ++i) {
+      float32x4_t xv = vld1q_f32(x[i] + k);
+      for (int j = 0; j < 4; ++j) s[4 * i + j] = vfmaq_f32(s[4 * i + j], xv, yv[j]);
+    }
+  }
+  for (int i = 0; i < 4; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      float sum = vaddvq_f32(s[4 * i + j]);
+      for (int t = k; t < n; ++t) sum += x[i][t] * y[j][t];
+      out[4 * i + j] = sum;
+    }
+  }
+}
+
+static void axpy4x4_neon(int n, const float *a, const float *const *x, float *const *y) {
+  const float *x0 = x[0], *x1 = x[1], *x2 = x[2], *x3 = x[3];
+  float *y_ptrs[4] = { y[0], y[1], y[2], y[3] };
+  int k = 0;
+  for (; k + 4 <= n; k += 4) {
+    float32x4_t xv0 = vld1q_f32(x0 + k), xv1 = vld1q_f32(x1 + k);
+    float32x4_t xv2 = vld1q_f32(x2 + k), xv3 = vld1q_f32(x3 + k);
+    for (int j = 0; j < 4; ++j) {
+      float32x4_t yv = vld1q_f32(y_ptrs[j] + k);
+      yv = vfmaq_n_f32(yv, xv0, a[j]);
+      yv = vfmaq_n_f32(yv, xv1, a[4 + j]);
+      yv = vfmaq_n_f32(yv, xv2, a[8 + j]);
+      yv = vfmaq_n_f32(yv, xv3, a[12 + j]);
+      vst1q_f32(y_ptrs[j] + k, yv);
+    }
+  }
+  for (; k < n; ++k) {
+    for (int j = 0; j < 4; ++j) {
+      y_ptrs[j][k] += a[j] * x0[k] + a[4 + j] * x1[k] + a[8 + j] * x2[k] + a[12 + j] * x3[k];
+    }
+  }
+}
+
+static void gemm_tile_neon(int k, const float *a, const float *b, float *c) {
+  float32x4_t acc[gemm_mr * 4];
+  for (int t = 0; t < gemm_mr * 4; ++t) acc[t] = vdupq_n_f32(0);
+  for (int p = 0; p < k; ++p, a += gemm_mr, b += gemm_nr) {
+    float32x4_t bv[4] = { vld1q_f32(b), vld1q_f32(b + 4), vld1q_f32(b + 8), vld1q_f32(b + 12) };
+    for (int i = 0; i < gemm_mr; ++i) {
+      for (int t = 0; t < 4; ++t) acc[4 * i + t] = vfmaq_n_f32(acc[4 * i + t], bv[t], a[i]);
+    }
+  }
+  for (int t = 0; t < gemm_mr * 4; ++t) vst1q_f32(c + 4 * t, acc[t]);
+}
+
+#endif  // has_neon
+
+static VecKernels     vec_kernels = { dot_scalar, axpy_scalar, scal_scalar, dot4x4_scalar,
+                                      axpy4x4_scalar, gemm_tile_scalar };
+static pthread_once_t vec_kernels_once = PTHREAD_ONCE_INIT;
+
+static void choose_vec_kernels() {
+#ifdef has_x86_simd
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    vec_kernels = (VecKernels) { dot_avx512, axpy_avx512, scal_avx512, dot4x4_avx512,
+                                  axpy4x4_avx512, gemm_tile_avx512 };
+  } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    vec_kernels = (VecKernels) { dot_avx2, axpy_avx2, scal_avx2, dot4x4_avx2,
+                                  axpy4x4_avx2, gemm_tile_avx2 };
+  }
+#elif defined(has_neon)
+  vec_kernels = (VecKernels) { dot_neon, axpy_neon, scal_neon, dot4x4_neon,
+                                axpy4x4_neon, gemm_tile_neon };
+#endif
+}
+
+static VecKernels *get_vec_kernels() {
+  pthread_once(&vec_kernels_once, choose_vec_kernels);
+  return &vec_kernels;
+}
+
+static float vec_dot(int n, const float *x, int incx, const float *y, int incy) {
+  if (incx == 1 && incy == 1) return get_vec_kernels()->dot(n, x, y);
+  float s0 = 0, s1 = 0;
+  int k = 0;
+  for (; k + 2 <= n; k += 2) {
+    s0 += x[k * incx] * y[k * incy];
+    s1 += x[(k + 1) * incx] * y[(k + 1) * incy];
+  }
+  if (k < n) s0 += x[k * incx] * y[k * incy];
+  return s0 + s1;
+}
+
+// Sets y += a * x.
+static void vec_axpy(int n, float a, const float *x, int incx, float *y, int incy) {
+  if (incx == 1 && incy == 1) {
+    get_vec_kernels()->axpy(n, a, x, y);
+    return;
+  }
+  for (int k = 0; k < n; ++k) y[k * incy] += a * x[k * incx];
+}
+
+static void vec_scal(int n, float a, float *x, int incx) {
+  if (incx == 1) {
+    get_vec_kernels()->scal(n, a, x);
+    return;
+  }
+  for (int k = 0; k < n; ++k) x[k * incx] *= a;
+}
+
+// Returns a pointer to the first entry of column i of A, and sets *inc to
+// the stride between the entries of that column.
+static float *col_ptr(alg__Mat A, int i, int *inc) {
+  *inc = (A->is_transposed ? 1 : alg__ld(A));
+  return A->data + i * (A->is_transposed ? alg__ld(A) : 1);
+}
+
+// Sets every entry of A to zero.
+static void set_zero(alg__Mat A) {
+  for (int r = 0; r < A->nrows; ++r) memset(A->data + (size_t)r * alg__ld(A), 0, A->ncols * sizeof(float));
+}
+
+// Returns a view of the nrows x ncols submatrix of A starting at row i and
+// column j; unlike alg__view, this doesn't allocate.
+static alg__MatStruct sub_view(alg__Mat A, int i, int j, int nrows, int ncols) {
+  alg__MatStruct V = *A;
+  V.ld = alg__ld(A);
+  size_t offset = (A->is_transposed ? (size_t)j * V.ld + i : (size_t)i * V.ld + j);
+  V.data    = A->data + offset;
+  V.data64  = (A->data64 ? A->data64 + offset : NULL);
+  V.nrows   = (A->is_transposed ? ncols : nrows);
+  V.ncols   = (A->is_transposed ? nrows : ncols);
+  V.is_view = true;
+  return V;
+}
+
+// Scratch memory.
+//
+// A solver called with a context takes all of its temporaries from the
+// context's scratch block; frees within the block are no-ops, and the whole
+// block is released when the call returns. Requests that don't fit fall back
+// to malloc, and the block then grows to the call's total use, so that later
+// calls of the same shape don't allocate. A block from alg__set_scratch is
+// never grown. Without a context, these are just malloc and free.
+//
+// Each solver has a matching *_bytes function, used by alg__scratch_bytes,
+// that adds up what it takes from the block in the worst case.
+
+// The bytes that scratch_alloc takes from the block for a request of size bytes.
+#define scratch_bytes(size) (((size_t)(size) + 15) & ~(size_t)15)
+
+// What a context would have taken for the requests made without one; this
+// is the scratch_bytes of alg__SolveStats for solves without a context.
+static _Thread_local size_t heap_scratch_want = 0;
+
+static void *scratch_alloc(alg__Context ctx, size_t size) {
+  if (ctx == NULL) {
+    heap_scratch_want += scratch_bytes(size);
+    return malloc(size);
+  }
+  size = scratch_bytes(size);
+  ctx->scratch_want += size;
+  if (ctx->scratch_used + size > ctx->scratch_size) return malloc(size);
+  void *p = ctx->scratch + ctx->scratch_used;
+  ctx->scratch_used += size;
+  return p;
+}
+
+static void scratch_free(alg__Context ctx, void *p) {
+  char *c = p;
+  if (ctx && ctx->scratch <= c && c < ctx->scratch + ctx->scratch_size) return;
+  free(p);
+}
+
+// These matrices must be freed with free_tmp_matrix, not alg__free_matrix.
+static alg__Mat alloc_tmp_matrix(alg__Context ctx, int nrows, int ncols) {
+  alg__Mat M = scratch_alloc(ctx, sizeof(alg__MatStruct) + data_size(nrows, ncols));
   *M = (alg__MatStruct) {
-         .data  = malloc(data_size(nrows, ncols)),
+         .data  = (float *)(M + 1),
          .nrows = nrows,
          .ncols = ncols,
-         .is_transposed = false };
+         .is_transposed = false,
+         .ld    = ncols };
   return M;
 }
 
-alg__Mat alg__copy_matrix(alg__Mat orig) {
-  alg__Mat M = alg__alloc_matrix(orig->nrows, orig->ncols);
-  M->is_transposed = orig->is_transposed;
-  memcpy(M->data, orig->data, data_size(M->nrows, M->ncols));
-  return M;
+static void free_tmp_matrix(alg__Context ctx, alg__Mat M) {
+  scratch_free(ctx, M);
 }
 
-void alg__free_matrix(alg__Mat M) {
-  free(M->data);
-  free(M);
+static size_t tmp_matrix_bytes(int nrows, int ncols) {
+  return scratch_bytes(sizeof(alg__MatStruct) + data_size((size_t)nrows, ncols));
 }
 
-char *alg__matrix_as_str(alg__Mat M) {
-  char **row_strs = alloca(num_rows(M) * sizeof(char *));
-  size_t sum_bytes = 1;  // Start at 1 for the null terminator.
-  for (int row = 0; row < num_rows(M); ++row) {
-    size_t buf_len = 16 * (num_cols(M) + 1);
-    char *s = row_strs[row] = alloca(buf_len);
-    char *s_end = s + buf_len;
-    s += snprintf(s, s_end - s, "( ");
-    for (int col = 0; col < num_cols(M); ++col) {
-      s += snprintf(s, s_end - s, "%8.2g ", elt(M, row, col));
-    }
-    s += snprintf(s, s_end - s, ")\n");
-    sum_bytes += (s - row_strs[row]);
+static void ctx_begin(alg__Context ctx) {
+  ctx->scratch_used = 0;
+  ctx->scratch_want = 0;
+}
+
+static alg__Status ctx_end(alg__Context ctx, alg__Status status) {
+  if (ctx->scratch_want > ctx->scratch_size && !ctx->scratch_is_borrowed) {
+    free(ctx->scratch);
+    ctx->scratch      = malloc(ctx->scratch_want);
+    ctx->scratch_size = ctx->scratch_want;
   }
-  char *sum_s = malloc(sum_bytes);
-  char *s     = sum_s;
-  for (int r = 0; r < num_rows(M); ++r) s = stpcpy(s, row_strs[r]);
-  return sum_s;
+  ctx->err_str = (status == alg__status_ok ? NULL : alg__err_str);
+  return status;
 }
 
-// 2. Basic matrix operations.
+// Threads.
 
-float alg__dot_prod(alg__Mat A, int i, alg__Mat B, int j) {
-  if (num_rows(A) != num_rows(B)) {
-    alg__err_str = "Expected A, B to have the same #rows.";
-    return 0.0 / 0.0;  // If NaN is supported, it is returned here.
+typedef void (*TaskFn)(void *arg, int task);
+
+typedef struct {
+  TaskFn          fn;
+  void           *arg;
+  int             num_tasks;
+  int             next;  // The next unclaimed task; guarded by lock.
+  pthread_mutex_t lock;
+} TaskQueue;
+
+// This is set on the threads of alg__solve_batch, which are already one per
+// core, so that the solvers they call don't start threads of their own.
+static _Thread_local int is_batch_thread = false;
+
+static int default_num_threads() {
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return (n > 0 ? (int)n : 1);
+}
+
+// The number of threads a solver should use for its own parallel work.
+static int solver_num_threads() {
+  return (is_batch_thread ? 1 : default_num_threads());
+}
+
+static void *task_worker(void *arg) {
+  TaskQueue *queue = arg;
+  while (true) {
+    pthread_mutex_lock(&queue->lock);
+    int task = queue->next++;
+    pthread_mutex_unlock(&queue->lock);
+    if (task >= queue->num_tasks) break;
+    queue->fn(queue->arg, task);
   }
-  float sum = 0;
-  for (int k = 0; k < num_rows(A); ++k) {
-    sum += elt(A, k, i) * elt(B, k, j);
+  return NULL;
+}
+
+// The worker threads of parallel_for are started as needed and then kept,
+// waiting on has_work, so that a loop of short parallel steps, such as the
+// pivots of a tableau, doesn't pay to start threads on every step. One
+// parallel_for uses the pool at a time; is_used is held for its duration,
+// and a call that finds it taken, including one from a worker, runs on its
+// own thread.
+typedef struct {
+  pthread_mutex_t is_used;
+  pthread_mutex_t lock;
+  pthread_cond_t  has_work, is_done;
+  TaskQueue      *queue;        // The current job, or NULL.
+  long            job;          // Counts jobs, so that a worker joins each once.
+  int             num_workers;
+  int             num_wanted;   // The number of workers the current job can use.
+  int             num_active;   // The number of workers on the current job.
+} ThreadPool;
+
+static ThreadPool pool = { .is_used  = PTHREAD_MUTEX_INITIALIZER,
+                           .lock     = PTHREAD_MUTEX_INITIALIZER,
+                           .has_work = PTHREAD_COND_INITIALIZER,
+                           .is_done  = PTHREAD_COND_INITIALIZER };
+
+static void *pool_worker(void *arg) {
+  (void)arg;
+  long last_job = 0;
+  pthread_mutex_lock(&pool.lock);
+  while (true) {
+    while (pool.queue == NULL || pool.job == last_job || pool.num_active >= pool.num_wanted) {
+      pthread_cond_wait(&pool.has_work, &pool.lock);
+    }
+    last_job = pool.job;
+    pool.num_active++;
+    TaskQueue *queue = pool.queue;
+    pthread_mutex_unlock(&pool.lock);
+    task_worker(queue);
+    pthread_mutex_lock(&pool.lock);
+    if (--pool.num_active == 0) pthread_cond_signal(&pool.is_done);
   }
-  return sum;
+  return NULL;
 }
 
-void alg__mul_and_add(float c, alg__Mat A, int i, alg__Mat B, int j) {
-  for (int k = 0; k < num_rows(A); ++k) {
-    elt(B, k, j) += c * elt(A, k, i);
+// Runs fn(arg, task) for each task in [0, num_tasks) on up to num_threads
+// threads, one of which is the calling thread.
+static void parallel_for(int num_tasks, int num_threads, TaskFn fn, void *arg) {
+  if (num_threads > num_tasks) num_threads = num_tasks;
+  if (num_threads <= 1 || pthread_mutex_trylock(&pool.is_used) != 0) {
+    for (int task = 0; task < num_tasks; ++task) fn(arg, task);
+    return;
+  }
+  // Only the holder of is_used starts workers, so num_workers needs no lock.
+  while (pool.num_workers < num_threads - 1) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, pool_worker, NULL) != 0) break;
+    pthread_detach(thread);
+    pool.num_workers++;
+  }
+
+  TaskQueue queue = { .fn = fn, .arg = arg, .num_tasks = num_tasks, .next = 0 };
+  pthread_mutex_init(&queue.lock, NULL);
+  pthread_mutex_lock(&pool.lock);
+  pool.queue      = &queue;
+  pool.num_wanted = num_threads - 1;
+  pool.job++;
+  pthread_cond_broadcast(&pool.has_work);
+  pthread_mutex_unlock(&pool.lock);
+
+  task_worker(&queue);
+
+  // Close the job to workers that haven't joined it, and wait for the rest.
+  pthread_mutex_lock(&pool.lock);
+  pool.queue = NULL;
+  while (pool.num_active > 0) pthread_cond_wait(&pool.is_done, &pool.lock);
+  pthread_mutex_unlock(&pool.lock);
+  pthread_mutex_destroy(&queue.lock);
+  pthread_mutex_unlock(&pool.is_used);
+}
+
+// Matrix products.
+//
+// gemm sets C = alpha op(A) op(B) + beta C, where op(M) is M or M^T. It
+// follows the usual blocking of fast matrix products: a kc x nc block of
+// op(B) is packed into panels gemm_nr columns wide that stay in the L3
+// cache, each mc x kc block of op(A) is packed into panels gemm_mr rows tall
+// that stay in the L2 cache, and the gemm tile kernel multiplies one panel of
+// each into a tile held in registers. The row blocks of op(A) are split
+// across threads, which share the packed op(B). Thin products skip the
+// packing and use dot products.
+
+#define gemm_kc 256
+#define gemm_mc 96    // A multiple of gemm_mr.
+#define gemm_nc 2048  // A multiple of gemm_nr.
+
+// Products smaller than this many flops run on a single thread.
+#define min_parallel_flops (1 << 21)
+
+typedef struct {
+  int    m, n, k;
+  float  alpha;
+  const float *a, *b;
+  float *c;
+  int    a_rs, a_cs, b_rs, b_cs, c_rs, c_cs;  // The row and column strides of op(A) and so on.
+
+  // The current block of op(B), packed, and the row blocks of each task.
+  int    pc, kc, jc, nc;
+  float *packed_b;
+  float *packed_a;  // Each task has gemm_mc * gemm_kc floats of its own.
+  int    num_tasks;
+} Gemm;
+
+// Returns the entries of op(M), and sets *rs and *cs to the strides between
+// its rows and its columns.
+static float *op_strides(alg__Mat M, int trans, int *rs, int *cs) {
+  *rs = (M->is_transposed ? 1 : alg__ld(M));
+  *cs = (M->is_transposed ? alg__ld(M) : 1);
+  if (trans) {
+    int t = *rs;
+    *rs = *cs;
+    *cs = t;
   }
+  return M->data;
 }
 
-void alg__scale(float c, alg__Mat A, int i) {
-  for (int k = 0; k < num_rows(A); ++k) {
-    elt(A, k, i) *= c;
+// A column-major m x n array with leading dimension ld, as a matrix.
+static alg__MatStruct colmajor_view(float *a, int m, int n, int ld) {
+  return (alg__MatStruct) { .data = a, .nrows = n, .ncols = m, .is_transposed = true, .ld = ld };
+}
+
+// Packs rows [i0, i0 + mc) of the current kc columns of op(A) into panels of
+// gemm_mr rows, padded with zeros.
+static void gemm_pack_a(Gemm *G, int i0, int mc, float *dst) {
+  for (int ir = 0; ir < mc; ir += gemm_mr) {
+    int mr = min(gemm_mr, mc - ir);
+    for (int p = 0; p < G->kc; ++p) {
+      const float *col = G->a + (size_t)(G->pc + p) * G->a_cs;
+      for (int i = 0; i < gemm_mr; ++i) {
+        dst[i] = (i < mr ? col[(size_t)(i0 + ir + i) * G->a_rs] : 0);
+      }
+      dst += gemm_mr;
+    }
   }
 }
 
-float alg__norm(alg__Mat A, int i) {
-  float norm_squared = alg__dot_prod(A, i, A, i);
-  return sqrtf(norm_squared);
+// Packs the current kc x nc block of op(B) into panels of gemm_nr columns,
+// padded with zeros.
+static void gemm_pack_b(Gemm *G) {
+  float *dst = G->packed_b;
+  for (int jr = 0; jr < G->nc; jr += gemm_nr) {
+    int nr = min(gemm_nr, G->nc - jr);
+    for (int p = 0; p < G->kc; ++p) {
+      const float *row = G->b + (size_t)(G->pc + p) * G->b_rs + (size_t)(G->jc + jr) * G->b_cs;
+      for (int j = 0; j < gemm_nr; ++j) dst[j] = (j < nr ? row[(size_t)j * G->b_cs] : 0);
+      dst += gemm_nr;
+    }
+  }
 }
 
-// 3. Decompositions.
+// Multiplies the row blocks of one task by the packed block of op(B), and
+// adds alpha times the result to C.
+static void gemm_task(void *arg, int task) {
+  Gemm  *G        = arg;
+  float *packed_a = G->packed_a + (size_t)task * gemm_mc * gemm_kc;
+  int num_blocks = (G->m + gemm_mc - 1) / gemm_mc;
+  int b0 = (int)((long)num_blocks * task / G->num_tasks);
+  int b1 = (int)((long)num_blocks * (task + 1) / G->num_tasks);
 
-alg__Status alg__QR(alg__Mat Q, alg__Mat R) {
-  if (num_rows(Q) < num_cols(Q)) {
-    alg__err_str = "Expected alg__QR input to be a tall or square matrix.";
-    return alg__status_input_error;
+  VecKernels *kernels = get_vec_kernels();
+  float tile[gemm_mr * gemm_nr];
+  for (int ic = b0 * gemm_mc; ic < min(b1 * gemm_mc, G->m); ic += gemm_mc) {
+    int mc = min(gemm_mc, G->m - ic);
+    gemm_pack_a(G, ic, mc, packed_a);
+    for (int jr = 0; jr < G->nc; jr += gemm_nr) {
+      int nr = min(gemm_nr, G->nc - jr);
+      const float *b_panel = G->packed_b + (size_t)jr * G->kc;
+      for (int ir = 0; ir < mc; ir += gemm_mr) {
+        int mr = min(gemm_mr, mc - ir);
+        kernels->gemm_tile(G->kc, packed_a + (size_t)ir * G->kc, b_panel, tile);
+        float *c = G->c + (size_t)(ic + ir) * G->c_rs + (size_t)(G->jc + jr) * G->c_cs;
+        for (int i = 0; i < mr; ++i) {
+          for (int j = 0; j < nr; ++j) {
+            c[(size_t)i * G->c_rs + (size_t)j * G->c_cs] += G->alpha * tile[i * gemm_nr + j];
+          }
+        }
+      }
+    }
   }
+}
 
-  if (R) memset(R->data, 0, sizeof(float) * num_rows(R) * num_cols(R));
+// Sets C = alpha op(A) op(B) + beta C, where op(A) is A^T if trans_a is set,
+// and likewise for B. The sizes are expected to match, and C may not overlap
+// A or B. With a context, this runs on the calling thread only.
+static void gemm(alg__Context ctx, int trans_a, int trans_b, float alpha, alg__Mat A,
+                 alg__Mat B, float beta, alg__Mat C, int num_threads) {
+  Gemm G = { .m = num_rows(C), .n = num_cols(C), .k = (trans_a ? num_rows(A) : num_cols(A)),
+             .alpha = alpha };
+  G.a = op_strides(A, trans_a, &G.a_rs, &G.a_cs);
+  G.b = op_strides(B, trans_b, &G.b_rs, &G.b_cs);
+  G.c = op_strides(C, false,   &G.c_rs, &G.c_cs);
 
-  alg__Status status = alg__status_ok;
-  // Q starts off as an arbitrary tall-or-square matrix A.
-  for (int i = 0; i < num_cols(Q); ++i) {
-    float norm = alg__norm(Q, i);
-    if (norm == 0) {
-      status = alg__status_lin_dep;
-      continue;
+  for (int i = 0; i < G.m; ++i) {
+    for (int j = 0; j < G.n; ++j) {
+      float *c = G.c + (size_t)i * G.c_rs + (size_t)j * G.c_cs;
+      *c = (beta == 0 ? 0 : beta * *c);
     }
-    alg__scale(1.0 / norm, Q, i);
-    if (R) elt(R, i, i) = norm;
-    for (int j = i + 1; j < num_cols(Q); ++j) {
-      float dot_prod = alg__dot_prod(Q, i, Q, j);
-      if (R) elt(R, i, j) = dot_prod;
-      alg__mul_and_add(-dot_prod, Q, i, Q, j);
+  }
+  if (alpha == 0 || G.k == 0) return;
+
+  if (min(G.m, G.n) < 4) {
+    for (int i = 0; i < G.m; ++i) {
+      for (int j = 0; j < G.n; ++j) {
+        float dot = vec_dot(G.k, G.a + (size_t)i * G.a_rs, G.a_cs, G.b + (size_t)j * G.b_cs, G.b_rs);
+        G.c[(size_t)i * G.c_rs + (size_t)j * G.c_cs] += alpha * dot;
+      }
     }
+    return;
   }
-  return status;
+
+  if (ctx || 2.0 * G.m * G.n * G.k < min_parallel_flops) num_threads = 1;
+  G.num_tasks = max(1, min(num_threads, (G.m + gemm_mc - 1) / gemm_mc));
+  int kc_max = min(G.k, gemm_kc), nc_max = min(G.n + gemm_nr - 1, gemm_nc) / gemm_nr * gemm_nr;
+  G.packed_b = scratch_alloc(ctx, (size_t)kc_max * nc_max * sizeof(float));
+  G.packed_a = scratch_alloc(ctx, (size_t)G.num_tasks * gemm_mc * gemm_kc * sizeof(float));
+  for (G.jc = 0; G.jc < G.n; G.jc += gemm_nc) {
+    G.nc = min(gemm_nc, G.n - G.jc);
+    for (G.pc = 0; G.pc < G.k; G.pc += gemm_kc) {
+      G.kc = min(gemm_kc, G.k - G.pc);
+      gemm_pack_b(&G);
+      parallel_for(G.num_tasks, G.num_tasks, gemm_task, &G);
+    }
+  }
+  scratch_free(ctx, G.packed_a);
+  scratch_free(ctx, G.packed_b);
 }
 
-// 4. Optimizations.
+// The scratch bytes used by gemm with a context for an m x n product C
+// with inner dimension k.
+static size_t gemm_bytes(int m, int n, int k) {
+  if (min(m, n) < 4) return 0;
+  int kc_max = min(k, gemm_kc), nc_max = min(n + gemm_nr - 1, gemm_nc) / gemm_nr * gemm_nr;
+  return scratch_bytes((size_t)kc_max * nc_max * sizeof(float)) +
+         scratch_bytes((size_t)gemm_mc * gemm_kc * sizeof(float));
+}
 
-alg__Status alg__l1_min(alg__Mat A, alg__Mat b, alg__Mat x) {
-  alg__Mat A2 = convert_to_restricted_vars(A);
+// Householder QR.
+//
+// These routines work on column-major arrays, where entry (i, j) of a matrix
+// with leading dimension ld is at a[i + j * ld]. The matrix is factored in
+// panels of qr_block columns. Each panel is factored a column at a time, and
+// then its reflectors are applied to the rest of the matrix at once in the
+// compact WY form H_1 H_2 ... H_nb = I - V T V^T, with matrix products that
+// are blocked by rows and split across threads by columns.
 
-  alg__Mat c = alg__alloc_matrix(num_cols(A2), 1);
-  for (int r = 0; r < num_rows(c); ++r) col_elt(c, r) = 1;
+#define qr_block     32
+#define qr_row_block 1024
+#define qr_max_chunk 64    // The most columns of C in one apply_block_task.
+
+// Overwrites x, of length n, with (beta, v[1], .., v[n - 1]) and returns tau,
+// so that H = I - tau v v^T with v[0] = 1 has H x = beta e_1. A tau of 0
+// means that H = I.
+static float make_reflector(int n, float *x) {
+  if (n <= 1) return 0;
+  float tail2 = vec_dot(n - 1, x + 1, 1, x + 1, 1);
+  if (tail2 == 0) return 0;
+  float alpha = x[0];
+  float beta  = -copysignf(sqrtf(alpha * alpha + tail2), alpha);
+  vec_scal(n - 1, 1 / (alpha - beta), x + 1, 1);
+  x[0] = beta;
+  return (beta - alpha) / beta;
+}
 
-  alg__Mat x2 = alg__alloc_matrix(num_cols(A2), 1);
+// Applies H = I - tau v v^T to y, where v[0] = 1 is implicit.
+static void apply_reflector(int n, float tau, const float *v, float *y) {
+  if (tau == 0) return;
+  float w = y[0] + vec_dot(n - 1, v + 1, 1, y + 1, 1);
+  y[0] -= tau * w;
+  vec_axpy(n - 1, -tau * w, v + 1, 1, y + 1, 1);
+}
 
-  alg__Status status = alg__run_lp(A2, b, x2, c);
+// The block reflector H = I - V T V^T, or its transpose, applied to the
+// rows x ncols matrix c by apply_block_task, one chunk of columns per task.
+typedef struct {
+  int    rows, nb;
+  float *v;          // V is rows x nb, with leading dimension rows.
+  float *t;          // T is nb x nb and upper triangular.
+  int    transpose;
+  float *c;
+  int    ldc, ncols, chunk;
+} BlockReflector;
 
-  if (status == alg__status_ok) {
-    // Copy x2 over to x.
-    for (int r = 0; r < num_rows(x); ++r) {
-      col_elt(x, r) = col_elt(x2, 2 * r) - col_elt(x2, 2 * r + 1);
+// Copies the nb reflectors stored below the diagonal of a into V, filling
+// in the implicit ones and zeros, and builds T.
+static void load_block_reflector(BlockReflector *H, const float *a, int lda, int rows,
+                                 int nb, const float *tau) {
+  H->rows = rows;
+  H->nb   = nb;
+  for (int k = 0; k < nb; ++k) {
+    float *v_k = H->v + k * rows;
+    for (int r = 0; r < rows; ++r) v_k[r] = (r < k ? 0 : r == k ? 1 : a[r + k * lda]);
+  }
+
+  // The strictly upper triangle of T starts as that of V^T V.
+  VecKernels *kernels = get_vec_kernels();
+  for (int i = 0; i < nb; i += 4) {
+    for (int j = i; j < nb; j += 4) {
+      if (j + 4 <= nb) {
+        const float *v_i[4], *v_j[4];
+        float dots[16];
+        for (int t = 0; t < 4; ++t) v_i[t] = H->v + (i + t) * rows + i;
+        for (int t = 0; t < 4; ++t) v_j[t] = H->v + (j + t) * rows + i;
+        kernels->dot4x4(rows - i, v_i, v_j, dots);
+        for (int p = 0; p < 4; ++p) {
+          for (int q = 0; q < 4; ++q) H->t[(i + p) + (j + q) * nb] = dots[4 * p + q];
+        }
+        continue;
+      }
+      for (int p = i; p < min(i + 4, nb); ++p) {
+        for (int q = j; q < nb; ++q) {
+          H->t[p + q * nb] = vec_dot(rows - i, H->v + p * rows + i, 1, H->v + q * rows + i, 1);
+        }
+      }
     }
   }
 
-  // Clean up.
-  alg__free_matrix(x2);
-  alg__free_matrix(c);
-  alg__free_matrix(A2);
+  // Then T[0:i, i] = -tau_i T[0:i, 0:i] (V^T v_i)[0:i], column by column.
+  for (int i = 0; i < nb; ++i) {
+    float *t_i = H->t + i * nb, w[qr_block];
+    memcpy(w, t_i, i * sizeof(float));
+    for (int p = 0; p < i; ++p) {
+      float sum = 0;
+      for (int k = p; k < i; ++k) sum += H->t[p + k * nb] * w[k];
+      t_i[p] = -tau[i] * sum;
+    }
+    t_i[i] = tau[i];
+  }
+}
+
+static void apply_block_task(void *arg, int task) {
+  BlockReflector *H = arg;
+  int c0 = task * H->chunk, nc = min(H->chunk, H->ncols - c0), nb = H->nb;
+  float w[qr_block * qr_max_chunk] = {0};  // W = V^T C, column-major.
+
+  VecKernels *kernels = get_vec_kernels();
+  for (int r0 = 0; r0 < H->rows; r0 += qr_row_block) {
+    int rb = min(qr_row_block, H->rows - r0);
+    for (int c = 0; c < nc; c += 4) {
+      for (int k = 0; k < nb; k += 4) {
+        const float *v[4], *cc[4];
+        if (c + 4 <= nc && k + 4 <= nb) {
+          float dots[16];
+          for (int t = 0; t < 4; ++t) {
+            v[t]  = H->v + r0 + (k + t) * H->rows;
+            cc[t] = H->c + r0 + (c0 + c + t) * H->ldc;
+          }
+          kernels->dot4x4(rb, v, cc, dots);
+          for (int i = 0; i < 4; ++i) {
+            for (int t = 0; t < 4; ++t) w[k + i + (c + t) * nb] += dots[4 * i + t];
+          }
+          continue;
+        }
+        for (int t = c; t < min(c + 4, nc); ++t) {
+          for (int i = k; i < min(k + 4, nb); ++i) {
+            w[i + t * nb] += vec_dot(rb, H->v + r0 + i * H->rows, 1, H->c + r0 + (c0 + t) * H->ldc, 1);
+          }
+        }
+      }
+    }
+  }
+
+  // Set W = T W, or T^T W.
+  for (int c = 0; c < nc; ++c) {
+    float *w_c = w + c * nb, tw[qr_block];
+    for (int i = 0; i < nb; ++i) {
+      float sum = 0;
+      if (H->transpose) {
+        for (int k = 0; k <= i; ++k) sum += H->t[k + i * nb] * w_c[k];
+      } else {
+        for (int k = i; k < nb; ++k) sum += H->t[i + k * nb] * w_c[k];
+      }
+      tw[i] = sum;
+    }
+    memcpy(w_c, tw, nb * sizeof(float));
+  }
+
+  // Set C -= V W.
+  for (int r0 = 0; r0 < H->rows; r0 += qr_row_block) {
+    int rb = min(qr_row_block, H->rows - r0);
+    for (int c = 0; c < nc; c += 4) {
+      for (int k = 0; k < nb; k += 4) {
+        const float *v[4];
+        float *cc[4];
+        if (c + 4 <= nc && k + 4 <= nb) {
+          float a[16];
+          for (int t = 0; t < 4; ++t) {
+            v[t]  = H->v + r0 + (k + t) * H->rows;
+            cc[t] = H->c + r0 + (c0 + c + t) * H->ldc;
+          }
+          for (int i = 0; i < 4; ++i) {
+            for (int t = 0; t < 4; ++t) a[4 * i + t] = -w[k + i + (c + t) * nb];
+          }
+          kernels->axpy4x4(rb, a, v, cc);
+          continue;
+        }
+        for (int t = c; t < min(c + 4, nc); ++t) {
+          for (int i = k; i < min(k + 4, nb); ++i) {
+            vec_axpy(rb, -w[i + t * nb], H->v + r0 + i * H->rows, 1, H->c + r0 + (c0 + t) * H->ldc, 1);
+          }
+        }
+      }
+    }
+  }
+}
+
+static void apply_block_reflector(BlockReflector *H, int transpose, float *c, int ldc,
+                                  int ncols, int num_threads) {
+  if (ncols <= 0) return;
+  if ((double)H->rows * ncols * H->nb < min_parallel_flops) num_threads = 1;
+  H->transpose = transpose;
+  H->c         = c;
+  H->ldc       = ldc;
+  H->ncols     = ncols;
+  H->chunk     = max(4, (ncols + 4 * num_threads - 1) / (4 * num_threads));
+  H->chunk     = min(H->chunk, qr_max_chunk);
+  parallel_for((ncols + H->chunk - 1) / H->chunk, num_threads, apply_block_task, H);
+}
+
+static void block_reflector_init(alg__Context ctx, BlockReflector *H, int m) {
+  H->v = scratch_alloc(ctx, (size_t)m * qr_block * sizeof(float));
+  H->t = scratch_alloc(ctx, qr_block * qr_block * sizeof(float));
+}
+
+static void block_reflector_free(alg__Context ctx, BlockReflector *H) {
+  scratch_free(ctx, H->v);
+  scratch_free(ctx, H->t);
+}
+
+// The scratch bytes used by block_reflector_init.
+static size_t block_reflector_bytes(int m) {
+  return scratch_bytes((size_t)m * qr_block * sizeof(float)) +
+         scratch_bytes(qr_block * qr_block * sizeof(float));
+}
+
+// Factors the m x n matrix a, with m >= n, in place. Afterwards R is in the
+// upper triangle of a, the reflectors are below it, and tau holds their scales.
+static void house_qr(alg__Context ctx, float *a, int m, int n, int lda, float *tau,
+                     int num_threads) {
+  BlockReflector H;
+  block_reflector_init(ctx, &H, m);
+  for (int j0 = 0; j0 < n; j0 += qr_block) {
+    int nb = min(qr_block, n - j0);
+    for (int j = j0; j < j0 + nb; ++j) {
+      float *v = a + j + j * lda;
+      tau[j] = make_reflector(m - j, v);
+      for (int c = j + 1; c < j0 + nb; ++c) apply_reflector(m - j, tau[j], v, a + j + c * lda);
+    }
+    if (j0 + nb == n) break;
+    load_block_reflector(&H, a + j0 + j0 * lda, lda, m - j0, nb, tau + j0);
+    apply_block_reflector(&H, true, a + j0 + (j0 + nb) * lda, lda, n - j0 - nb, num_threads);
+  }
+  block_reflector_free(ctx, &H);
+}
+
+// Sets the m x n matrix q to the first n columns of Q = H_1 H_2 ... H_n,
+// given the output of house_qr.
+static void house_form_q(alg__Context ctx, const float *a, int m, int n, int lda,
+                         const float *tau, float *q, int ldq, int num_threads) {
+  for (int j = 0; j < n; ++j) {
+    memset(q + j * ldq, 0, m * sizeof(float));
+    q[j + j * ldq] = 1;
+  }
+  BlockReflector H;
+  block_reflector_init(ctx, &H, m);
+  for (int j0 = ((n - 1) / qr_block) * qr_block; j0 >= 0; j0 -= qr_block) {
+    int nb = min(qr_block, n - j0);
+    load_block_reflector(&H, a + j0 + j0 * lda, lda, m - j0, nb, tau + j0);
+    apply_block_reflector(&H, false, q + j0 + j0 * ldq, ldq, n - j0, num_threads);
+  }
+  block_reflector_free(ctx, &H);
+}
+
+// TSQR splits the rows of a tall-skinny matrix into blocks, factors the
+// blocks in parallel as Q_i R_i, and then factors the stacked R_i as Q_S R.
+// The Q factor is then diag(Q_i) Q_S.
+typedef struct {
+  float *a, *q, *s, *q_s, *taus;
+  int    m, n, num_blocks;
+} TSQR;
+
+static void tsqr_block_rows(TSQR *T, int i, int *r0, int *rows) {
+  *r0   = (int)((long)T->m * i / T->num_blocks);
+  *rows = (int)((long)T->m * (i + 1) / T->num_blocks) - *r0;
+}
+
+static void tsqr_factor_task(void *arg, int i) {
+  TSQR *T = arg;
+  int r0, rows, n = T->n, ld_s = T->num_blocks * n;
+  tsqr_block_rows(T, i, &r0, &rows);
+  float *tau = T->taus + i * n;
+  house_qr(NULL, T->a + r0, rows, n, T->m, tau, 1);
+  for (int j = 0; j < n; ++j) {
+    for (int r = 0; r < n; ++r) T->s[i * n + r + j * ld_s] = (r <= j ? T->a[r0 + r + j * T->m] : 0);
+  }
+  house_form_q(NULL, T->a + r0, rows, n, T->m, tau, T->q + r0, T->m, 1);
+}
+
+static void tsqr_multiply_task(void *arg, int i) {
+  TSQR *T = arg;
+  int r0, rows, n = T->n, ld_s = T->num_blocks * n;
+  tsqr_block_rows(T, i, &r0, &rows);
+  // Set rows r0.. of a to Q_i times block i of Q_S.
+  alg__MatStruct q_i   = colmajor_view(T->q + r0, rows, n, T->m);
+  alg__MatStruct q_s_i = colmajor_view(T->q_s + i * n, n, n, ld_s);
+  alg__MatStruct out   = colmajor_view(T->a + r0, rows, n, T->m);
+  gemm(NULL, false, false, 1, &q_i, &q_s_i, 0, &out, 1);
+}
+
+// Factors the m x n matrix a as Q R in num_blocks row blocks, each with at
+// least n rows. Q replaces a, and R goes in r with leading dimension n.
+static void tsqr(float *a, int m, int n, int num_blocks, float *r, int num_threads) {
+  int ld_s = num_blocks * n;
+  TSQR T = { .a = a, .m = m, .n = n, .num_blocks = num_blocks,
+             .q    = malloc((size_t)m * n * sizeof(float)),
+             .s    = malloc((size_t)ld_s * n * sizeof(float)),
+             .q_s  = malloc((size_t)ld_s * n * sizeof(float)),
+             .taus = malloc((size_t)ld_s * sizeof(float)) };
+  parallel_for(num_blocks, num_threads, tsqr_factor_task, &T);
+
+  house_qr(NULL, T.s, ld_s, n, ld_s, T.taus, num_threads);
+  for (int j = 0; j < n; ++j) {
+    for (int i = 0; i < n; ++i) r[i + j * n] = (i <= j ? T.s[i + j * ld_s] : 0);
+  }
+  house_form_q(NULL, T.s, ld_s, n, ld_s, T.taus, T.q_s, ld_s, num_threads);
+  parallel_for(num_blocks, num_threads, tsqr_multiply_task, &T);
+
+  free(T.q);
+  free(T.s);
+  free(T.q_s);
+  free(T.taus);
+}
+
+// Copies the matrix A to the column-major array a with leading dimension
+// num_rows(A), or copies a back to A if to_mat is set. Row-major matrices are
+// copied in tiles so that each cache line is used by several columns.
+static void copy_colmajor(alg__Mat A, float *a, int to_mat) {
+  int m = num_rows(A), n = num_cols(A), tile = (A->is_transposed ? m : 64);
+  for (int r0 = 0; r0 < m; r0 += tile) {
+    int r1 = min(r0 + tile, m);
+    for (int j = 0; j < n; ++j) {
+      int    inc;
+      float *col = col_ptr(A, j, &inc), *a_j = a + (size_t)j * m;
+      if (to_mat) {
+        for (int i = r0; i < r1; ++i) col[i * inc] = a_j[i];
+      } else {
+        for (int i = r0; i < r1; ++i) a_j[i] = col[i * inc];
+      }
+    }
+  }
+}
+
+// Factors the m x n matrix a, with m >= n and leading dimension m, as Q R.
+// Q replaces a, and R goes in r with leading dimension n. The signs are
+// chosen so that R has a nonnegative diagonal. Temporaries come from the
+// scratch memory of ctx, except with TSQR, which only runs on several threads.
+static void qr_colmajor(alg__Context ctx, float *a, int m, int n, float *r,
+                        alg__QRMethod method, int num_threads) {
+  int num_blocks = min(num_threads, m / (2 * max(n, 1)));
+  if (method == alg__qr_auto) method = (num_blocks >= 2 ? alg__qr_tsqr : alg__qr_householder);
+  if (method == alg__qr_tsqr && num_blocks >= 2) {
+    tsqr(a, m, n, num_blocks, r, num_threads);
+  } else {
+    float *tau = scratch_alloc(ctx, max(n, 1) * sizeof(float));
+    float *q   = scratch_alloc(ctx, (size_t)m * n * sizeof(float));
+    house_qr(ctx, a, m, n, m, tau, num_threads);
+    for (int j = 0; j < n; ++j) {
+      for (int i = 0; i < n; ++i) r[i + j * n] = (i <= j ? a[i + j * m] : 0);
+    }
+    house_form_q(ctx, a, m, n, m, tau, q, m, num_threads);
+    memcpy(a, q, (size_t)m * n * sizeof(float));
+    scratch_free(ctx, q);
+    scratch_free(ctx, tau);
+  }
+  for (int i = 0; i < n; ++i) {
+    if (r[i + i * n] >= 0) continue;
+    for (int j = i; j < n; ++j) r[i + j * n] *= -1;
+    vec_scal(m, -1, a + i * m, 1);
+  }
+}
+
+// QR updates.
+//
+// An alg__QRFactor keeps a copy of A along with the R of A = Q R, but not Q.
+// Rows and columns are added and removed with Givens rotations on R, and a
+// removed row is taken out of R by the downdate of LINPACK's dchdd. Solves
+// use the corrected seminormal equations: x solves R^T R x = A^T b, and then
+// once more for the residual b - A x, which makes up for the error that the
+// updates build up in R. When an update can't be made stably, R is marked
+// stale and is refactored from A by the next solve.
+
+typedef enum { r_ok, r_stale, r_singular } RState;
+
+struct alg__QRFactorStruct {
+  int    m, n;         // A is m x n.
+  int    row_cap;      // The rows that a has room for.
+  int    ld;           // The leading dimension of a and r, which is >= n.
+  float *a;            // A, in row-major order.
+  float *r;            // The n x n upper triangular R, in row-major order.
+  RState r_state;      // R is only used when it's r_ok.
+  float *work;         // Scratch space for updates and solves.
+  size_t work_cap;     // The number of floats allocated for work.
+};
+
+// Returns F->work with room for at least size floats.
+static float *qr_work(alg__QRFactor F, size_t size) {
+  if (size > F->work_cap) {
+    free(F->work);
+    F->work_cap = max(size, 2 * F->work_cap);
+    F->work     = malloc(F->work_cap * sizeof(float));
+  }
+  return F->work;
+}
+
+// Sets c and s so that the rotation [c s; -s c] takes (x, y) to (r, 0) with
+// r = hypot(x, y) >= 0, and returns r.
+static float givens(float x, float y, float *c, float *s) {
+  float r = hypotf(x, y);
+  *c = (r == 0 ? 1 : x / r);
+  *s = (r == 0 ? 0 : y / r);
+  return r;
+}
+
+// Applies the rotation from givens to the n entries of x and y.
+static void rotate(int n, float c, float s, float *x, float *y) {
+  for (int k = 0; k < n; ++k) {
+    float t = c * x[k] + s * y[k];
+    y[k]    = c * y[k] - s * x[k];
+    x[k]    = t;
+  }
+}
+
+// Solves R^T z = x in place.
+static void qr_solve_rt(alg__QRFactor F, float *x) {
+  for (int i = 0; i < F->n; ++i) {
+    float *r_i = F->r + (size_t)i * F->ld;
+    x[i] /= r_i[i];
+    vec_axpy(F->n - i - 1, -x[i], r_i + i + 1, 1, x + i + 1, 1);
+  }
+}
+
+// Solves R z = x in place.
+static void qr_solve_r(alg__QRFactor F, float *x) {
+  for (int i = F->n - 1; i >= 0; --i) {
+    float *r_i = F->r + (size_t)i * F->ld;
+    x[i] = (x[i] - vec_dot(F->n - i - 1, r_i + i + 1, 1, x + i + 1, 1)) / r_i[i];
+  }
+}
+
+// Factors A from scratch, and sets r_state to r_singular if A lacks full
+// column rank.
+static void qr_refactor(alg__QRFactor F) {
+  int m = F->m, n = F->n;
+  F->r_state = r_singular;
+  if (m < n) return;
+  alg__MatStruct A = { .data = F->a, .nrows = m, .ncols = n, .ld = F->ld };
+  float *a    = malloc(max((size_t)m * n, 1) * sizeof(float));
+  float *tau  = malloc(max(n, 1) * sizeof(float));
+  float *norm = malloc(max(n, 1) * sizeof(float));
+  copy_colmajor(&A, a, false);
+  for (int j = 0; j < n; ++j) norm[j] = sqrtf(vec_dot(m, a + (size_t)j * m, 1, a + (size_t)j * m, 1));
+  house_qr(NULL, a, m, n, m, tau, solver_num_threads());
+  F->r_state = r_ok;
+  for (int i = 0; i < n; ++i) {
+    float *r_i  = F->r + (size_t)i * F->ld;
+    float  sign = (a[i + (size_t)i * m] < 0 ? -1 : 1);
+    for (int j = 0; j < n; ++j) r_i[j] = (j < i ? 0 : sign * a[i + (size_t)j * m]);
+    if (r_i[i] <= tol * norm[i]) F->r_state = r_singular;
+  }
+  free(norm);
+  free(tau);
+  free(a);
+}
+
+// Makes room for at least the given rows and columns of A, and for the
+// columns of R.
+static void qr_reserve(alg__QRFactor F, int rows, int cols) {
+  if (cols > F->ld) {
+    int    ld = max(cols, 2 * F->ld);
+    float *a  = malloc(max((size_t)max(rows, F->row_cap) * ld, 1) * sizeof(float));
+    float *r  = calloc(max((size_t)ld * ld, 1), sizeof(float));
+    for (int i = 0; i < F->m; ++i) memcpy(a + (size_t)i * ld, F->a + (size_t)i * F->ld, F->n * sizeof(float));
+    for (int i = 0; i < F->n; ++i) memcpy(r + (size_t)i * ld, F->r + (size_t)i * F->ld, F->n * sizeof(float));
+    free(F->a);
+    free(F->r);
+    F->a       = a;
+    F->r       = r;
+    F->ld      = ld;
+    F->row_cap = max(rows, F->row_cap);
+  }
+  if (rows > F->row_cap) {
+    F->row_cap = max(rows, 2 * F->row_cap);
+    F->a       = realloc(F->a, max((size_t)F->row_cap * F->ld, 1) * sizeof(float));
+  }
+}
+
+// Removes from R the row a of A, so that R^T R becomes R^T R - a a^T, as in
+// LINPACK's dchdd. Returns false, leaving R unchanged, if that would leave R
+// nearly singular, as when the row is the only one with weight in some
+// direction; the caller then refactors.
+static int qr_downdate(alg__QRFactor F, const float *a_row) {
+  int n = F->n;
+  float *z = qr_work(F, 2 * (size_t)n);
+  float *c = z + n;
+  memcpy(z, a_row, n * sizeof(float));
+  qr_solve_rt(F, z);
+  float alpha2 = 1 - vec_dot(n, z, 1, z, 1);
+  if (!(alpha2 > tol)) return false;
+
+  // Find the rotations that take (alpha, z) to (1, 0), from the last entry
+  // up. The sines are kept in z.
+  float alpha = sqrtf(alpha2);
+  for (int i = n - 1; i >= 0; --i) {
+    float scale = alpha + fabsf(z[i]);
+    float u = alpha / scale, v = z[i] / scale, norm = hypotf(u, v);
+    c[i]  = u / norm;
+    z[i]  = v / norm;
+    alpha = scale * norm;
+  }
+  for (int j = 0; j < n; ++j) {
+    float x = 0;
+    for (int i = j; i >= 0; --i) {
+      float *r_ij = F->r + (size_t)i * F->ld + j;
+      float  t    = c[i] * x + z[i] * *r_ij;
+      *r_ij = c[i] * *r_ij - z[i] * x;
+      x     = t;
+    }
+  }
+  for (int i = 0; i < n; ++i) {
+    float *r_i = F->r + (size_t)i * F->ld;
+    if (r_i[i] < 0) vec_scal(n - i, -1, r_i + i, 1);
+  }
+  return true;
+}
+
+// Sets column n of R from a new column c of A, stored just past its last
+// column n - 1, or returns false if c is numerically in the span of A. The
+// new column u of R solves R^T u = A^T c, and its last entry is the norm of
+// what's left of c after taking out A R^-1 u. This is done twice, as one
+// pass loses the part of c outside the span of A to roundoff when that part
+// is small.
+static int qr_append_col(alg__QRFactor F) {
+  int m = F->m, n = F->n;
+  float *e = qr_work(F, (size_t)m + 2 * n);
+  float *u = e + m, *w = u + n;
+  alg__MatStruct A = { .data = F->a, .nrows = m, .ncols = n, .ld = F->ld };
+  alg__MatStruct E = { .data = e,    .nrows = m, .ncols = 1, .ld = 1 };
+  alg__MatStruct W = { .data = w,    .nrows = n, .ncols = 1, .ld = 1 };
+  for (int i = 0; i < m; ++i) e[i] = F->a[(size_t)i * F->ld + n];
+  memset(u, 0, n * sizeof(float));
+  float c_norm = sqrtf(vec_dot(m, e, 1, e, 1));
+  for (int pass = 0; pass < 2; ++pass) {
+    gemm(NULL, true, false, 1, &A, &E, 0, &W, solver_num_threads());
+    qr_solve_rt(F, w);
+    vec_axpy(n, 1, w, 1, u, 1);
+    qr_solve_r(F, w);
+    gemm(NULL, false, false, -1, &A, &W, 1, &E, solver_num_threads());
+  }
+  float rho = sqrtf(vec_dot(m, e, 1, e, 1));
+  if (rho <= tol * c_norm) return false;
+  for (int i = 0; i < n; ++i) F->r[(size_t)i * F->ld + n] = u[i];
+  float *r_n = F->r + (size_t)n * F->ld;
+  memset(r_n, 0, n * sizeof(float));
+  r_n[n] = rho;
+  return true;
+}
+
+// Streaming least squares.
+//
+// An alg__RLS keeps [R d], where Q^T [A b] = [R d; 0 e] for the weighted
+// rows seen so far, along with ||e||^2. A chunk of rows [X y] is absorbed by
+// refactoring [R d; X y] with Householder reflectors that each touch one row
+// of R and every row of the chunk, so that the work is in dot products and
+// axpys down the chunk's columns. Chunks are taken rls_block rows at a time,
+// which keeps the memory at O(n^2) for any chunk size.
+
+#define rls_block 256
+
+struct alg__RLSStruct {
+  int    n;
+  float  forget;  // Each row's squared residual is weighted by forget^(later rows).
+  float *r;       // [R d], which is n x (n + 1), in row-major order.
+  double rss;     // ||e||^2, the weighted residual sum of squares.
+  float *block;   // Up to rls_block weighted rows of [X y], in column-major order.
+};
+
+// Absorbs the k rows of the column-major [X y] in c, with leading dimension
+// k, into [R d] and rss. The reflector for column j of R takes (r_jj, X[j])
+// to (beta, 0) with beta >= 0, and its leading entry v0 = r_jj - beta is
+// computed so as to avoid cancellation.
+static void rls_absorb(alg__RLS S, float *c, int k) {
+  int n = S->n, ld = n + 1;
+  for (int j = 0; j < n; ++j) {
+    float *v = c + (size_t)j * k, *r_j = S->r + (size_t)j * ld;
+    float sigma = vec_dot(k, v, 1, v, 1);
+    if (sigma == 0) continue;
+    float alpha = r_j[j], beta = sqrtf(alpha * alpha + sigma);
+    float v0    = (alpha <= 0 ? alpha - beta : -sigma / (alpha + beta));
+    float tau   = 2 * v0 * v0 / (sigma + v0 * v0);
+    vec_scal(k, 1 / v0, v, 1);
+    r_j[j] = beta;
+    for (int l = j + 1; l <= n; ++l) {
+      float *c_l = c + (size_t)l * k;
+      float  w   = tau * (r_j[l] + vec_dot(k, v, 1, c_l, 1));
+      r_j[l] -= w;
+      vec_axpy(k, -w, v, 1, c_l, 1);
+    }
+  }
+  float *e = c + (size_t)n * k;
+  S->rss += vec_dot(k, e, 1, e, 1);
+}
+
+// A pivot is split by rows across threads only so far as each thread gets
+// at least this many entries of the tableau, which is far more work than
+// handing it to a pooled thread.
+#define min_pivot_share (1 << 18)
+
+typedef struct {
+  alg__Mat A;
+  int      row, col;
+  int      num_tasks;
+} Pivot;
+
+// Returns a pointer to the first entry of row i of A, and sets *inc to the
+// stride between the entries of that row.
+static float *row_ptr(alg__Mat A, int i, int *inc) {
+  *inc = (A->is_transposed ? alg__ld(A) : 1);
+  return A->data + (size_t)i * (A->is_transposed ? 1 : alg__ld(A));
+}
+
+// Subtracts from each of one task's share of the rows its entry in the
+// pivot column times the pivot row. Each row is a single contiguous sweep
+// when A isn't transposed.
+static void pivot_task(void *arg, int task) {
+  Pivot *P = arg;
+  int m = num_rows(P->A), n = num_cols(P->A);
+  int r0 = (int)((long)m * task / P->num_tasks), r1 = (int)((long)m * (task + 1) / P->num_tasks);
+  int inc, piv_inc;
+  const float *piv = row_ptr(P->A, P->row, &piv_inc);
+  for (int r = r0; r < r1; ++r) {
+    if (r == P->row) continue;
+    float *row_r = row_ptr(P->A, r, &inc);
+    float *entry = row_r + (size_t)P->col * inc;
+    if (*entry == 0) continue;
+    vec_axpy(n, -*entry, piv, piv_inc, row_r, inc);
+    // Set the same-column element explicitly to 0 to avoid precision errors.
+    *entry = 0;
+  }
+}
+
+// This sets the given entry to 1 by scaling its row
+// and clears the rest of its column with row operations.
+// The given entry is expected to be nonzero.
+static void make_col_a_01_col(alg__Mat A, int row, int col, int num_threads) {
+  // Normalize the row so that A_{row,col} = 1.
+  int    inc;
+  float *piv = row_ptr(A, row, &inc);
+  vec_scal(num_cols(A), 1.0 / elt(A, row, col), piv, inc);
+  elt(A, row, col) = 1;  // Avoid precision errors.
+
+  // Zero out all other entries in the col.
+  size_t num_shares = (size_t)num_rows(A) * num_cols(A) / min_pivot_share;
+  if ((size_t)num_threads > num_shares) num_threads = (int)num_shares;
+  Pivot P = { .A = A, .row = row, .col = col, .num_tasks = max(1, min(num_threads, num_rows(A))) };
+  parallel_for(P.num_tasks, P.num_tasks, pivot_task, &P);
+}
+
+// Solve statistics.
+//
+// The public LP entry points bracket each solve with stats_begin and
+// stats_end, and the solvers add their pivots and times in between.
+
+static double now_seconds() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + 1e-9 * t.tv_nsec;
+}
+
+static void stats_begin(alg__LPOptions *opts) {
+  heap_scratch_want = 0;
+  if (opts && opts->stats) *opts->stats = (alg__SolveStats) {0};
+}
+
+// Sets the objective of a solve of the given type, which reads c only for
+// alg__problem_lp, and its scratch use. Returns status.
+static alg__Status stats_end(alg__Context ctx, alg__LPOptions *opts, alg__ProblemType type,
+                             alg__Mat x, alg__Mat c, alg__Status status) {
+  if (opts == NULL || opts->stats == NULL) return status;
+  alg__SolveStats *stats = opts->stats;
+  stats->scratch_bytes = (ctx ? ctx->scratch_want : heap_scratch_want);
+  stats->objective     = NAN;
+  if (status != alg__status_ok) return status;
+  double obj = 0;
+  for (int j = 0; j < num_rows(x); ++j) {
+    double xj = elt64(x, j, 0);
+    if (type == alg__problem_lp)   obj += elt64(c, j, 0) * xj;
+    if (type == alg__problem_l1)   obj += fabs(xj);
+    if (type == alg__problem_linf) obj  = fmax(obj, fabs(xj));
+  }
+  stats->objective = obj;
+  return status;
+}
+
+// Adds the time since *t to the given phase, and restarts *t.
+static void stats_add_time(alg__LPOptions *opts, Phase phase, double *t) {
+  double now = now_seconds();
+  if (opts->stats) {
+    if (phase == phase1) opts->stats->phase1_seconds += now - *t;
+    else                 opts->stats->phase2_seconds += now - *t;
+  }
+  *t = now;
+}
+
+// Counts a pivot, and reports it to opts->on_pivot. The objective is only
+// read when there is a callback.
+static void stats_pivot(alg__LPOptions *opts, Phase phase, int entering, int leaving,
+                        int is_degenerate, double objective) {
+  if (opts->stats) {
+    if (phase == phase1) opts->stats->phase1_pivots++;
+    else                 opts->stats->phase2_pivots++;
+    if (is_degenerate) opts->stats->degenerate_pivots++;
+  }
+  if (opts->on_pivot) {
+    opts->on_pivot(opts->on_pivot_data, phase == phase1 ? 1 : 2, objective, entering, leaving);
+  }
+}
+
+// Pricing rules.
+//
+// A pricing rule chooses the entering column among those with a positive
+// score, which is the rate of improvement in the objective as that column's
+// variable increases. Bland's rule takes the first such column; it never
+// cycles, but it can take many more pivots than the other rules, so they
+// fall back to it only after stall_limit consecutive degenerate pivots.
+
+#define default_stall_limit 50
+
+typedef float (*ScoreFn)(void *data, int j);
+
+typedef struct {
+  alg__Pricing rule;
+  float *weights;       // Per-column weights for devex and steepest edge.
+  int    partial_size;  // The number of columns in each partial pricing window.
+  int    partial_start;
+  int    stall_limit;
+  int    num_stalls;    // The number of consecutive degenerate pivots.
+} Pricer;
+
+static void pricer_init(alg__Context ctx, Pricer *P, alg__LPOptions *opts, int ncols) {
+  int partial_size = opts->partial_size;
+  if (partial_size <= 0) partial_size = (ncols / 8 > 16 ? ncols / 8 : 16);
+  *P = (Pricer) {
+         .rule          = opts->pricing,
+         .weights       = scratch_alloc(ctx, ncols * sizeof(float)),
+         .partial_size  = partial_size,
+         .partial_start = 0,
+         .stall_limit   = (opts->stall_limit > 0 ? opts->stall_limit : default_stall_limit),
+         .num_stalls    = 0 };
+  for (int j = 0; j < ncols; ++j) P->weights[j] = 1;
+}
+
+static void pricer_free(alg__Context ctx, Pricer *P) {
+  scratch_free(ctx, P->weights);
+}
+
+static int pricer_uses_bland(Pricer *P) {
+  return P->rule == alg__pricing_bland || P->num_stalls >= P->stall_limit;
+}
+
+static void pricer_note_pivot(Pricer *P, int is_degenerate) {
+  P->num_stalls = (is_degenerate ? P->num_stalls + 1 : 0);
+}
+
+// Returns the entering column in [lo, hi), or -1 if no score exceeds tol.
+static int pricer_choose(Pricer *P, int lo, int hi, ScoreFn score, void *data) {
+  if (pricer_uses_bland(P)) {
+    for (int j = lo; j < hi; ++j) {
+      if (score(data, j) > tol) return j;
+    }
+    return -1;
+  }
+
+  if (P->rule == alg__pricing_partial) {
+    // Use Dantzig's rule on the first window, starting after the last
+    // window used, that has any candidates.
+    int n = hi - lo;
+    for (int done = 0; done < n; done += P->partial_size) {
+      int   best     = -1;
+      float best_val = tol;
+      for (int t = done; t < done + P->partial_size && t < n; ++t) {
+        int   j = lo + (P->partial_start + t) % n;
+        float s = score(data, j);
+        if (s > best_val) {
+          best     = j;
+          best_val = s;
+        }
+      }
+      if (best != -1) {
+        P->partial_start = (P->partial_start + done + P->partial_size) % n;
+        return best;
+      }
+    }
+    return -1;
+  }
+
+  int   best     = -1;
+  float best_val = 0;
+  for (int j = lo; j < hi; ++j) {
+    float s = score(data, j);
+    if (s <= tol) continue;
+    float val = (P->rule == alg__pricing_dantzig ? s : s * s / P->weights[j]);
+    if (best == -1 || val > best_val) {
+      best     = j;
+      best_val = val;
+    }
+  }
+  return best;
+}
+
+// Updates devex reference weights for a pivot on column q, where row[j * stride]
+// is the pivot row entry in column j before the pivot, and the leaving column
+// is leave, or -1 if it is not priced.
+static void pricer_update_devex(Pricer *P, int lo, int hi, int q, int leave,
+                                float *row, int stride) {
+  if (P->rule != alg__pricing_devex) return;
+  float pivot = row[q * stride];
+  float w_q   = P->weights[q];
+  for (int j = lo; j < hi; ++j) {
+    float ratio = row[j * stride] / pivot;
+    if (j != q && ratio != 0) P->weights[j] = fmaxf(P->weights[j], ratio * ratio * w_q);
+  }
+  if (leave >= 0) P->weights[leave] = fmaxf(w_q / (pivot * pivot), 1);
+}
+
+// Sets basic_col[r] to the column of the basic variable for row r, or to -1
+// if there is none, for each row r >= row_start of the tableau.
+static void find_basic_cols(alg__Mat tab, int row_start, int *basic_col) {
+  int nrows = num_rows(tab);
+  for (int r = 0; r < nrows; ++r) basic_col[r] = -1;
+  for (int c = 1; c < num_cols(tab) - 1; ++c) {
+    int one_row = -1;
+    for (int r = 0; r < nrows; ++r) {
+      float val = elt(tab, r, c);
+      if (val == 0) continue;
+      if (one_row != -1 || val != 1 || r < row_start) {
+        one_row = -1;
+        break;
+      }
+      one_row = r;
+    }
+    if (one_row != -1 && basic_col[one_row] == -1) basic_col[one_row] = c;
+  }
+}
+
+static float tableau_score(void *tab, int j) {
+  return elt(((alg__Mat)tab), 0, j);
+}
+
+// The variable of a tableau column, numbered as in alg__PivotCallback.
+static int tableau_var(alg__Mat tab, Phase phase, int col) {
+  if (phase == phase2) return col - 1;
+  int m = num_rows(tab) - 2, n = num_cols(tab) - m - 3;
+  return (col <= m ? n + col - 1 : col - m - 2);
+}
+
+// Returns the objective row entry of column col of tab before any pivots.
+// In phase 1, this is -1 for the artificial columns; in phase 2, it's -c.
+static float tableau_cost(alg__Mat tab, Phase phase, alg__Mat c, int col) {
+  if (col == 0) return 1;
+  if (phase == phase1) return (col <= num_rows(tab) - 2 ? -1 : 0);
+  return (col <= num_rows(c) ? -col_elt(c, col - 1) : 0);
+}
+
+// Recomputes the objective row of tab from its constraint rows, where
+// basic_col[r] is the basic column of row r, or -1 for an artificial one
+// left in phase 2. Over many pivots, the objective row picks up roundoff
+// that can give a column a positive score it doesn't really have.
+static void tableau_reprice(alg__Mat tab, Phase phase, alg__Mat c, int *basic_col) {
+  int row_start = (phase == phase1 ? 2 : 1);
+  for (int col = 0; col < num_cols(tab); ++col) {
+    double val = tableau_cost(tab, phase, c, col);
+    for (int r = row_start; r < num_rows(tab); ++r) {
+      if (basic_col[r] == -1) continue;
+      val -= (double)tableau_cost(tab, phase, c, basic_col[r]) * elt(tab, r, col);
+    }
+    elt(tab, 0, col) = val;
+  }
+}
+
+// The steepest edge weights of a tableau are recomputed from scratch every
+// this many pivots, so that the roundoff of their updates doesn't build up.
+#define steepest_refresh_freq 64
+
+// Sets the steepest edge weight of each column c of tab to 1 + ||B^-1 A[c]||^2,
+// which is 1 plus the sum of squares of column c over the constraint rows.
+static void tableau_init_steepest(Pricer *P, alg__Mat tab, int row_start) {
+  int ncols = num_cols(tab) - 1;
+  for (int c = 1; c < ncols; ++c) P->weights[c] = 1;
+  for (int r = row_start; r < num_rows(tab); ++r) {
+    for (int c = 1; c < ncols; ++c) P->weights[c] += elt(tab, r, c) * elt(tab, r, c);
+  }
+}
+
+// Updates the steepest edge weights for a pivot on (row, col) of tab, before
+// the pivot is made, with the recurrence of Goldfarb and Reid: column c picks
+// up t = a_rc / a_rq times the pivot column a_q, so its new weight is
+// w_c - 2 t a_c^T a_q + t^2 w_q. The dot products come from one pass over
+// the rows where a_q is nonzero, kept in dots, which has a float per column.
+// The leaving column is leave, or -1 if it isn't priced.
+static void tableau_update_steepest(Pricer *P, alg__Mat tab, int row_start, int row,
+                                    int col, int leave, float *dots) {
+  if (P->rule != alg__pricing_steepest) return;
+  int ncols = num_cols(tab) - 1;
+  memset(dots, 0, ncols * sizeof(float));
+  for (int r = row_start; r < num_rows(tab); ++r) {
+    float a_rq = elt(tab, r, col);
+    if (a_rq == 0) continue;
+    int    inc;
+    float *row_r = row_ptr(tab, r, &inc);
+    vec_axpy(ncols, a_rq, row_r, inc, dots, 1);
+  }
+  double pivot = elt(tab, row, col);
+  double w_q   = 1 + dots[col];  // Exact, since a_q is at hand.
+  for (int c = 1; c < ncols; ++c) {
+    double t = elt(tab, row, c) / pivot;
+    if (c == col || t == 0) continue;
+    double w_old = P->weights[c], w = w_old - 2 * t * dots[c] + t * t * w_q;
+    if (w < 1e-3 * fmax(w_old, t * t * w_q)) {
+      // Most of the weight cancelled, leaving mostly roundoff; recompute it
+      // from the new column, which has t in the pivot row.
+      w = 1 + t * t;
+      for (int r = row_start; r < num_rows(tab); ++r) {
+        double a = elt(tab, r, c) - t * elt(tab, r, col);
+        if (r != row) w += a * a;
+      }
+    }
+    P->weights[c] = w;
+  }
+  if (leave >= 0) P->weights[leave] = fmax(w_q / (pivot * pivot), 1);
+}
+
+// The number of threads for the pivots of a tableau. A solve with a context
+// runs on the calling thread only.
+static int tableau_num_threads(alg__Context ctx, alg__LPOptions *opts) {
+  if (ctx) return 1;
+  return (opts->num_threads > 0 ? opts->num_threads : solver_num_threads());
+}
+
+// Runs the simplex method on tab. In phase 2, c is the cost vector of the LP,
+// which is only read to reprice the tableau.
+static alg__Status apply_lp(alg__Context ctx, alg__Mat tab, Phase phase, alg__Mat c,
+                            alg__LPOptions *opts) {
+
+  dbg_printf("At start of apply_lp (phase %d), tableau is:\n",
+             phase == phase1 ? 1 : 2);
+  dbg_print_matrix(tab);
+
+
+  int pivot_row_start = (phase == phase1 ? 2 : 1);
+  int last_col = num_cols(tab) - 1;
+
+  // In phase 1, we start by clearing the columns of the artificial variables;
+  // the one for row r is column r - 1.
+  if (phase == phase1) {
+    for (int r = 2; r < num_rows(tab); ++r) {
+      make_col_a_01_col(tab, r, r - 1, tableau_num_threads(ctx, opts));
+      dbg_printf("After clearing column %d, tableau is:\n", r - 1);
+      dbg_print_matrix(tab);
+    }
+  }
+
+  int *basic_col = scratch_alloc(ctx, num_rows(tab) * sizeof(int));
+  find_basic_cols(tab, pivot_row_start, basic_col);
+  Pricer P;
+  pricer_init(ctx, &P, opts, last_col);
+  float *dots = NULL;  // Scratch space for tableau_update_steepest.
+  if (P.rule == alg__pricing_steepest) {
+    dots = scratch_alloc(ctx, last_col * sizeof(float));
+    tableau_init_steepest(&P, tab, pivot_row_start);
+  }
+
+  alg__Status status = alg__status_ok;
+  int is_repriced = false;  // True if the objective row is fresh since the last pivot.
+  int num_pivots  = 0;
+  while (true) {
+    int use_bland = pricer_uses_bland(&P);
+    int pivot_col = pricer_choose(&P, 1, last_col, tableau_score, tab);
+    if (pivot_col == -1 && !is_repriced) {
+      // Check that no column's score was lost to roundoff before stopping.
+      tableau_reprice(tab, phase, c, basic_col);
+      is_repriced = true;
+      continue;
+    }
+    if (pivot_col == -1) break;
+
+    // Find the pivot row with the ratio test. Ties go to the smallest basic
+    // column under Bland's rule, and otherwise to the largest pivot entry.
+    int   pivot_row = -1;
+    float pivot_ratio = INFINITY;
+    for (int r = pivot_row_start; r < num_rows(tab); ++r) {
+      float entry = elt(tab, r, pivot_col);
+      if (entry < tol) continue;
+      float r_ratio = elt(tab, r, last_col) / entry;
+      int is_better = (pivot_row == -1 || r_ratio < pivot_ratio);
+      if (!is_better && r_ratio == pivot_ratio) {
+        is_better = (use_bland ? basic_col[r] < basic_col[pivot_row]
+                               : entry > elt(tab, pivot_row, pivot_col));
+      }
+      if (is_better) {
+        pivot_row   = r;
+        pivot_ratio = r_ratio;
+      }
+    }
+    if (pivot_row == -1 && !is_repriced) {
+      // Likewise, check that this score isn't roundoff.
+      tableau_reprice(tab, phase, c, basic_col);
+      is_repriced = true;
+      continue;
+    }
+    if (pivot_row == -1) {
+      alg__err_str = unbdd_soln_str;
+      status = alg__status_unbdd_soln;
+      break;
+    }
+    is_repriced = false;
+
+    dbg_printf("pivot is (0-indexed) row=%d, col=%d\n", pivot_row, pivot_col);
+    pricer_update_devex(&P, 1, last_col, pivot_col, basic_col[pivot_row],
+                        &elt(tab, pivot_row, 0), tab->is_transposed ? alg__ld(tab) : 1);
+    tableau_update_steepest(&P, tab, pivot_row_start, pivot_row, pivot_col,
+                            basic_col[pivot_row], dots);
+    int is_degenerate = (elt(tab, pivot_row, last_col) <= tol);
+    pricer_note_pivot(&P, is_degenerate);
+    make_col_a_01_col(tab, pivot_row, pivot_col, tableau_num_threads(ctx, opts));
+    stats_pivot(opts, phase, tableau_var(tab, phase, pivot_col),
+                tableau_var(tab, phase, basic_col[pivot_row]), is_degenerate,
+                elt(tab, 0, last_col));
+    basic_col[pivot_row] = pivot_col;
+    if (dots && ++num_pivots % steepest_refresh_freq == 0) {
+      tableau_init_steepest(&P, tab, pivot_row_start);
+    }
+    dbg_printf("After an iteration, the tableau is:\n");
+    dbg_print_matrix(tab);
+  }
+
+  if (dots) scratch_free(ctx, dots);
+  pricer_free(ctx, &P);
+  scratch_free(ctx, basic_col);
+  return status;
+}
+
+// The scratch bytes used by apply_lp on a tableau with the given size.
+static size_t apply_lp_bytes(int nrows, int ncols, alg__LPOptions *opts) {
+  int uses_dots = (opts->pricing == alg__pricing_steepest);
+  return scratch_bytes(nrows * sizeof(int)) +
+         (1 + uses_dots) * scratch_bytes((ncols - 1) * sizeof(float));
+}
+
+// Checks that an m x n matrix A is compatible with b, x, and c in
+// a linear program.
+static alg__Status check_lp_sizes(int m, int n, alg__Mat b, alg__Mat x, alg__Mat c) {
+  // Check that the size of A matches b, x, and c.
+  if (m != num_rows(b) ||
+      n != num_rows(x) ||
+      n != num_rows(c)) {
+    alg__err_str = "The input sizes of A, b, x, c do not all match.";
+    return alg__status_input_error;
+  }
+  // Check that x, b, and c are single-column matrices.
+  if (num_cols(x) != 1 || num_cols(b) != 1 || num_cols(c) != 1) {
+    alg__err_str = "x, b, and c are all expected to be single-column matrices.";
+    return alg__status_input_error;
+  }
+  return alg__status_ok;
+}
+
+// The largest phase 1 objective we accept as feasible. It starts at ||b||_1,
+// so the float roundoff left at the end of phase 1 scales with that.
+static float phase1_tol(alg__Mat b) {
+  float b_sum = 0;
+  for (int i = 0; i < num_rows(b); ++i) b_sum += fabsf(col_elt(b, i));
+  return tol * (1 + b_sum);
+}
+
+// L2 factorizations.
+//
+// A matrix of full rank is factored by Householder QR: of A when it is tall,
+// and of A^T otherwise. Otherwise the rows of A are factored by modified
+// Gram-Schmidt, which can skip the rows that depend on earlier ones.
+struct alg__L2FactorStruct {
+  int    m, n;      // A is m x n.
+  int    is_tall;   // If set, h factors A; otherwise it factors A^T.
+  float *h;         // The output of house_qr, or NULL if A lacks full rank.
+  float *tau;       // The reflector scales from house_qr.
+  float *q;         // Without h, the n x m matrix Q in row-major order, with A^T = Q R.
+  float *r;         // Without h, the m x m upper triangular R in row-major order.
+  float *work;      // Scratch space for alg__l2_solve.
+  int    work_cap;  // The number of floats allocated for work.
+  alg__Context ctx; // The arrays above come from its scratch memory, if set.
+};
+
+static alg__L2Factor l2_factor(alg__Context ctx, alg__Mat A);
+static void          l2_factor_free(alg__L2Factor F);
+static size_t        l2_factor_bytes(int m, int n);
+
+// Iterative refinement.
+//
+// A solution x found in float is improved by finding the residual
+// r = b - A x in double, and then solving A d = r in float for a correction
+// x += d. Each step gains about as many digits as the float solve gets
+// right, so a few steps reach nearly double precision unless A is badly
+// conditioned.
+
+#define max_refine_steps 10
+
+static void set_elt64(alg__Mat M, int i, int j, double val) {
+  if (M->data64) alg__elt64(M, i, j) = val;
+  elt(M, i, j) = val;
+}
+
+// Solves A A^T e = r in place for a wide A of full rank, where A A^T = R^T R.
+static void l2_solve_normal(alg__L2Factor F, float *r) {
+  int p = F->n, q = F->m;
+  const float *h = F->h;
+  for (int i = 0; i < q; ++i) {
+    r[i] = (r[i] - vec_dot(i, h + (size_t)i * p, 1, r, 1)) / h[i + (size_t)i * p];
+  }
+  for (int i = q - 1; i >= 0; --i) {
+    float sum = r[i];
+    for (int j = i + 1; j < q; ++j) sum -= h[i + (size_t)j * p] * r[j];
+    r[i] = sum / h[i + (size_t)i * p];
+  }
+}
+
+// Refines x, a solution of A_J x = B[c] for the k columns cols[0..k) of A,
+// where F = alg__l2_factor(A_J). When A_J is wide, corrections to x would
+// drift out of its row span, so instead x = A_J^T y is kept exactly, with
+// corrections to y from A_J A_J^T e = r.
+// Temporaries come from the scratch memory of F->ctx.
+static void refine_solution(alg__L2Factor F, alg__Mat A, const int *cols, int k,
+                            alg__Mat B, int c, double *x) {
+  alg__Context ctx = F->ctx;
+  int m = num_rows(A), use_y = (F->h && !F->is_tall && m < k);
+  alg__Mat r_f    = alloc_tmp_matrix(ctx, m, 1);
+  alg__Mat d_f    = alloc_tmp_matrix(ctx, k, 1);
+  double  *r      = scratch_alloc(ctx, m * sizeof(double));
+  double  *prev_x = scratch_alloc(ctx, k * sizeof(double));
+  double  *y      = scratch_alloc(ctx, m * sizeof(double));
+  double  *prev_y = scratch_alloc(ctx, m * sizeof(double));
+  double   prev_norm = INFINITY;
+  memset(y, 0, m * sizeof(double));
+  if (use_y) memset(x, 0, k * sizeof(double));
+
+  for (int step = 0; step <= max_refine_steps; ++step) {
+    // Find r, and stop once each entry is within roundoff of its terms.
+    double norm    = 0;
+    int    is_done = true;
+    for (int i = 0; i < m; ++i) {
+      double sum = elt64(B, i, c), scale = fabs(sum);
+      for (int t = 0; t < k; ++t) {
+        double term = elt64(A, i, cols[t]) * x[t];
+        sum   -= term;
+        scale += fabs(term);
+      }
+      r[i] = sum;
+      norm = fmax(norm, fabs(sum));
+      if (fabs(sum) > 4 * DBL_EPSILON * scale) is_done = false;
+    }
+    if (norm >= prev_norm) {
+      // The last step made things worse.
+      memcpy(x, prev_x, k * sizeof(double));
+      memcpy(y, prev_y, m * sizeof(double));
+      break;
+    }
+    if (is_done || step == max_refine_steps) break;
+    prev_norm = norm;
+    memcpy(prev_x, x, k * sizeof(double));
+    memcpy(prev_y, y, m * sizeof(double));
+
+    // Solve for the correction, with r scaled to keep it away from float
+    // underflow.
+    for (int i = 0; i < m; ++i) col_elt(r_f, i) = r[i] / norm;
+    if (use_y) {
+      l2_solve_normal(F, r_f->data);
+      for (int i = 0; i < m; ++i) y[i] += norm * col_elt(r_f, i);
+      for (int t = 0; t < k; ++t) {
+        x[t] = 0;
+        for (int i = 0; i < m; ++i) x[t] += elt64(A, i, cols[t]) * y[i];
+      }
+    } else {
+      if (alg__l2_solve(F, r_f, d_f) != alg__status_ok) break;
+      for (int t = 0; t < k; ++t) x[t] += norm * col_elt(d_f, t);
+    }
+  }
+
+  scratch_free(ctx, prev_y);
+  scratch_free(ctx, y);
+  scratch_free(ctx, prev_x);
+  scratch_free(ctx, r);
+  free_tmp_matrix(ctx, d_f);
+  free_tmp_matrix(ctx, r_f);
+}
+
+// The scratch bytes used by refine_solution.
+static size_t refine_solution_bytes(int m, int k) {
+  return tmp_matrix_bytes(m, 1) + tmp_matrix_bytes(k, 1) +
+         3 * scratch_bytes(m * sizeof(double)) + scratch_bytes(k * sizeof(double));
+}
+
+// Refines the basic variables of x, the solution of an LP with the basis
+// head, where variable n + i is the artificial of row i. The nonbasic
+// variables keep their values.
+static void refine_lp_solution(alg__Context ctx, alg__Mat A, alg__Mat b, alg__Mat x,
+                               const int *head) {
+  int m = num_rows(A), n = num_cols(A), k = 0;
+  int  *cols     = scratch_alloc(ctx, (m > 0 ? m : 1) * sizeof(int));
+  char *is_basic = scratch_alloc(ctx, (n > 0 ? n : 1));
+  memset(is_basic, 0, n);
+  for (int p = 0; p < m; ++p) {
+    if (head[p] < n) is_basic[cols[k++] = head[p]] = 1;
+  }
+  for (int j = 0; j < n; ++j) set_elt64(x, j, 0, col_elt(x, j));
+
+  // The basic variables solve A_J x_J = b - A_N x_N.
+  alg__Mat b_N = alloc_tmp_matrix(ctx, m, 1);
+  b_N->data64  = scratch_alloc(ctx, (m > 0 ? m : 1) * sizeof(double));
+  for (int i = 0; i < m; ++i) {
+    double sum = elt64(b, i, 0);
+    for (int j = 0; j < n; ++j) {
+      if (!is_basic[j] && col_elt(x, j) != 0) sum -= elt64(A, i, j) * elt64(x, j, 0);
+    }
+    set_elt64(b_N, i, 0, sum);
+  }
+  if (k > 0) {
+    alg__Mat A_J = alloc_tmp_matrix(ctx, m, k);
+    double  *x_J = scratch_alloc(ctx, k * sizeof(double));
+    for (int t = 0; t < k; ++t) {
+      for (int i = 0; i < m; ++i) elt(A_J, i, t) = elt(A, i, cols[t]);
+      x_J[t] = col_elt(x, cols[t]);
+    }
+    alg__L2Factor F = l2_factor(ctx, A_J);
+    refine_solution(F, A, cols, k, b_N, 0, x_J);
+    for (int t = 0; t < k; ++t) set_elt64(x, cols[t], 0, x_J[t]);
+    l2_factor_free(F);
+    scratch_free(ctx, x_J);
+    free_tmp_matrix(ctx, A_J);
+  }
+  scratch_free(ctx, b_N->data64);
+  free_tmp_matrix(ctx, b_N);
+  scratch_free(ctx, is_basic);
+  scratch_free(ctx, cols);
+}
+
+// The scratch bytes used by refine_lp_solution, with at most min(m, n) basic
+// structural columns.
+static size_t refine_lp_bytes(int m, int n) {
+  int k = min(m, n);
+  return scratch_bytes((m > 0 ? m : 1) * sizeof(int)) + scratch_bytes(n > 0 ? n : 1) +
+         tmp_matrix_bytes(m, 1) + scratch_bytes((m > 0 ? m : 1) * sizeof(double)) +
+         tmp_matrix_bytes(m, k) +
+         scratch_bytes(k * sizeof(double)) + l2_factor_bytes(m, k) +
+         refine_solution_bytes(m, k);
+}
+
+// Warm start bases.
+
+struct alg__BasisStruct {
+  int   is_set;  // False until a solve stores a basis.
+  int   m, n;    // The shape of A.
+  int  *head;    // The m basic variables; variable n + i is the artificial of row i.
+  char *at_hi;   // at_hi[j] is true if nonbasic variable j is at its upper bound.
+};
+
+// Returns true if basis holds m distinct variables for an m x n problem.
+static int basis_fits(alg__Context ctx, alg__Basis basis, int m, int n) {
+  if (basis == NULL || !basis->is_set || basis->m != m || basis->n != n) return false;
+  char *is_used = scratch_alloc(ctx, n + m);
+  memset(is_used, 0, n + m);
+  int fits = true;
+  for (int p = 0; p < m && fits; ++p) {
+    int j = basis->head[p];
+    fits  = (0 <= j && j < n + m && !is_used[j]);
+    if (fits) is_used[j] = 1;
+  }
+  scratch_free(ctx, is_used);
+  return fits;
+}
+
+// This clears at_hi; callers with upper bounds set it afterwards.
+static void basis_store(alg__Basis basis, int m, int n, int *head) {
+  if (basis == NULL) return;
+  if (basis->head == NULL || basis->m != m) {
+    basis->head = realloc(basis->head, (m > 0 ? m : 1) * sizeof(int));
+  }
+  if (basis->at_hi == NULL || basis->n != n) basis->at_hi = realloc(basis->at_hi, n + 1);
+  memcpy(basis->head, head, m * sizeof(int));
+  memset(basis->at_hi, 0, n);
+  basis->is_set = true;
+  basis->m      = m;
+  basis->n      = n;
+}
+
+// Sets up the phase 2 tableau for A, b, and c directly from the given basis.
+// Returns false if the basis doesn't fit, is singular, or is infeasible for b.
+static int tableau_warm_start(alg__Context ctx, alg__Mat tab, alg__Mat A, alg__Mat b,
+                              alg__Mat c, alg__Basis basis, int num_threads) {
+  int m = num_rows(A), n = num_cols(A), last_col = n + 1;
+  if (!basis_fits(ctx, basis, m, n)) return false;
+
+  set_zero(tab);
+  elt(tab, 0, 0) = 1;
+  for (int j = 0; j < n; ++j) elt(tab, 0, j + 1) = -col_elt(c, j);
+  for (int i = 0; i < m; ++i) {
+    for (int j = 0; j < n; ++j) elt(tab, i + 1, j + 1) = elt(A, i, j);
+    elt(tab, i + 1, last_col) = col_elt(b, i);
+  }
+
+  // Pivot each basic column in, choosing the largest entry among the rows
+  // still free. The rows of basic artificial variables are never used.
+  char *row_used = scratch_alloc(ctx, m + 1);
+  memset(row_used, 0, m + 1);
+  for (int p = 0; p < m; ++p) {
+    if (basis->head[p] >= n) row_used[basis->head[p] - n + 1] = 1;
+  }
+  int is_ok = true;
+  for (int p = 0; p < m && is_ok; ++p) {
+    int col = basis->head[p] + 1;
+    if (col > n) continue;
+    int   row = -1;
+    float big = tol;
+    for (int r = 1; r <= m; ++r) {
+      if (!row_used[r] && fabs(elt(tab, r, col)) > big) {
+        row = r;
+        big = fabs(elt(tab, r, col));
+      }
+    }
+    is_ok = (row != -1);
+    if (is_ok) {
+      make_col_a_01_col(tab, row, col, num_threads);
+      row_used[row] = 1;
+    }
+  }
+  scratch_free(ctx, row_used);
+
+  // The basis is feasible when each basic variable is nonnegative and each
+  // artificial one is zero.
+  float feas_tol = phase1_tol(b);
+  for (int p = 0; p < m && is_ok; ++p) {
+    if (basis->head[p] < n) continue;
+    is_ok = (fabs(elt(tab, basis->head[p] - n + 1, last_col)) <= feas_tol);
+  }
+  for (int r = 1; r <= m && is_ok; ++r) {
+    is_ok = (elt(tab, r, last_col) >= -tol);
+    elt(tab, r, last_col) = fmaxf(elt(tab, r, last_col), 0);
+  }
+  return is_ok;
+}
+
+// Binary files.
+//
+// A matrix file starts with a FileHeader, and each of its arrays follows at
+// an offset that is a multiple of file_align, so that a mapping of the file
+// can be used in place. A dense matrix stores data, and data64 if it has
+// it, as nrows x ncols arrays in row-major order, along with its
+// is_transposed flag. A sparse matrix stores start, idx, and vals. Numbers
+// are in the byte order of the machine that wrote the file, which
+// byte_order records so that other machines can reject it.
+
+#define file_magic   "calgebra"
+#define file_version 1
+#define file_align   64
+#define file_order   0x01020304
+
+enum { file_dense, file_sparse };
+enum { file_transposed = 1, file_has_data64 = 2, file_csr = 4 };
+
+typedef struct {
+  char     magic[8];
+  uint32_t version, byte_order, kind, flags;
+  int64_t  nrows, ncols, nnz;  // For a dense matrix, nnz is nrows * ncols.
+  uint64_t offset[3];          // Where each array starts, or 0 if it's absent.
+} FileHeader;
+
+// Returns the offset of the next array after one of the given bytes at offset.
+static uint64_t file_next(uint64_t offset, uint64_t bytes) {
+  return (offset + bytes + file_align - 1) / file_align * file_align;
+}
+
+// Writes nrows rows of ncols entries of the given size, ld entries apart,
+// at offset *pos, which then moves past them and the padding after them.
+// Contiguous rows go out in a single write. Returns false on an error.
+static int file_write(FILE *f, const void *data, size_t size, int nrows, int ncols, int ld,
+                      uint64_t *pos) {
+  static const char zeros[file_align];
+  size_t row_bytes = size * ncols;
+  int    ok        = true;
+  if (ld == ncols || nrows <= 1) {
+    ok = (fwrite(data, 1, row_bytes * nrows, f) == row_bytes * nrows);
+  } else {
+    for (int i = 0; i < nrows && ok; ++i) {
+      ok = (fwrite((const char *)data + size * ld * i, 1, row_bytes, f) == row_bytes);
+    }
+  }
+  uint64_t next = file_next(*pos, row_bytes * nrows);
+  size_t   pad  = next - *pos - row_bytes * nrows;
+  *pos = next;
+  return ok && fwrite(zeros, 1, pad, f) == pad;
+}
+
+// An array to write: nrows rows of ncols entries of the given size, ld
+// entries apart.
+typedef struct { const void *data; size_t size; int nrows, ncols, ld; } FileArray;
+
+// Writes h, with its offsets set, and then the arrays to a new file at path.
+static alg__Status file_save(const char *path, FileHeader *h, FileArray *arrays, int num_arrays) {
+  memcpy(h->magic, file_magic, sizeof(h->magic));
+  h->version    = file_version;
+  h->byte_order = file_order;
+  uint64_t pos  = file_next(0, sizeof(FileHeader));
+  for (int i = 0; i < num_arrays; ++i) {
+    h->offset[i] = pos;
+    pos = file_next(pos, (uint64_t)arrays[i].size * arrays[i].nrows * arrays[i].ncols);
+  }
+
+  FILE *f = fopen(path, "wb");
+  if (f == NULL) {
+    alg__err_str = "The file couldn't be opened for writing.";
+    return alg__status_input_error;
+  }
+  pos = 0;
+  int ok = file_write(f, h, sizeof(FileHeader), 1, 1, 0, &pos);
+  for (int i = 0; i < num_arrays && ok; ++i) {
+    FileArray *a = &arrays[i];
+    ok = file_write(f, a->data, a->size, a->nrows, a->ncols, a->ld, &pos);
+  }
+  if (fclose(f) != 0) ok = false;
+  if (!ok) {
+    alg__err_str = "The file couldn't be written.";
+    return alg__status_input_error;
+  }
+  return alg__status_ok;
+}
+
+// Maps the file at path privately, so that writes to the mapping stay in
+// memory, and checks its header. Returns the header, which is the start of
+// the mapping, or NULL with alg__err_str set.
+static FileHeader *file_map(const char *path, uint32_t kind, size_t *map_size) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    alg__err_str = "The file couldn't be opened for reading.";
+    return NULL;
+  }
+  struct stat st;
+  void *map = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(FileHeader)) {
+    map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (map == MAP_FAILED) {
+    alg__err_str = "The file couldn't be mapped.";
+    return NULL;
+  }
+  *map_size = st.st_size;
+
+  FileHeader *h = map;
+  const char *err_str = NULL;
+  if (memcmp(h->magic, file_magic, sizeof(h->magic)) != 0) {
+    err_str = "The file is not a calgebra matrix.";
+  } else if (h->version != file_version || h->byte_order != file_order) {
+    err_str = "The file has a version or byte order that this build can't read.";
+  } else if (h->kind != kind) {
+    err_str = (kind == file_dense ? "The file holds a sparse matrix." :
+                                    "The file holds a dense matrix.");
+  } else if (h->nrows < 0 || h->ncols < 0 || h->nnz < 0 ||
+             h->nrows > INT_MAX || h->ncols > INT_MAX) {
+    err_str = "The file has an invalid size.";
+  }
+  if (err_str) {
+    munmap(map, *map_size);
+    alg__err_str = err_str;
+    return NULL;
+  }
+  return h;
+}
+
+// Returns a pointer to array i of the mapped file h, which is expected to
+// have the given bytes, or NULL if it isn't aligned or runs past the end.
+static void *file_array(FileHeader *h, size_t map_size, int i, uint64_t bytes) {
+  uint64_t offset = h->offset[i];
+  if (offset % file_align != 0 || offset < sizeof(FileHeader) || offset > map_size ||
+      bytes > map_size - offset) {
+    return NULL;
+  }
+  return (char *)h + offset;
+}
+
+// Sparse matrix helpers.
+
+static alg__SpMat sp_alloc(int nrows, int ncols, int nnz, int is_csr) {
+  alg__SpMat A = malloc(sizeof(alg__SpMatStruct));
+  int nmajor   = (is_csr ? nrows : ncols);
+  *A = (alg__SpMatStruct) {
+         .vals   = malloc(nnz * sizeof(float)),
+         .idx    = malloc(nnz * sizeof(int)),
+         .start  = calloc(nmajor + 1, sizeof(int)),
+         .nrows  = nrows,
+         .ncols  = ncols,
+         .nnz    = nnz,
+         .is_csr = is_csr };
+  return A;
+}
+
+// Returns a new copy of A in the other storage order (CSC <-> CSR).
+// The minor indices of the result come out sorted.
+static alg__SpMat sp_switch_format(alg__SpMat A) {
+  int nmajor = (A->is_csr ? A->nrows : A->ncols);
+  int nminor = (A->is_csr ? A->ncols : A->nrows);
+  alg__SpMat B = sp_alloc(A->nrows, A->ncols, A->nnz, !A->is_csr);
+  for (int t = 0; t < A->nnz; ++t) B->start[A->idx[t] + 1]++;
+  for (int i = 0; i < nminor; ++i) B->start[i + 1] += B->start[i];
+  int *next = malloc(nminor * sizeof(int));
+  memcpy(next, B->start, nminor * sizeof(int));
+  for (int j = 0; j < nmajor; ++j) {
+    for (int t = A->start[j]; t < A->start[j + 1]; ++t) {
+      int u = next[A->idx[t]]++;
+      B->idx[u]  = j;
+      B->vals[u] = A->vals[t];
+    }
+  }
+  free(next);
+  return B;
+}
+
+// Returns a pointer to the value of entry (i, j), or NULL if it's not stored.
+static float *sp_find(alg__SpMat A, int i, int j) {
+  int major = (A->is_csr ? i : j);
+  int minor = (A->is_csr ? j : i);
+  int lo = A->start[major], hi = A->start[major + 1];
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (A->idx[mid] == minor) return A->vals + mid;
+    if (A->idx[mid] <  minor) lo = mid + 1;
+    else                      hi = mid;
+  }
+  return NULL;
+}
+
+// Returns < A[j], y > for a CSC matrix A and a dense vector y.
+static float sp_col_dot(alg__SpMat A, int j, float *y) {
+  float sum = 0;
+  for (int t = A->start[j]; t < A->start[j + 1]; ++t) sum += A->vals[t] * y[A->idx[t]];
+  return sum;
+}
+
+// Sets v += a * A[j] for a CSC matrix A and a dense vector v.
+static void sp_col_axpy(alg__SpMat A, int j, float a, float *v) {
+  for (int t = A->start[j]; t < A->start[j + 1]; ++t) v[A->idx[t]] += a * A->vals[t];
+}
+
+// Sets y = A x, or y = A^T x if transpose is true.
+static void sp_matvec(alg__SpMat A, double *x, double *y, int transpose) {
+  int nmajor = (A->is_csr ? A->nrows : A->ncols);
+  // Each major line is a row of A (CSR) or of A^T (CSC); these need dots.
+  int use_dots = (A->is_csr != transpose);
+  if (!use_dots) memset(y, 0, (transpose ? A->ncols : A->nrows) * sizeof(double));
+  for (int j = 0; j < nmajor; ++j) {
+    double sum = 0;
+    for (int t = A->start[j]; t < A->start[j + 1]; ++t) {
+      if (use_dots) sum += A->vals[t] * x[A->idx[t]];
+      else          y[A->idx[t]] += A->vals[t] * x[j];
+    }
+    if (use_dots) y[j] = sum;
+  }
+}
+
+static double vec_dot_d(double *x, double *y, int n) {
+  double sum = 0;
+  for (int i = 0; i < n; ++i) sum += x[i] * y[i];
+  return sum;
+}
+
+
+// The revised simplex method.
+//
+// Instead of rewriting a full tableau on every pivot, we keep a factorization
+// of the current basis matrix B and compute only what a pivot needs: the
+// reduced costs c_j - y^T A[j] with B^T y = c_B (a btran), and the entering
+// column B^-1 A[q] (an ftran).
+//
+// Artificial variables have unit columns +-e_i. Basic ones are handled
+// implicitly, so only the kernel K - the structural basic columns restricted
+// to the rows not covered by a basic unit column - is factored as a dense
+// P K = L U. Each pivot appends an eta vector in product form, and the
+// kernel is refactored every refactor_freq pivots. The kernel is dense, so
+// once most basic variables are structural it takes O(m^2) memory and each
+// refactor takes O(m^3) time; what this saves over the tableau is the
+// O(m (n + m)) rewrite on every pivot, not memory on such problems.
+//
+// Structural variables have bounds lo <= x_j <= hi, either of which may be
+// infinite. A nonbasic variable sits at a value xN[j], which is one of its
+// bounds, or zero if it is free; it may enter the basis moving in either
+// direction, and it may also jump to its other bound without a basis change.
+// With abs_cost set, the objective is sum_j cost[j] |x_j| over free x_j: a
+// basic x_j is held to the side of zero it entered on, and leaves the basis
+// when it reaches zero, so that its cost stays linear.
+
+#define default_refactor_freq 64
+
+// The bounds of a linear program: lo <= x <= hi, where lo is zero and hi is
+// infinite if NULL. If abs_cost is set, the bounds are ignored, every
+// variable is free, and the objective is sum_j c_j |x_j|.
+typedef struct {
+  alg__Mat lo, hi;
+  int      abs_cost;
+} Bounds;
+
+// The stages of a revised simplex solve, in the order they run. The dual
+// stage only runs from a stored basis.
+typedef enum { stage_dual, stage_phase1, stage_phase2, stage_done } Stage;
+
+typedef struct {
+  alg__Context ctx;   // Every array below comes from its scratch memory.
+  int    m, n;        // A is m x n; variable n + i is the artificial of row i.
+  alg__Mat A;
+  alg__SpMat sp;      // If not NULL, this is used in place of A; it's in CSC form.
+  float *b;           // The right-hand side, size m.
+  float *sign;        // The artificial of row i has column sign[i] * e_i.
+  float *cost;        // Per-variable costs in the current phase, size n + m.
+  int   *head;        // head[p] is the variable in basis position p.
+  int   *pos;         // pos[j] is the basis position of variable j, or -1.
+  float *xB;          // Basic variable values, indexed by position.
+  float *lo, *hi;     // The current bounds of the structural variables.
+  float *xN;          // The values of the nonbasic structural variables.
+  int    abs_cost;    // See Bounds.
+  float  feas_tol;    // The largest phase 1 objective accepted as feasible.
+
+  // The basis as of the last refactor.
+  int    k;           // The kernel size.
+  int   *kvar;        // Kernel column q is variable kvar[q] ...
+  int   *kpos;        // ... at basis position kpos[q].
+  int   *krow;        // Kernel row r is row krow[r] of A.
+  int   *cover;       // cover[i] is the position of row i's unit column, or -1.
+  float *lu;          // The k x k LU factors of the kernel, row-major.
+  int    lu_cap;      // The number of floats allocated for lu; m * m with a context.
+  int   *perm;
+
+  // The eta file. Eta e replaced basis position eta_pos[e] with pivot value
+  // eta_piv[e]; its other nonzeros are (eta_idx[t], eta_val[t]) for
+  // eta_start[e] <= t < eta_start[e + 1].
+  int    neta, eta_cap;
+  int   *eta_pos, *eta_start, *eta_idx;
+  float *eta_piv, *eta_val;
+
+  int    refactor_freq;
+  Pricer pricer;      // Its weights cover the structural columns.
+  float *y;           // The current simplex multipliers; B^T y = c_B.
+  float *rho, *tau;   // Rows of B^-1 and B^-T alpha for devex and steepest edge.
+  float *prow;        // The pivot row of B^-1 A for devex and steepest edge.
+  float *work, *work2, *work3;  // Scratch vectors of size m.
+  alg__LPOptions *opts;  // For its stats and on_pivot callback.
+  Phase  phase;
+  Stage  stage;
+
+  // The budget of a step of alg__step_lp; there is no limit otherwise.
+  int    step_pivots;  // The basis changes made so far in this step.
+  int    max_pivots;   // 0 for no limit.
+  double deadline;    // In now_seconds() time; INFINITY for no limit.
+} Simplex;
+
+#define is_artif(S, j) ((j) >= (S)->n)
+
+// Artificial variables are bounded by 0 <= x_j.
+#define var_lo(S, j) (is_artif(S, j) ? 0        : (S)->lo[j])
+#define var_hi(S, j) (is_artif(S, j) ? INFINITY : (S)->hi[j])
+
+// The cost of variable j while it's basic. A variable with an absolute value
+// cost is held below zero exactly when its upper bound is zero.
+static float basic_cost(Simplex *S, int j) {
+  if (S->abs_cost && !is_artif(S, j) && S->hi[j] == 0) return -S->cost[j];
+  return S->cost[j];
+}
+
+// Returns < A[j], y > for variable j, where y has one entry per row.
+static float col_dot(Simplex *S, int j, float *y) {
+  if (is_artif(S, j)) return S->sign[j - S->n] * y[j - S->n];
+  if (S->sp) return sp_col_dot(S->sp, j, y);
+  int    inc;
+  float *a = col_ptr(S->A, j, &inc);
+  return vec_dot(S->m, a, inc, y, 1);
+}
+
+// Sets v += a * A[j] for variable j.
+static void col_axpy(Simplex *S, int j, float a, float *v) {
+  if (is_artif(S, j)) {
+    v[j - S->n] += a * S->sign[j - S->n];
+    return;
+  }
+  if (S->sp) {
+    sp_col_axpy(S->sp, j, a, v);
+    return;
+  }
+  int    inc;
+  float *col = col_ptr(S->A, j, &inc);
+  vec_axpy(S->m, a, col, inc, v, 1);
+}
+
+static void load_col(Simplex *S, int j, float *v) {
+  memset(v, 0, S->m * sizeof(float));
+  col_axpy(S, j, 1, v);
+}
+
+// Factors the n x n row-major matrix a in place as P a = L U with partial
+// pivoting; L has a unit diagonal and is stored below it. Row i of P a is
+// row perm[i] of a. Returns false if a is numerically singular.
+static int lu_factor(float *a, int n, int *perm) {
+  float max_abs = 0;
+  for (int i = 0; i < n * n; ++i) max_abs = fmaxf(max_abs, fabsf(a[i]));
+  for (int i = 0; i < n; ++i) perm[i] = i;
+  for (int c = 0; c < n; ++c) {
+    int p = c;
+    for (int r = c + 1; r < n; ++r) {
+      if (fabsf(a[r * n + c]) > fabsf(a[p * n + c])) p = r;
+    }
+    if (fabsf(a[p * n + c]) <= 1e-6 * max_abs) return false;
+    if (p != c) {
+      for (int j = 0; j < n; ++j) {
+        float t = a[p * n + j]; a[p * n + j] = a[c * n + j]; a[c * n + j] = t;
+      }
+      int t = perm[p]; perm[p] = perm[c]; perm[c] = t;
+    }
+    float inv = 1.0 / a[c * n + c];
+    for (int r = c + 1; r < n; ++r) {
+      float f = (a[r * n + c] *= inv);
+      if (f == 0) continue;
+      vec_axpy(n - c - 1, -f, a + c * n + c + 1, 1, a + r * n + c + 1, 1);
+    }
+  }
+  return true;
+}
+
+// Solves (L U) z = P x for z, overwriting x; tmp has room for n floats.
+static void lu_solve(float *a, int n, int *perm, float *x, float *tmp) {
+  for (int i = 0; i < n; ++i) tmp[i] = x[perm[i]];
+  for (int i = 0; i < n; ++i) tmp[i] -= vec_dot(i, a + i * n, 1, tmp, 1);
+  for (int i = n - 1; i >= 0; --i) {
+    tmp[i] -= vec_dot(n - i - 1, a + i * n + i + 1, 1, tmp + i + 1, 1);
+    tmp[i] /= a[i * n + i];
+  }
+  memcpy(x, tmp, n * sizeof(float));
+}
+
+// Solves the transposed system a^T z = x, overwriting x.
+static void lu_solve_t(float *a, int n, int *perm, float *x, float *tmp) {
+  // U^T L^T P z = x.
+  for (int i = 0; i < n; ++i) {
+    x[i] -= vec_dot(i, a + i, n, x, 1);
+    x[i] /= a[i * n + i];
+  }
+  for (int i = n - 1; i >= 0; --i) {
+    x[i] -= vec_dot(n - i - 1, a + (i + 1) * n + i, n, x + i + 1, 1);
+  }
+  for (int i = 0; i < n; ++i) tmp[perm[i]] = x[i];
+  memcpy(x, tmp, n * sizeof(float));
+}
+
+// Solves B z = v, where v is indexed by row and z by basis position.
+// The vector v is overwritten with scratch values.
+static void simplex_ftran(Simplex *S, float *v, float *z) {
+  float *w = S->work3;
+  for (int r = 0; r < S->k; ++r) w[r] = v[S->krow[r]];
+  lu_solve(S->lu, S->k, S->perm, w, z);
+  for (int q = 0; q < S->k; ++q) col_axpy(S, S->kvar[q], -w[q], v);
+  for (int i = 0; i < S->m; ++i) {
+    if (S->cover[i] >= 0) z[S->cover[i]] = v[i] / S->sign[i];
+  }
+  for (int q = 0; q < S->k; ++q) z[S->kpos[q]] = w[q];
+
+  for (int e = 0; e < S->neta; ++e) {
+    int p = S->eta_pos[e];
+    if (z[p] == 0) continue;
+    float zp = (z[p] /= S->eta_piv[e]);
+    for (int t = S->eta_start[e]; t < S->eta_start[e + 1]; ++t) {
+      z[S->eta_idx[t]] -= S->eta_val[t] * zp;
+    }
+  }
+}
+
+// Solves B^T y = v, where v is indexed by basis position and y by row.
+// The vector v is overwritten with scratch values.
+static void simplex_btran(Simplex *S, float *v, float *y) {
+  for (int e = S->neta - 1; e >= 0; --e) {
+    int   p = S->eta_pos[e];
+    float s = v[p];
+    for (int t = S->eta_start[e]; t < S->eta_start[e + 1]; ++t) {
+      s -= S->eta_val[t] * v[S->eta_idx[t]];
+    }
+    v[p] = s / S->eta_piv[e];
+  }
+
+  for (int i = 0; i < S->m; ++i) {
+    y[i] = (S->cover[i] >= 0 ? v[S->cover[i]] / S->sign[i] : 0);
+  }
+  float *w = S->work3;
+  for (int q = 0; q < S->k; ++q) w[q] = v[S->kpos[q]] - col_dot(S, S->kvar[q], y);
+  lu_solve_t(S->lu, S->k, S->perm, w, v);
+  for (int r = 0; r < S->k; ++r) y[S->krow[r]] = w[r];
+}
+
+// Factors the current basis from scratch and recomputes xB.
+// Returns false if the basis is singular.
+static int simplex_refactor(Simplex *S) {
+  int m = S->m;
+  S->k = 0;
+  for (int i = 0; i < m; ++i) S->cover[i] = -1;
+  for (int p = 0; p < m; ++p) {
+    int j = S->head[p];
+    if (is_artif(S, j)) {
+      S->cover[j - S->n] = p;
+    } else {
+      S->kvar[S->k] = j;
+      S->kpos[S->k] = p;
+      S->k++;
+    }
+  }
+  int k = 0;
+  for (int i = 0; i < m; ++i) {
+    if (S->cover[i] == -1) S->krow[k++] = i;
+  }
+  if (k != S->k) return false;
+
+  if (k * k > S->lu_cap) {
+    scratch_free(S->ctx, S->lu);
+    S->lu_cap = k * k;
+    S->lu     = scratch_alloc(S->ctx, (size_t)S->lu_cap * sizeof(float));
+  }
+  for (int q = 0; q < k; ++q) {
+    load_col(S, S->kvar[q], S->work);
+    for (int r = 0; r < k; ++r) S->lu[r * k + q] = S->work[S->krow[r]];
+  }
+  S->neta = 0;
+  if (!lu_factor(S->lu, k, S->perm)) return false;
+
+  // B xB = b - A_N xN.
+  memcpy(S->work, S->b, m * sizeof(float));
+  for (int j = 0; j < S->n; ++j) {
+    if (S->pos[j] == -1 && S->xN[j] != 0) col_axpy(S, j, -S->xN[j], S->work);
+  }
+  simplex_ftran(S, S->work, S->xB);
+  return true;
+}
+
+// Returns false once the budget of the current step is used up. Only basis
+// changes count against it, and each step makes at least one.
+static int simplex_can_pivot(Simplex *S) {
+  return S->step_pivots == 0 ||
+         (S->step_pivots != S->max_pivots &&
+          (S->deadline == INFINITY || now_seconds() < S->deadline));
+}
+
+// The objective of the current phase at the current x.
+static double simplex_objective(Simplex *S) {
+  double obj = 0;
+  for (int p = 0; p < S->m; ++p) {
+    float xj = S->xB[p];
+    obj += S->cost[S->head[p]] * (S->abs_cost ? fabsf(xj) : xj);
+  }
+  for (int j = 0; j < S->n; ++j) {
+    if (S->pos[j] == -1) obj += S->cost[j] * (S->abs_cost ? fabsf(S->xN[j]) : S->xN[j]);
+  }
+  return obj;
+}
+
+// Brings variable q into the basis at position r, where alpha = B^-1 A[q],
+// after changing x_q by step.
+static int simplex_pivot(Simplex *S, int q, int r, float *alpha, float step) {
+  for (int p = 0; p < S->m; ++p) S->xB[p] -= step * alpha[p];
+  S->xB[r] = S->xN[q] + step;
+
+  // Append the eta vector for this pivot.
+  int start = S->eta_start[S->neta];
+  if (start + S->m > S->eta_cap) {
+    int    new_cap = 2 * (start + S->m);
+    int   *new_idx = scratch_alloc(S->ctx, (size_t)new_cap * sizeof(int));
+    float *new_val = scratch_alloc(S->ctx, (size_t)new_cap * sizeof(float));
+    memcpy(new_idx, S->eta_idx, start * sizeof(int));
+    memcpy(new_val, S->eta_val, start * sizeof(float));
+    scratch_free(S->ctx, S->eta_idx);
+    scratch_free(S->ctx, S->eta_val);
+    S->eta_cap = new_cap;
+    S->eta_idx = new_idx;
+    S->eta_val = new_val;
+  }
+  int t = start;
+  for (int p = 0; p < S->m; ++p) {
+    if (p == r || alpha[p] == 0) continue;
+    S->eta_idx[t] = p;
+    S->eta_val[t] = alpha[p];
+    t++;
+  }
+  S->eta_pos[S->neta]   = r;
+  S->eta_piv[S->neta]   = alpha[r];
+  S->eta_start[++S->neta] = t;
+
+  int leaving = S->head[r];
+  S->pos[leaving] = -1;
+  S->head[r] = q;
+  S->pos[q]  = r;
+  S->step_pivots++;
+
+  int ok = (S->neta >= S->refactor_freq ? simplex_refactor(S) : true);
+  stats_pivot(S->opts, S->phase, q, leaving, fabsf(step) <= tol,
+              S->opts->on_pivot ? simplex_objective(S) : 0);
+  return ok;
+}
+
+// Each nonbasic variable starts at its lower bound, or its upper bound if it
+// has no lower one, or zero if it is free.
+static float start_value(float lo, float hi) {
+  return (lo > -INFINITY ? lo : hi < INFINITY ? hi : 0);
+}
+
+// Exactly one of A or sp is expected to be non-NULL. With a context, lu and
+// the eta file start out at their largest possible sizes, so that they never
+// grow.
+static void simplex_init(alg__Context ctx, Simplex *S, alg__Mat A, alg__SpMat sp,
+                         alg__Mat b, Bounds *bounds, alg__LPOptions *opts) {
+  int m = (A ? num_rows(A) : sp->nrows);
+  int n = (A ? num_cols(A) : sp->ncols);
+  int refactor_freq = opts->refactor_freq;
+  if (refactor_freq <= 0) refactor_freq = default_refactor_freq;
+  int uses_weights  = (opts->pricing == alg__pricing_devex ||
+                       opts->pricing == alg__pricing_steepest);
+  int lu_cap  = (ctx ? m * m : 0);
+  int eta_cap = (ctx ? refactor_freq * m : 4 * m);
+  *S = (Simplex) {
+         .ctx = ctx, .m = m, .n = n, .A = A, .sp = sp,
+         .b       = scratch_alloc(ctx, m * sizeof(float)),
+         .sign    = scratch_alloc(ctx, m * sizeof(float)),
+         .cost    = scratch_alloc(ctx, (n + m) * sizeof(float)),
+         .head    = scratch_alloc(ctx, m * sizeof(int)),
+         .pos     = scratch_alloc(ctx, (n + m) * sizeof(int)),
+         .xB      = scratch_alloc(ctx, m * sizeof(float)),
+         .lo      = scratch_alloc(ctx, n * sizeof(float)),
+         .hi      = scratch_alloc(ctx, n * sizeof(float)),
+         .xN      = scratch_alloc(ctx, n * sizeof(float)),
+         .abs_cost = (bounds && bounds->abs_cost),
+         .kvar    = scratch_alloc(ctx, m * sizeof(int)),
+         .kpos    = scratch_alloc(ctx, m * sizeof(int)),
+         .krow    = scratch_alloc(ctx, m * sizeof(int)),
+         .cover   = scratch_alloc(ctx, m * sizeof(int)),
+         .lu      = (lu_cap ? scratch_alloc(ctx, lu_cap * sizeof(float)) : NULL),
+         .lu_cap  = lu_cap,
+         .perm    = scratch_alloc(ctx, m * sizeof(int)),
+         .eta_cap = eta_cap,
+         .eta_pos   = scratch_alloc(ctx, refactor_freq * sizeof(int)),
+         .eta_start = scratch_alloc(ctx, (refactor_freq + 1) * sizeof(int)),
+         .eta_idx   = scratch_alloc(ctx, eta_cap * sizeof(int)),
+         .eta_piv   = scratch_alloc(ctx, refactor_freq * sizeof(float)),
+         .eta_val   = scratch_alloc(ctx, eta_cap * sizeof(float)),
+         .refactor_freq = refactor_freq,
+         .y       = scratch_alloc(ctx, m * sizeof(float)),
+         .rho     = (uses_weights ? scratch_alloc(ctx, m * sizeof(float)) : NULL),
+         .tau     = (uses_weights ? scratch_alloc(ctx, m * sizeof(float)) : NULL),
+         .prow    = (uses_weights ? scratch_alloc(ctx, n * sizeof(float)) : NULL),
+         .work    = scratch_alloc(ctx, m * sizeof(float)),
+         .work2   = scratch_alloc(ctx, m * sizeof(float)),
+         .work3   = scratch_alloc(ctx, m * sizeof(float)),
+         .opts    = opts,
+         .phase   = phase1,
+         .stage   = stage_phase1,
+         .deadline = INFINITY };
+  S->eta_start[0] = 0;
+
+  for (int j = 0; j < n; ++j) {
+    alg__Mat lo = (bounds ? bounds->lo : NULL), hi = (bounds ? bounds->hi : NULL);
+    S->lo[j] = (S->abs_cost ? -INFINITY : lo ? col_elt(lo, j) : 0);
+    S->hi[j] = (S->abs_cost ?  INFINITY : hi ? col_elt(hi, j) : INFINITY);
+    S->xN[j] = start_value(S->lo[j], S->hi[j]);
+  }
+
+  // Start from the all-artificial basis, negating rows of b - A xN that are
+  // negative so that every artificial variable starts out nonnegative.
+  for (int i = 0; i < m; ++i) S->work[i] = S->b[i] = col_elt(b, i);
+  for (int j = 0; j < n; ++j) {
+    if (S->xN[j] != 0) col_axpy(S, j, -S->xN[j], S->work);
+  }
+  // As in phase1_tol, the feasibility tolerance scales with the starting
+  // phase 1 objective, which is ||b - A xN||_1.
+  S->feas_tol = 1;
+  for (int i = 0; i < m; ++i) {
+    S->sign[i] = (S->work[i] < 0 ? -1 : 1);
+    S->head[i] = n + i;
+    S->feas_tol += fabsf(S->work[i]);
+  }
+  S->feas_tol *= tol;
+  for (int j = 0; j < n + m; ++j) S->pos[j] = (j < n ? -1 : j - n);
+
+  // With B = diag(sign), the steepest edge weights 1 + ||B^-1 A[j]||^2 start
+  // out as 1 + ||A[j]||^2.
+  pricer_init(ctx, &S->pricer, opts, n);
+  if (opts->pricing == alg__pricing_steepest) {
+    for (int j = 0; j < n; ++j) {
+      load_col(S, j, S->work);
+      S->pricer.weights[j] = 1;
+      for (int i = 0; i < m; ++i) S->pricer.weights[j] += S->work[i] * S->work[i];
+    }
+  }
+}
+
+// Returns to the all-artificial basis that simplex_init sets up.
+static void simplex_reset_basis(Simplex *S) {
+  int m = S->m, n = S->n;
+  for (int i = 0; i < m; ++i) S->head[i] = n + i;
+  for (int j = 0; j < n + m; ++j) S->pos[j] = (j < n ? -1 : j - n);
+  for (int j = 0; j < n; ++j) S->xN[j] = start_value(S->lo[j], S->hi[j]);
+}
+
+// Moves to the given basis if it fits and is nonsingular, with its nonbasic
+// variables at the stored bounds. Otherwise this returns false and leaves
+// the all-artificial basis in place.
+static int simplex_load_basis(Simplex *S, alg__Basis basis) {
+  int m = S->m, n = S->n;
+  if (!basis_fits(S->ctx, basis, m, n)) return false;
+  for (int j = 0; j < n + m; ++j) S->pos[j] = -1;
+  for (int p = 0; p < m; ++p) {
+    S->head[p] = basis->head[p];
+    S->pos[S->head[p]] = p;
+  }
+  for (int j = 0; j < n; ++j) {
+    if (basis->at_hi[j] && S->hi[j] < INFINITY) S->xN[j] = S->hi[j];
+  }
+  if (simplex_refactor(S)) {
+    // The devex and steepest edge weights restart from this basis.
+    for (int j = 0; j < n; ++j) S->pricer.weights[j] = 1;
+    return true;
+  }
+  simplex_reset_basis(S);
+  return false;
+}
+
+// Returns true if every basic variable is within its bounds, up to roundoff,
+// in which case they are moved to within their bounds exactly.
+static int simplex_is_feasible(Simplex *S, float feas_tol) {
+  for (int p = 0; p < S->m; ++p) {
+    int   j   = S->head[p];
+    float x_p = S->xB[p];
+    if (is_artif(S, j) ? fabsf(x_p) > feas_tol :
+                         x_p < S->lo[j] - tol || x_p > S->hi[j] + tol) return false;
+  }
+  for (int p = 0; p < S->m; ++p) {
+    int j = S->head[p];
+    S->xB[p] = (is_artif(S, j) ? 0 : fminf(fmaxf(S->xB[p], S->lo[j]), S->hi[j]));
+  }
+  return true;
+}
+
+static void simplex_free(Simplex *S) {
+  void *ptrs[] = { S->b, S->sign, S->cost, S->head, S->pos, S->xB,
+                   S->lo, S->hi, S->xN, S->kvar, S->kpos, S->krow, S->cover, S->lu, S->perm,
+                   S->eta_pos, S->eta_start, S->eta_idx, S->eta_piv,
+                   S->eta_val, S->y, S->rho, S->tau, S->prow,
+                   S->work, S->work2, S->work3 };
+  for (int i = 0; i < (int)(sizeof(ptrs) / sizeof(ptrs[0])); ++i) scratch_free(S->ctx, ptrs[i]);
+  pricer_free(S->ctx, &S->pricer);
+}
+
+// The scratch bytes used by run_lp_revised with a context.
+static size_t run_lp_revised_bytes(int m, int n, alg__LPOptions *opts) {
+  int refactor_freq = (opts->refactor_freq > 0 ? opts->refactor_freq : default_refactor_freq);
+  int uses_weights  = (opts->pricing == alg__pricing_devex ||
+                       opts->pricing == alg__pricing_steepest);
+  size_t m_floats = scratch_bytes(m * sizeof(float));  // The same for ints.
+  size_t bytes = (13 + 2 * uses_weights) * m_floats +
+                 2 * scratch_bytes((n + m) * sizeof(float)) +
+                 scratch_bytes((size_t)m * m * sizeof(float)) +
+                 2 * scratch_bytes(refactor_freq * sizeof(int)) +
+                 scratch_bytes((refactor_freq + 1) * sizeof(int)) +
+                 2 * scratch_bytes((size_t)refactor_freq * m * sizeof(float)) +
+                 (4 + uses_weights) * scratch_bytes(n * sizeof(float));
+  if (opts->basis) bytes += scratch_bytes(n + m);
+  if (opts->refine) bytes += refine_lp_bytes(m, n);
+  return bytes;
+}
+
+// Updates the devex or steepest edge weights for a pivot that brings
+// variable q into the basis at position r, where alpha = B^-1 A[q].
+static void simplex_update_weights(Simplex *S, int q, int r, float *alpha) {
+  Pricer *P = &S->pricer;
+  if (P->rule != alg__pricing_devex && P->rule != alg__pricing_steepest) return;
+
+  // Find the pivot row of B^-1 A as rho^T A, where rho^T = e_r^T B^-1.
+  memset(S->work, 0, S->m * sizeof(float));
+  S->work[r] = 1;
+  simplex_btran(S, S->work, S->rho);
+  for (int j = 0; j < S->n; ++j) {
+    S->prow[j] = (S->pos[j] == -1 ? col_dot(S, j, S->rho) : 0);
+  }
+  S->prow[q] = alpha[r];
+  int leave  = (is_artif(S, S->head[r]) ? -1 : S->head[r]);
+
+  if (P->rule == alg__pricing_devex) {
+    pricer_update_devex(P, 0, S->n, q, leave, S->prow, 1);
+    return;
+  }
+
+  // This is the Goldfarb-Reid update of the exact weights
+  // gamma_j = 1 + ||B^-1 A[j]||^2, using tau = B^-T alpha.
+  float gamma_q = 1;
+  for (int p = 0; p < S->m; ++p) gamma_q += alpha[p] * alpha[p];
+  memcpy(S->work, alpha, S->m * sizeof(float));
+  simplex_btran(S, S->work, S->tau);
+  for (int j = 0; j < S->n; ++j) {
+    if (j == q || S->prow[j] == 0) continue;
+    float ratio = S->prow[j] / alpha[r];
+    float gamma = P->weights[j] - 2 * ratio * col_dot(S, j, S->tau) + ratio * ratio * gamma_q;
+    P->weights[j] = fmaxf(gamma, 1 + ratio * ratio);
+  }
+  if (leave >= 0) P->weights[leave] = fmaxf(gamma_q / (alpha[r] * alpha[r]), 1);
+}
+
+// Returns the rate at which the objective falls as the nonbasic variable j
+// moves away from xN[j] in its better direction, which goes in *dir.
+static float simplex_rate(Simplex *S, int j, int *dir) {
+  float ya = col_dot(S, j, S->y);
+  if (S->abs_cost) {
+    // Moving up costs cost[j] per unit, and so does moving down.
+    *dir = (ya > 0 ? 1 : -1);
+    return fabsf(ya) - S->cost[j];
+  }
+  float rate = ya - S->cost[j];  // The rate for moving up.
+  *dir = (rate > 0 ? 1 : -1);
+  if (rate > 0 ? S->xN[j] >= S->hi[j] : S->xN[j] <= S->lo[j]) return 0;
+  return fabsf(rate);
+}
+
+static float simplex_score(void *data, int j) {
+  Simplex *S = data;
+  if (S->pos[j] != -1) return 0;
+  int dir;
+  return simplex_rate(S, j, &dir);
+}
+
+// Pivots until the current costs are minimized, or returns
+// alg__status_in_progress when the step budget runs out. Artificial
+// variables never enter the basis; once one leaves, it is effectively
+// dropped. With hold_sign set, a variable with an absolute value cost is
+// held to the side of zero it enters on.
+static alg__Status simplex_run(Simplex *S, int hold_sign) {
+  float *alpha = S->work2;
+  while (true) {
+    if (!simplex_can_pivot(S)) return alg__status_in_progress;
+    // Find y with B^T y = c_B; a column with reduced cost c_j - y^T A[j] < 0
+    // can enter the basis moving up, and one with a positive reduced cost can
+    // enter moving down.
+    for (int p = 0; p < S->m; ++p) S->work[p] = basic_cost(S, S->head[p]);
+    simplex_btran(S, S->work, S->y);
+    int use_bland = pricer_uses_bland(&S->pricer);
+    int q = pricer_choose(&S->pricer, 0, S->n, simplex_score, S);
+    if (q == -1) return alg__status_ok;
+    int dir;
+    simplex_rate(S, q, &dir);
+    if (S->abs_cost && hold_sign) {
+      S->lo[q] = (dir > 0 ? 0 : -INFINITY);
+      S->hi[q] = (dir > 0 ? INFINITY : 0);
+    }
+
+    load_col(S, q, S->work);
+    simplex_ftran(S, S->work, alpha);
+
+    // As x_q moves by dir * theta, each xB[p] moves by -dir * theta * alpha[p]
+    // until it reaches a bound. Ties in the ratio test go to the smallest
+    // basic variable under Bland's rule, and otherwise to the largest pivot
+    // entry.
+    int   r = -1;
+    float best_ratio = S->hi[q] - S->lo[q];  // Where x_q reaches its other bound.
+    for (int p = 0; p < S->m; ++p) {
+      int   j    = S->head[p];
+      float rate = dir * alpha[p], ratio;
+      if (rate >= tol && var_lo(S, j) > -INFINITY) {
+        ratio = fmaxf(S->xB[p] - var_lo(S, j), 0) / rate;
+      } else if (rate <= -tol && var_hi(S, j) < INFINITY) {
+        ratio = fmaxf(var_hi(S, j) - S->xB[p], 0) / -rate;
+      } else {
+        continue;
+      }
+      int is_better = (ratio < best_ratio);
+      if (!is_better && r != -1 && ratio == best_ratio) {
+        is_better = (use_bland ? S->head[p] < S->head[r] : fabsf(alpha[p]) > fabsf(alpha[r]));
+      }
+      if (is_better) {
+        r          = p;
+        best_ratio = ratio;
+      }
+    }
+    if (best_ratio == INFINITY) {
+      alg__err_str = unbdd_soln_str;
+      return alg__status_unbdd_soln;
+    }
+    float step = dir * best_ratio;
+
+    if (r == -1) {
+      // x_q moves to its other bound, and the basis stays the same.
+      dbg_printf("revised bound flip: variable=%d\n", q);
+      for (int p = 0; p < S->m; ++p) S->xB[p] -= step * alpha[p];
+      S->xN[q] = (dir > 0 ? S->hi[q] : S->lo[q]);
+      pricer_note_pivot(&S->pricer, false);
+      if (S->opts->stats) S->opts->stats->bound_flips++;
+      continue;
+    }
+
+    int   leave     = S->head[r];
+    float leave_val = (dir * alpha[r] > 0 ? var_lo(S, leave) : var_hi(S, leave));
+    dbg_printf("revised pivot: entering=%d, leaving=%d\n", q, leave);
+    simplex_update_weights(S, q, r, alpha);
+    pricer_note_pivot(&S->pricer, best_ratio <= tol);
+    // This is set first since simplex_pivot may refactor, which uses xN.
+    if (!is_artif(S, leave)) {
+      S->xN[leave] = leave_val;
+      if (S->abs_cost) S->lo[leave] = -INFINITY, S->hi[leave] = INFINITY;
+    }
+    if (!simplex_pivot(S, q, r, alpha, step)) {
+      alg__err_str = "The basis became numerically singular.";
+      return alg__status_input_error;
+    }
+  }
+}
+
+// Holds each basic variable with an absolute value cost to the side of zero
+// it is on, as simplex_run does for those that enter the basis.
+static void simplex_hold_signs(Simplex *S) {
+  if (!S->abs_cost) return;
+  for (int p = 0; p < S->m; ++p) {
+    int j = S->head[p];
+    if (is_artif(S, j)) continue;
+    S->lo[j] = (S->xB[p] >= 0 ? 0 : -INFINITY);
+    S->hi[j] = (S->xB[p] >= 0 ? INFINITY : 0);
+  }
+}
+
+// After phase 1, pivots out artificial variables still in the basis at a
+// zero level. Any that can't be pivoted out belong to redundant rows.
+static int simplex_drive_out_artifs(Simplex *S) {
+  float *rho = S->work2, *alpha = S->work2;
+  for (int p = 0; p < S->m; ++p) {
+    if (!is_artif(S, S->head[p])) continue;
+
+    // rho^T = e_p^T B^-1, so rho^T A[j] is row p of B^-1 A.
+    memset(S->work, 0, S->m * sizeof(float));
+    S->work[p] = 1;
+    simplex_btran(S, S->work, rho);
+    int   q   = -1;
+    float big = tol;
+    for (int j = 0; j < S->n; ++j) {
+      if (S->pos[j] != -1) continue;
+      float val = fabsf(col_dot(S, j, rho));
+      if (val > big) {
+        q   = j;
+        big = val;
+      }
+    }
+    if (q == -1) continue;
+
+    load_col(S, q, S->work);
+    simplex_ftran(S, S->work, alpha);
+    S->xB[p] = 0;
+    simplex_update_weights(S, q, p, alpha);
+    if (!simplex_pivot(S, q, p, alpha, 0)) return false;
+  }
+  return true;
+}
+
+// Sets the phase 2 costs, which are zero for the artificial variables.
+static void simplex_set_costs(Simplex *S, alg__Mat c) {
+  for (int j = 0; j < S->n + S->m; ++j) S->cost[j] = (is_artif(S, j) ? 0 : col_elt(c, j));
+}
+
+// Returns true if no nonbasic variable can lower the current costs, so that
+// the basis is optimal as soon as it is feasible.
+static int simplex_is_dual_feasible(Simplex *S) {
+  for (int p = 0; p < S->m; ++p) S->work[p] = basic_cost(S, S->head[p]);
+  simplex_btran(S, S->work, S->y);
+  for (int j = 0; j < S->n; ++j) {
+    int dir;
+    if (S->pos[j] == -1 && simplex_rate(S, j, &dir) > tol) return false;
+  }
+  return true;
+}
+
+// Pivots a dual feasible basis to a feasible one, which is then optimal.
+// This is the dual simplex method: each pivot takes the basic variable
+// furthest outside its bounds out of the basis at the bound it crossed, and
+// brings in the nonbasic variable that keeps every reduced cost on its
+// optimal side. Basic artificial variables are held to zero. Like
+// simplex_run, this stops early when the step budget runs out.
+static alg__Status simplex_dual_run(Simplex *S, float feas_tol) {
+  float *rho = S->work2, *alpha = S->work2;
+  while (true) {
+    if (!simplex_can_pivot(S)) return alg__status_in_progress;
+    int   r      = -1;
+    float worst  = 0;
+    float target = 0;  // The bound at which xB[r] leaves.
+    for (int p = 0; p < S->m; ++p) {
+      int   j   = S->head[p];
+      float lo  = var_lo(S, j);
+      float hi  = (is_artif(S, j) ? 0 : S->hi[j]);
+      float lim = (is_artif(S, j) ? feas_tol : tol);
+      if (lo - S->xB[p] > fmaxf(lim, worst)) r = p, worst = lo - S->xB[p], target = lo;
+      if (S->xB[p] - hi > fmaxf(lim, worst)) r = p, worst = S->xB[p] - hi, target = hi;
+    }
+    if (r == -1) {
+      simplex_is_feasible(S, feas_tol);
+      return alg__status_ok;
+    }
+
+    // Find y with B^T y = c_B, and rho^T = e_r^T B^-1, so that rho^T A[j] is
+    // row r of B^-1 A.
+    for (int p = 0; p < S->m; ++p) S->work[p] = basic_cost(S, S->head[p]);
+    simplex_btran(S, S->work, S->y);
+    memset(S->work, 0, S->m * sizeof(float));
+    S->work[r] = 1;
+    simplex_btran(S, S->work, rho);
+
+    // As x_j moves by t, xB[r] moves by -t * rho^T A[j], so x_j moves by
+    // delta / rho^T A[j] to bring xB[r] to its bound. Of the variables that
+    // can move that way, the one with the least |d_j / rho^T A[j]|, where
+    // d_j = c_j - y^T A[j], leaves the other d_j on their optimal sides.
+    float delta = S->xB[r] - target;
+    int   q     = -1;
+    float best_ratio = INFINITY, best_a = 0;
+    for (int j = 0; j < S->n; ++j) {
+      if (S->pos[j] != -1 || S->lo[j] == S->hi[j]) continue;
+      float a = col_dot(S, j, rho);
+      if (fabsf(a) < tol) continue;
+      if (delta / a > 0 ? S->xN[j] >= S->hi[j] : S->xN[j] <= S->lo[j]) continue;
+      float ratio = fabsf((S->cost[j] - col_dot(S, j, S->y)) / a);
+      if (ratio < best_ratio || (ratio == best_ratio && fabsf(a) > fabsf(best_a))) {
+        q          = j;
+        best_ratio = ratio;
+        best_a     = a;
+      }
+    }
+    if (q == -1) {
+      alg__err_str = "There are no solutions x with Ax=b and x>=0.";
+      return alg__status_no_soln;
+    }
+
+    load_col(S, q, S->work);
+    simplex_ftran(S, S->work, alpha);
+    int leave = S->head[r];
+    dbg_printf("dual pivot: entering=%d, leaving=%d\n", q, leave);
+    simplex_update_weights(S, q, r, alpha);
+    if (!is_artif(S, leave)) S->xN[leave] = target;
+    if (!simplex_pivot(S, q, r, alpha, delta / alpha[r])) {
+      alg__err_str = "The basis became numerically singular.";
+      return alg__status_input_error;
+    }
+  }
+}
+
+static void simplex_start_phase2(Simplex *S, alg__Mat c) {
+  simplex_set_costs(S, c);
+  simplex_hold_signs(S);
+  S->stage = stage_phase2;
+  S->phase = phase2;
+}
+
+// Sets up the first stage of a solve: phase 2 from a stored basis that is
+// feasible, the dual simplex method from one that is still optimal for c,
+// as after a change to b or after rows were added with alg__extend_basis,
+// and phase 1 from the all-artificial basis otherwise. Returns
+// alg__status_in_progress unless the bounds are bad or the basis can't be
+// factored.
+static alg__Status simplex_start(Simplex *S, alg__Mat c, alg__Basis basis) {
+  for (int j = 0; j < S->n; ++j) {
+    if (S->lo[j] <= S->hi[j] && S->lo[j] < INFINITY && S->hi[j] > -INFINITY) continue;
+    alg__err_str = "Each variable is expected to have lo <= hi, with lo < inf and hi > -inf.";
+    return alg__status_input_error;
+  }
+  if (simplex_load_basis(S, basis)) {
+    if (simplex_is_feasible(S, S->feas_tol)) {
+      simplex_start_phase2(S, c);
+      return alg__status_in_progress;
+    }
+    simplex_set_costs(S, c);
+    if (!S->abs_cost && simplex_is_dual_feasible(S)) {
+      S->stage = stage_dual;
+      return alg__status_in_progress;
+    }
+    simplex_reset_basis(S);
+  }
+
+  // Phase 1 minimizes the sum of the artificial variables.
+  for (int j = 0; j < S->n + S->m; ++j) S->cost[j] = (is_artif(S, j) ? 1 : 0);
+  if (!simplex_refactor(S)) {
+    alg__err_str = "The basis became numerically singular.";
+    return alg__status_input_error;
+  }
+  S->stage = stage_phase1;
+  return alg__status_in_progress;
+}
+
+// Checks that phase 1 found a feasible x, and pivots any artificial
+// variables left in the basis out of it.
+static alg__Status simplex_end_phase1(Simplex *S) {
+  float artif_sum = 0;
+  for (int p = 0; p < S->m; ++p) {
+    if (is_artif(S, S->head[p])) artif_sum += S->xB[p];
+  }
+  if (fabs(artif_sum) > S->feas_tol) {
+    alg__err_str = "There are no solutions x with Ax=b and x>=0.";
+    return alg__status_no_soln;
+  }
+  if (!simplex_drive_out_artifs(S)) {
+    alg__err_str = "The basis became numerically singular.";
+    return alg__status_input_error;
+  }
+  return alg__status_ok;
+}
+
+// Runs the stages of a solve from the current one until phase 2 ends, or
+// until the step budget runs out, which returns alg__status_in_progress.
+static alg__Status simplex_continue(Simplex *S, alg__Mat c) {
+  double t = now_seconds();
+  alg__Status status = alg__status_ok;
+  while (S->stage != stage_done) {
+    if (S->stage == stage_dual) {
+      status = simplex_dual_run(S, S->feas_tol);
+    } else {
+      status = simplex_run(S, S->stage == stage_phase2);
+    }
+    if (status == alg__status_ok && S->stage == stage_phase1) status = simplex_end_phase1(S);
+    stats_add_time(S->opts, S->phase, &t);
+    if (status != alg__status_ok) return status;
+    if (S->stage == stage_phase2) {
+      S->stage = stage_done;
+    } else {
+      simplex_start_phase2(S, c);
+    }
+  }
+  return status;
+}
+
+// Copies the solution to x, and stores the final basis.
+static void simplex_finish(Simplex *S, alg__Mat b, alg__Mat x, alg__LPOptions *opts) {
+  for (int j = 0; j < S->n; ++j) col_elt(x, j) = S->xN[j];
+  for (int p = 0; p < S->m; ++p) {
+    if (!is_artif(S, S->head[p])) col_elt(x, S->head[p]) = S->xB[p];
+  }
+  if (opts->refine && S->A) refine_lp_solution(S->ctx, S->A, b, x, S->head);
+  basis_store(opts->basis, S->m, S->n, S->head);
+  for (int j = 0; j < S->n && opts->basis; ++j) {
+    opts->basis->at_hi[j] = (S->pos[j] == -1 && S->xN[j] == S->hi[j]);
+  }
+
+  dbg_printf("x:\n");
+  dbg_print_matrix(x);
+}
+
+// Exactly one of A or sp is expected to be non-NULL. The bounds may be NULL
+// for x >= 0.
+static alg__Status run_lp_revised(alg__Context ctx, alg__Mat A, alg__SpMat sp, alg__Mat b,
+                                  alg__Mat x, alg__Mat c, Bounds *bounds,
+                                  alg__LPOptions *opts) {
+  Simplex S;
+  simplex_init(ctx, &S, A, sp, b, bounds, opts);
+  alg__Status status = simplex_start(&S, c, opts->basis);
+  if (status == alg__status_in_progress) status = simplex_continue(&S, c);
+  if (status == alg__status_ok) simplex_finish(&S, b, x, opts);
+  simplex_free(&S);
+  return status;
+}
+
+
+// The interior point method.
+//
+// This solves min c^T x with Ax = b and x >= 0 together with its dual,
+// max b^T y with A^T y + z = c and z >= 0, by following the central path
+// x_j z_j = mu down to mu = 0. Each iteration takes a Newton step for the
+// optimality conditions, with Mehrotra's predictor-corrector choice of mu.
+// The steps come from the normal equations (A D A^T) dy = r, where
+// D = diag(x / z), which are solved by a Cholesky factorization in double.
+// The number of iterations grows only slowly with the size of A, unlike the
+// number of simplex pivots on large degenerate problems.
+
+#define ipm_max_iters 100
+#define ipm_eps       1e-8   // The relative accuracy at which we stop.
+#define ipm_big       1e12   // Iterates this large mean no optimum.
+#define ipm_step_frac 0.99   // The fraction of the way to the boundary we step.
+
+typedef struct {
+  alg__Context ctx;      // Every array below comes from its scratch memory.
+  int     m, n;
+  alg__Mat A;
+  alg__SpMat sp;         // If not NULL, this is used in place of A; it's in CSC form.
+  double *x, *y, *z;     // The primal and dual iterates.
+  double *dx, *dy, *dz;  // The current step.
+  double *dx_aff, *dz_aff;  // The predictor step.
+  double *d;             // The diagonal of D = x / z.
+  double *rb, *rc;       // The residuals b - A x and c - A^T y - z.
+  double *rhs;           // The right-hand side of the normal equations.
+  double *M;             // A D A^T and then its Cholesky factor, m x m.
+  double  a_max;         // The largest |A_ij|.
+  int     iters;         // The number of iterations taken so far.
+} Interior;
+
+// Sets v = A[j] as a dense vector in double.
+static void interior_load_col(Interior *I, int j, double *v) {
+  if (I->sp) {
+    memset(v, 0, I->m * sizeof(double));
+    for (int t = I->sp->start[j]; t < I->sp->start[j + 1]; ++t) v[I->sp->idx[t]] = I->sp->vals[t];
+  } else {
+    for (int i = 0; i < I->m; ++i) v[i] = elt(I->A, i, j);
+  }
+}
+
+// Sets out = A v, or out = A^T v if transpose is true.
+static void interior_matvec(Interior *I, double *v, double *out, int transpose) {
+  if (I->sp) {
+    sp_matvec(I->sp, v, out, transpose);
+    return;
+  }
+  int nout = (transpose ? I->n : I->m), nin = (transpose ? I->m : I->n);
+  for (int i = 0; i < nout; ++i) {
+    double sum = 0;
+    for (int j = 0; j < nin; ++j) sum += (transpose ? elt(I->A, j, i) : elt(I->A, i, j)) * v[j];
+    out[i] = sum;
+  }
+}
+
+// Factors M = A D A^T = L L^T, leaving L in the lower triangle of M. A pivot
+// that is tiny next to its diagonal entry of M comes from a dependent row of
+// A; it's replaced by a huge value, and the rest of its column of L by zeros,
+// so that the solve leaves that row's part of the solution at zero.
+static void interior_factor(Interior *I) {
+  int     m = I->m;
+  double *M = I->M;
+  memset(M, 0, (size_t)m * m * sizeof(double));
+  double *col = I->dy;
+  for (int j = 0; j < I->n; ++j) {
+    if (I->sp) {
+      for (int t = I->sp->start[j]; t < I->sp->start[j + 1]; ++t) {
+        for (int u = I->sp->start[j]; u <= t; ++u) {
+          int r = I->sp->idx[t], k = I->sp->idx[u];
+          double val = I->d[j] * I->sp->vals[t] * I->sp->vals[u];
+          if (r >= k) M[(size_t)r * m + k] += val;
+          else        M[(size_t)k * m + r] += val;
+        }
+      }
+      continue;
+    }
+    interior_load_col(I, j, col);
+    for (int r = 0; r < m; ++r) {
+      if (col[r] == 0) continue;
+      double dr = I->d[j] * col[r];
+      double *row = M + (size_t)r * m;
+      for (int k = 0; k <= r; ++k) row[k] += dr * col[k];
+    }
+  }
+
+  for (int k = 0; k < m; ++k) {
+    double *row_k = M + (size_t)k * m;
+    double  piv   = row_k[k] - vec_dot_d(row_k, row_k, k);
+    if (piv <= 1e-14 * row_k[k] || piv <= 0) {
+      memset(row_k, 0, k * sizeof(double));
+      row_k[k] = 1e128;
+      for (int r = k + 1; r < m; ++r) M[(size_t)r * m + k] = 0;
+      continue;
+    }
+    row_k[k] = sqrt(piv);
+    for (int r = k + 1; r < m; ++r) {
+      double *row_r = M + (size_t)r * m;
+      row_r[k] = (row_r[k] - vec_dot_d(row_r, row_k, k)) / row_k[k];
+    }
+  }
+}
+
+// Solves L L^T v = v in place.
+static void interior_chol_solve(Interior *I, double *v) {
+  int     m = I->m;
+  double *M = I->M;
+  for (int i = 0; i < m; ++i) {
+    v[i] = (v[i] - vec_dot_d(M + (size_t)i * m, v, i)) / M[(size_t)i * m + i];
+  }
+  for (int i = m - 1; i >= 0; --i) {
+    v[i] /= M[(size_t)i * m + i];
+    for (int k = 0; k < i; ++k) v[k] -= M[(size_t)i * m + k] * v[i];
+  }
+}
+
+// Finds the Newton step for the residuals rb and rc and the complementarity
+// target x_j z_j + dx_j z_j + x_j dz_j = x_j z_j + r_j, where r comes in dx:
+//   dy = (A D A^T)^-1 (rb + A (D rc - r / z)),
+//   dz = rc - A^T dy, and
+//   dx = (r - x dz) / z.
+static void interior_step(Interior *I) {
+  for (int j = 0; j < I->n; ++j) I->dz[j] = I->d[j] * I->rc[j] - I->dx[j] / I->z[j];
+  interior_matvec(I, I->dz, I->dy, false);
+  for (int i = 0; i < I->m; ++i) I->dy[i] += I->rb[i];
+  interior_chol_solve(I, I->dy);
+  interior_matvec(I, I->dy, I->dz, true);
+  for (int j = 0; j < I->n; ++j) {
+    I->dz[j] = I->rc[j] - I->dz[j];
+    I->dx[j] = (I->dx[j] - I->x[j] * I->dz[j]) / I->z[j];
+  }
+}
+
+// Returns the largest t <= 1 with v + t dv >= 0.
+static double interior_max_step(double *v, double *dv, int n) {
+  double t = 1;
+  for (int j = 0; j < n; ++j) {
+    if (dv[j] < 0) t = fmin(t, -v[j] / dv[j]);
+  }
+  return t;
+}
+
+static double vec_max_abs_d(double *v, int n) {
+  double val = 0;
+  for (int i = 0; i < n; ++i) val = fmax(val, fabs(v[i]));
+  return val;
+}
+
+// Returns true if the step dx is a ray along which c^T x falls without
+// bound: dx >= 0, A dx = 0 up to roundoff, and c^T dx < 0. A ray only means
+// the LP is unbounded once x is feasible, so this is false until rb_rel, the
+// relative primal residual, is small; until then, the LP may have no
+// solutions at all.
+static int interior_is_ray(Interior *I, alg__Mat c, double rb_rel) {
+  double dx_max = vec_max_abs_d(I->dx, I->n), c_dx = 0;
+  if (dx_max == 0 || rb_rel > sqrt(ipm_eps)) return false;
+  for (int j = 0; j < I->n; ++j) {
+    if (I->dx[j] < 0) return false;
+    c_dx += col_elt(c, j) * I->dx[j];
+  }
+  if (c_dx >= 0) return false;
+  interior_matvec(I, I->dx, I->rhs, false);
+  return vec_max_abs_d(I->rhs, I->m) <= sqrt(ipm_eps) * I->a_max * dx_max;
+}
+
+// Mehrotra's starting point: the least-norm x with Ax = b and the least
+// squares y for A^T y = c, shifted to be positive and then balanced so that
+// no x_j z_j is far smaller than the others.
+static void interior_start(Interior *I, alg__Mat b, alg__Mat c) {
+  int m = I->m, n = I->n;
+  for (int j = 0; j < n; ++j) I->d[j] = 1;
+  interior_factor(I);
+  I->a_max = 0;
+  for (int j = 0; j < n; ++j) {
+    interior_load_col(I, j, I->dy);
+    I->a_max = fmax(I->a_max, vec_max_abs_d(I->dy, m));
+  }
+  for (int i = 0; i < m; ++i) I->rhs[i] = col_elt(b, i);
+  interior_chol_solve(I, I->rhs);
+  interior_matvec(I, I->rhs, I->x, true);
+  for (int j = 0; j < n; ++j) I->z[j] = col_elt(c, j);
+  interior_matvec(I, I->z, I->y, false);
+  interior_chol_solve(I, I->y);
+  interior_matvec(I, I->y, I->z, true);
+  for (int j = 0; j < n; ++j) I->z[j] = col_elt(c, j) - I->z[j];
+
+  double x_min = INFINITY, z_min = INFINITY;
+  for (int j = 0; j < n; ++j) x_min = fmin(x_min, I->x[j]), z_min = fmin(z_min, I->z[j]);
+  double x_shift = fmax(-1.5 * x_min, 0) + 1e-2, z_shift = fmax(-1.5 * z_min, 0) + 1e-2;
+  double xz = 0, x_sum = 0, z_sum = 0;
+  for (int j = 0; j < n; ++j) {
+    I->x[j] += x_shift;
+    I->z[j] += z_shift;
+    xz    += I->x[j] * I->z[j];
+    x_sum += I->x[j];
+    z_sum += I->z[j];
+  }
+  for (int j = 0; j < n; ++j) {
+    I->x[j] += 0.5 * xz / z_sum;
+    I->z[j] += 0.5 * xz / x_sum;
+  }
+}
+
+// Runs the interior point iterations; on success, I->x, I->y, and I->z are
+// optimal to within ipm_eps. This returns alg__status_in_progress when the
+// iterations stop without telling an infeasible LP from an unbounded one,
+// or without converging.
+static alg__Status interior_run(Interior *I, alg__Mat b, alg__Mat c) {
+  int m = I->m, n = I->n;
+  double b_norm = 0, c_norm = 0;
+  for (int i = 0; i < m; ++i) b_norm = fmax(b_norm, fabsf(col_elt(b, i)));
+  for (int j = 0; j < n; ++j) c_norm = fmax(c_norm, fabsf(col_elt(c, j)));
+
+  interior_start(I, b, c);
+  for (int iter = 0; iter < ipm_max_iters; ++iter) {
+    I->iters = iter + 1;
+    interior_matvec(I, I->x, I->rb, false);
+    for (int i = 0; i < m; ++i) I->rb[i] = col_elt(b, i) - I->rb[i];
+    interior_matvec(I, I->y, I->rc, true);
+    double mu = 0, p_obj = 0, d_obj = 0;
+    for (int j = 0; j < n; ++j) {
+      I->rc[j] = col_elt(c, j) - I->rc[j] - I->z[j];
+      mu    += I->x[j] * I->z[j];
+      p_obj += col_elt(c, j) * I->x[j];
+    }
+    for (int i = 0; i < m; ++i) d_obj += col_elt(b, i) * I->y[i];
+    mu /= (n > 0 ? n : 1);
+
+    double rb_rel = vec_max_abs_d(I->rb, m) / (1 + b_norm);
+    double rc_rel = vec_max_abs_d(I->rc, n) / (1 + c_norm);
+    dbg_printf("interior iter %d: mu=%g rb=%g rc=%g obj=%g\n", iter, mu, rb_rel, rc_rel, p_obj);
+    if (rb_rel < ipm_eps && rc_rel < ipm_eps && fabs(p_obj - d_obj) < ipm_eps * (1 + fabs(p_obj))) {
+      return alg__status_ok;
+    }
+    // Iterates this large mean there is no optimum. An x that is a ray, or a
+    // dual that blows up once x is feasible, shows the LP is unbounded; any
+    // other blow up may come from either an unbounded or an infeasible LP.
+    if (vec_max_abs_d(I->x, n) > ipm_big) {
+      memcpy(I->dx, I->x, n * sizeof(double));
+      if (!interior_is_ray(I, c, rb_rel)) return alg__status_in_progress;
+      alg__err_str = unbdd_soln_str;
+      return alg__status_unbdd_soln;
+    }
+    if (vec_max_abs_d(I->y, m) > ipm_big || vec_max_abs_d(I->z, n) > ipm_big) {
+      if (rb_rel > sqrt(ipm_eps)) return alg__status_in_progress;
+      alg__err_str = unbdd_soln_str;
+      return alg__status_unbdd_soln;
+    }
+
+    for (int j = 0; j < n; ++j) I->d[j] = I->x[j] / I->z[j];
+    interior_factor(I);
+
+    // The predictor step aims for mu = 0.
+    for (int j = 0; j < n; ++j) I->dx[j] = -I->x[j] * I->z[j];
+    interior_step(I);
+    double t_p = interior_max_step(I->x, I->dx, n);
+    double t_d = interior_max_step(I->z, I->dz, n);
+    double mu_aff = 0;
+    for (int j = 0; j < n; ++j) mu_aff += (I->x[j] + t_p * I->dx[j]) * (I->z[j] + t_d * I->dz[j]);
+    mu_aff /= (n > 0 ? n : 1);
+    double sigma = pow(mu_aff / mu, 3);
+    memcpy(I->dx_aff, I->dx, n * sizeof(double));
+    memcpy(I->dz_aff, I->dz, n * sizeof(double));
+
+    // The corrector step aims for mu = sigma mu, and corrects for the
+    // second order term dx_aff dz_aff left out of the predictor step.
+    for (int j = 0; j < n; ++j) {
+      I->dx[j] = sigma * mu - I->x[j] * I->z[j] - I->dx_aff[j] * I->dz_aff[j];
+    }
+    interior_step(I);
+    if (interior_is_ray(I, c, rb_rel)) {
+      alg__err_str = unbdd_soln_str;
+      return alg__status_unbdd_soln;
+    }
+    t_p = fmin(1, ipm_step_frac * interior_max_step(I->x, I->dx, n));
+    t_d = fmin(1, ipm_step_frac * interior_max_step(I->z, I->dz, n));
+    for (int j = 0; j < n; ++j) {
+      I->x[j] += t_p * I->dx[j];
+      I->z[j] += t_d * I->dz[j];
+    }
+    for (int i = 0; i < m; ++i) I->y[i] += t_d * I->dy[i];
+  }
+  return alg__status_in_progress;
+}
+
+typedef struct {
+  double key;
+  int    j;
+} KeyedIndex;
+
+static int cmp_keys_descending(const void *a, const void *b) {
+  double ka = ((const KeyedIndex *)a)->key, kb = ((const KeyedIndex *)b)->key;
+  return (ka < kb) - (ka > kb);
+}
+
+// Finds a vertex near the interior solution. The columns with the largest
+// x_j / z_j that are independent, filled out with artificial variables, make
+// a starting basis for the revised simplex method. When the interior
+// solution is close to a unique vertex, that basis is already optimal, and
+// otherwise the dual or primal simplex method finishes from it.
+static alg__Status interior_crossover(Interior *I, alg__Mat b, alg__Mat x, alg__Mat c,
+                                      alg__LPOptions *opts) {
+  int m = I->m, n = I->n;
+  KeyedIndex *order = scratch_alloc(I->ctx, max(n, 1) * sizeof(KeyedIndex));
+  for (int j = 0; j < n; ++j) order[j] = (KeyedIndex) { I->x[j] / I->z[j], j };
+  qsort(order, n, sizeof(KeyedIndex), cmp_keys_descending);
+
+  // Rows of M hold an orthonormal basis for the span of the chosen columns.
+  struct alg__BasisStruct basis = {
+    .is_set = true, .m = m, .n = n,
+    .head   = scratch_alloc(I->ctx, max(m, 1) * sizeof(int)),
+    .at_hi  = scratch_alloc(I->ctx, n + 1) };
+  memset(basis.at_hi, 0, n);
+  double *v = I->dy;
+  int     k = 0;
+  for (int t = 0; t < n + m && k < m; ++t) {
+    int j = (t < n ? order[t].j : t);  // Variable n + i is the artificial of row i.
+    if (j < n) {
+      interior_load_col(I, j, v);
+    } else {
+      memset(v, 0, m * sizeof(double));
+      v[j - n] = 1;
+    }
+    double norm0 = sqrt(vec_dot_d(v, v, m));
+    if (norm0 == 0) continue;
+    for (int pass = 0; pass < 2; ++pass) {
+      for (int q = 0; q < k; ++q) {
+        double *row = I->M + (size_t)q * m;
+        double  dot = vec_dot_d(row, v, m);
+        for (int i = 0; i < m; ++i) v[i] -= dot * row[i];
+      }
+    }
+    double norm = sqrt(vec_dot_d(v, v, m));
+    if (norm <= 1e-6 * norm0) continue;
+    for (int i = 0; i < m; ++i) I->M[(size_t)k * m + i] = v[i] / norm;
+    basis.head[k++] = j;
+  }
+  scratch_free(I->ctx, order);
+
+  alg__LPOptions revised_opts = *opts;
+  revised_opts.algorithm = alg__lp_revised;
+  revised_opts.basis     = &basis;
+  alg__Status status = run_lp_revised(I->ctx, I->A, I->sp, b, x, c, NULL, &revised_opts);
+  if (status == alg__status_ok) basis_store(opts->basis, m, n, basis.head);
+
+  scratch_free(I->ctx, basis.at_hi);
+  scratch_free(I->ctx, basis.head);
+  return status;
+}
+
+// Exactly one of A or sp is expected to be non-NULL.
+static alg__Status run_lp_interior(alg__Context ctx, alg__Mat A, alg__SpMat sp, alg__Mat b,
+                                   alg__Mat x, alg__Mat c, alg__LPOptions *opts) {
+  int m = (A ? num_rows(A) : sp->nrows);
+  int n = (A ? num_cols(A) : sp->ncols);
+  size_t m_doubles = max(m, 1) * sizeof(double), n_doubles = max(n, 1) * sizeof(double);
+  Interior I = {
+    .ctx = ctx, .m = m, .n = n, .A = A, .sp = sp,
+    .x      = scratch_alloc(ctx, n_doubles),
+    .y      = scratch_alloc(ctx, m_doubles),
+    .z      = scratch_alloc(ctx, n_doubles),
+    .dx     = scratch_alloc(ctx, n_doubles),
+    .dy     = scratch_alloc(ctx, m_doubles),
+    .dz     = scratch_alloc(ctx, n_doubles),
+    .dx_aff = scratch_alloc(ctx, n_doubles),
+    .dz_aff = scratch_alloc(ctx, n_doubles),
+    .d      = scratch_alloc(ctx, n_doubles),
+    .rb     = scratch_alloc(ctx, m_doubles),
+    .rc     = scratch_alloc(ctx, n_doubles),
+    .rhs    = scratch_alloc(ctx, m_doubles),
+    .M      = scratch_alloc(ctx, max(m, 1) * m_doubles) };
+
+  double t = now_seconds();
+  alg__Status status = interior_run(&I, b, c);
+  if (opts->stats) {
+    opts->stats->interior_iters   += I.iters;
+    opts->stats->interior_seconds += now_seconds() - t;
+  }
+  if (status == alg__status_ok) {
+    if (opts->crossover) {
+      status = interior_crossover(&I, b, x, c, opts);
+    } else {
+      for (int j = 0; j < n; ++j) set_elt64(x, j, 0, I.x[j]);
+    }
+  } else if (status == alg__status_in_progress) {
+    // The iterations stalled; the simplex method settles the LP instead.
+    alg__LPOptions revised_opts = *opts;
+    revised_opts.algorithm = alg__lp_revised;
+    status = run_lp_revised(ctx, A, sp, b, x, c, NULL, &revised_opts);
+  }
+
+  void *ptrs[] = { I.x, I.y, I.z, I.dx, I.dy, I.dz, I.dx_aff, I.dz_aff, I.d,
+                   I.rb, I.rc, I.rhs, I.M };
+  for (int i = 0; i < (int)(sizeof(ptrs) / sizeof(ptrs[0])); ++i) scratch_free(ctx, ptrs[i]);
+  return status;
+}
+
+// The scratch bytes used by run_lp_interior with a context.
+static size_t run_lp_interior_bytes(int m, int n, alg__LPOptions *opts) {
+  size_t m_doubles = scratch_bytes(max(m, 1) * sizeof(double));
+  size_t n_doubles = scratch_bytes(max(n, 1) * sizeof(double));
+  size_t bytes = 4 * m_doubles + 9 * n_doubles + scratch_bytes((size_t)max(m, 1) * m * sizeof(double)) +
+                 run_lp_revised_bytes(m, n, opts);  // For the crossover or a stalled run.
+  if (opts->crossover) {
+    // The crossover always passes a basis to run_lp_revised, which checks it
+    // with n + m bytes.
+    bytes += scratch_bytes(max(n, 1) * sizeof(KeyedIndex)) + scratch_bytes(max(m, 1) * sizeof(int)) +
+             scratch_bytes(n + 1) + (opts->basis ? 0 : scratch_bytes(n + m));
+  }
+  return bytes;
+}
+
+
+// Presolve.
+//
+// This removes the parts of an LP whose values are forced before a solver
+// sees it: empty rows; rows with one entry, which fix their variable; fixed
+// and empty columns; free columns with one entry, whose row then only
+// defines them; and rows that are multiples of other rows. The rows and
+// columns that remain are then scaled by powers of 2, which keeps every
+// digit, toward entries of size 1. Postsolve maps the solution of the
+// reduced problem back to the original variables.
+
+#define presolve_scale_passes 4
+#define presolve_rel_tol      1e-6   // Rows this close, relatively, are parallel.
+
+typedef struct {
+  alg__Context ctx;        // Every array below comes from its scratch memory.
+  alg__Mat A, b;
+  int      m, n, abs_cost;
+  int      unbdd;                 // Set if the LP is unbounded once it is feasible.
+  float   *lo, *hi;
+  char    *row_on, *col_on;       // The rows and columns that remain.
+  int     *row_nnz, *col_nnz;     // Nonzeros among the remaining rows and columns.
+  double  *b_rest, *c_rest;       // b and c, less what removed columns account for.
+  double  *x_val;                 // The values of removed columns, and later of all.
+  int     *singles, nsingles;     // Pairs (j, i) of removed free column singletons.
+  KeyedIndex *keys;               // Row signatures used to find parallel rows.
+  int     *rows, *cols, m2, n2;   // The remaining rows and columns, in order.
+  float   *row_scale, *col_scale;
+} Presolve;
+
+static void presolve_init(Presolve *P, alg__Context ctx, alg__Mat A, alg__Mat b,
+                          alg__Mat c, Bounds *bounds) {
+  int m = num_rows(A), n = num_cols(A);
+  *P = (Presolve) { .ctx = ctx, .A = A, .b = b, .m = m, .n = n,
+                    .abs_cost = (bounds && bounds->abs_cost) };
+  P->lo        = scratch_alloc(ctx, max(n, 1) * sizeof(float));
+  P->hi        = scratch_alloc(ctx, max(n, 1) * sizeof(float));
+  P->row_on    = scratch_alloc(ctx, max(m, 1));
+  P->col_on    = scratch_alloc(ctx, max(n, 1));
+  P->row_nnz   = scratch_alloc(ctx, max(m, 1) * sizeof(int));
+  P->col_nnz   = scratch_alloc(ctx, max(n, 1) * sizeof(int));
+  P->b_rest    = scratch_alloc(ctx, max(m, 1) * sizeof(double));
+  P->c_rest    = scratch_alloc(ctx, max(n, 1) * sizeof(double));
+  P->x_val     = scratch_alloc(ctx, max(n, 1) * sizeof(double));
+  P->singles   = scratch_alloc(ctx, max(n, 1) * 2 * sizeof(int));
+  P->keys      = scratch_alloc(ctx, max(m, 1) * sizeof(KeyedIndex));
+  P->rows      = scratch_alloc(ctx, max(m, 1) * sizeof(int));
+  P->cols      = scratch_alloc(ctx, max(n, 1) * sizeof(int));
+  P->row_scale = scratch_alloc(ctx, max(m, 1) * sizeof(float));
+  P->col_scale = scratch_alloc(ctx, max(n, 1) * sizeof(float));
+
+  alg__Mat lo = (bounds ? bounds->lo : NULL), hi = (bounds ? bounds->hi : NULL);
+  for (int j = 0; j < n; ++j) {
+    P->lo[j] = (P->abs_cost ? -INFINITY : lo ? col_elt(lo, j) : 0);
+    P->hi[j] = (P->abs_cost ?  INFINITY : hi ? col_elt(hi, j) : INFINITY);
+    P->c_rest[j] = col_elt(c, j);
+    P->x_val[j]  = 0;
+    P->col_on[j] = true;
+    P->col_nnz[j] = 0;
+  }
+  for (int i = 0; i < m; ++i) {
+    P->b_rest[i] = col_elt(b, i);
+    P->row_on[i] = true;
+    P->row_nnz[i] = 0;
+    for (int j = 0; j < n; ++j) {
+      if (elt(A, i, j) == 0) continue;
+      P->row_nnz[i]++;
+      P->col_nnz[j]++;
+    }
+  }
+}
+
+static void presolve_free(Presolve *P) {
+  void *arrays[] = { P->col_scale, P->row_scale, P->cols, P->rows, P->keys, P->singles,
+                     P->x_val, P->c_rest, P->b_rest, P->col_nnz, P->row_nnz, P->col_on,
+                     P->row_on, P->hi, P->lo };
+  for (int k = 0; k < (int)(sizeof(arrays) / sizeof(arrays[0])); ++k) {
+    scratch_free(P->ctx, arrays[k]);
+  }
+}
+
+// The scratch bytes used by presolve for an m x n problem, including the
+// reduced problem that run_lp_presolved builds.
+static size_t presolve_bytes(int m, int n, alg__LPOptions *opts) {
+  if (!opts->presolve) return 0;
+  size_t m_ = max(m, 1), n_ = max(n, 1);
+  return 2 * scratch_bytes(n_ * sizeof(float)) + scratch_bytes(m_) + scratch_bytes(n_) +
+         scratch_bytes(m_ * sizeof(int)) + scratch_bytes(n_ * sizeof(int)) +
+         scratch_bytes(m_ * sizeof(double)) + 2 * scratch_bytes(n_ * sizeof(double)) +
+         scratch_bytes(n_ * 2 * sizeof(int)) + scratch_bytes(m_ * sizeof(KeyedIndex)) +
+         scratch_bytes(m_ * sizeof(int)) + scratch_bytes(n_ * sizeof(int)) +
+         scratch_bytes(m_ * sizeof(float)) + scratch_bytes(n_ * sizeof(float)) +
+         tmp_matrix_bytes(m, n) + tmp_matrix_bytes(m, 1) + 4 * tmp_matrix_bytes(n, 1);
+}
+
+static void presolve_drop_row(Presolve *P, int i) {
+  P->row_on[i] = false;
+  for (int j = 0; j < P->n; ++j) {
+    if (P->col_on[j] && elt(P->A, i, j) != 0) P->col_nnz[j]--;
+  }
+}
+
+static void presolve_fix_col(Presolve *P, int j, double v) {
+  P->col_on[j] = false;
+  P->x_val[j]  = v;
+  for (int i = 0; i < P->m; ++i) {
+    float a = elt(P->A, i, j);
+    if (!P->row_on[i] || a == 0) continue;
+    P->b_rest[i] -= a * v;
+    P->row_nnz[i]--;
+  }
+}
+
+// Returns the column of the first remaining nonzero in row i.
+static int presolve_first_col(Presolve *P, int i) {
+  for (int j = 0; j < P->n; ++j) {
+    if (P->col_on[j] && elt(P->A, i, j) != 0) return j;
+  }
+  return -1;
+}
+
+// Handles the rows with at most one remaining entry.
+static alg__Status presolve_rows(Presolve *P, int *changed) {
+  for (int i = 0; i < P->m; ++i) {
+    if (!P->row_on[i] || P->row_nnz[i] > 1) continue;
+    *changed = true;
+    double b_i = col_elt(P->b, i);
+    if (P->row_nnz[i] == 0) {
+      if (fabs(P->b_rest[i]) > tol * (1 + fabs(b_i))) {
+        alg__err_str = "There are no solutions x with Ax=b and lo <= x <= hi.";
+        return alg__status_no_soln;
+      }
+      presolve_drop_row(P, i);
+      continue;
+    }
+    int    j = presolve_first_col(P, i);
+    double v = P->b_rest[i] / elt(P->A, i, j);
+    if (v < P->lo[j] - tol * (1 + fabs(v)) || v > P->hi[j] + tol * (1 + fabs(v))) {
+      alg__err_str = "There are no solutions x with Ax=b and lo <= x <= hi.";
+      return alg__status_no_soln;
+    }
+    presolve_drop_row(P, i);
+    presolve_fix_col(P, j, fmin(fmax(v, P->lo[j]), P->hi[j]));
+  }
+  return alg__status_ok;
+}
+
+// Handles fixed and empty columns, and free column singletons.
+static void presolve_cols(Presolve *P, int *changed) {
+  for (int j = 0; j < P->n; ++j) {
+    if (!P->col_on[j]) continue;
+    float lo = P->lo[j], hi = P->hi[j];
+    double c = P->c_rest[j];
+    if (P->col_nnz[j] == 0) {
+      // This variable only affects the cost, so it goes to its best bound.
+      // If that bound is infinite, the LP is unbounded unless the rest of
+      // it is infeasible, which only solving the rest can tell.
+      double v = (c > tol ? lo : c < -tol ? hi : start_value(lo, hi));
+      if (P->abs_cost) v = (c < -tol ? INFINITY : 0);
+      if (isinf(v)) {
+        P->unbdd = true;
+        v = (P->abs_cost ? 0 : start_value(lo, hi));
+      }
+      presolve_fix_col(P, j, v);
+    } else if (!P->abs_cost && lo == hi) {
+      presolve_fix_col(P, j, lo);
+    } else if (!P->abs_cost && P->col_nnz[j] == 1 && lo == -INFINITY && hi == INFINITY) {
+      // Row i can always be met by x_j, so it drops out, and x_j's share of
+      // the cost moves onto the other variables of row i.
+      int i = 0;
+      while (!P->row_on[i] || elt(P->A, i, j) == 0) ++i;
+      double ratio = c / elt(P->A, i, j);
+      for (int k = 0; k < P->n; ++k) {
+        if (k != j && P->col_on[k]) P->c_rest[k] -= ratio * elt(P->A, i, k);
+      }
+      presolve_drop_row(P, i);
+      P->col_on[j] = false;
+      P->singles[2 * P->nsingles]     = j;
+      P->singles[2 * P->nsingles + 1] = i;
+      P->nsingles++;
+    } else {
+      continue;
+    }
+    *changed = true;
+  }
+}
+
+// Returns true if the remaining parts of rows i and k are parallel, and sets
+// *ratio so that row k = ratio * row i.
+static int presolve_are_parallel(Presolve *P, int i, int k, double *ratio) {
+  int f = presolve_first_col(P, i);
+  if (f != presolve_first_col(P, k)) return false;
+  *ratio = (double)elt(P->A, k, f) / elt(P->A, i, f);
+  for (int j = f; j < P->n; ++j) {
+    if (!P->col_on[j]) continue;
+    double a_k = elt(P->A, k, j), a_i = *ratio * elt(P->A, i, j);
+    if (fabs(a_k - a_i) > presolve_rel_tol * (fabs(a_k) + fabs(a_i))) return false;
+  }
+  return true;
+}
+
+// Drops each row that is a multiple of another. Rows are first sorted by a
+// signature that parallel rows share, so only neighbors are compared.
+static alg__Status presolve_parallel_rows(Presolve *P, int *changed) {
+  int nkeys = 0;
+  for (int i = 0; i < P->m; ++i) {
+    if (!P->row_on[i]) continue;
+    int    f   = presolve_first_col(P, i);
+    double sig = 0;
+    for (int j = f; j < P->n; ++j) {
+      if (P->col_on[j]) sig += elt(P->A, i, j) * (1 + fmod(j * 0.6180339887, 1.0));
+    }
+    P->keys[nkeys++] = (KeyedIndex) { sig / elt(P->A, i, f), i };
+  }
+  qsort(P->keys, nkeys, sizeof(KeyedIndex), cmp_keys_descending);
+
+  for (int p = 0; p < nkeys; ++p) {
+    int i = P->keys[p].j;
+    if (!P->row_on[i]) continue;
+    for (int q = p + 1; q < nkeys; ++q) {
+      double key = P->keys[p].key;
+      if (fabs(P->keys[q].key - key) > presolve_rel_tol * (1 + fabs(key))) break;
+      int    k = P->keys[q].j;
+      double ratio;
+      if (!P->row_on[k] || !presolve_are_parallel(P, i, k, &ratio)) continue;
+      if (fabs(P->b_rest[k] - ratio * P->b_rest[i]) > tol * (1 + fabs(P->b_rest[k]))) {
+        alg__err_str = "There are no solutions x with Ax=b and lo <= x <= hi.";
+        return alg__status_no_soln;
+      }
+      presolve_drop_row(P, k);
+      *changed = true;
+    }
+  }
+  return alg__status_ok;
+}
+
+// Removes what it can, and then lists what remains in rows and cols.
+static alg__Status presolve_reduce(Presolve *P) {
+  for (int j = 0; j < P->n && !P->abs_cost; ++j) {
+    if (P->lo[j] <= P->hi[j] && P->lo[j] < INFINITY && P->hi[j] > -INFINITY) continue;
+    alg__err_str = "Each variable is expected to have lo <= hi, with lo < inf and hi > -inf.";
+    return alg__status_input_error;
+  }
+  alg__Status status = alg__status_ok;
+  for (int changed = true; changed;) {
+    changed = false;
+    if ((status = presolve_rows(P, &changed)) != alg__status_ok) return status;
+    presolve_cols(P, &changed);
+    if (changed) continue;
+    if ((status = presolve_parallel_rows(P, &changed)) != alg__status_ok) return status;
+  }
+  for (int i = 0; i < P->m; ++i) {
+    if (P->row_on[i]) P->rows[P->m2++] = i;
+  }
+  for (int j = 0; j < P->n; ++j) {
+    if (P->col_on[j]) P->cols[P->n2++] = j;
+  }
+  dbg_printf("Presolve reduced %dx%d to %dx%d.\n", P->m, P->n, P->m2, P->n2);
+  return alg__status_ok;
+}
+
+// The power of 2 nearest to v > 0.
+static float nearest_pow2(double v) {
+  return ldexp(1, (int)lround(log2(v)));
+}
+
+// Scales row i of A2 by s if is_row is set, and otherwise column i.
+static void scale_line(alg__Mat A2, int i, int is_row, float s) {
+  int len = (is_row ? num_cols(A2) : num_rows(A2));
+  for (int k = 0; k < len; ++k) {
+    if (is_row) elt(A2, i, k) *= s;
+    else        elt(A2, k, i) *= s;
+  }
+}
+
+// Scales A2 = R A C, with positive diagonal R and C, so that its nonzeros
+// are near 1: a few passes divide each row and then each column by the
+// geometric mean of its largest and smallest nonzero, and a last pass
+// divides each column by its largest nonzero.
+static void presolve_scale(Presolve *P, alg__Mat A2) {
+  int m2 = P->m2, n2 = P->n2;
+  for (int i = 0; i < m2; ++i) P->row_scale[i] = 1;
+  for (int j = 0; j < n2; ++j) P->col_scale[j] = 1;
+  for (int pass = 0; pass <= presolve_scale_passes; ++pass) {
+    for (int is_row = (pass < presolve_scale_passes); is_row >= 0; --is_row) {
+      int    nlines = (is_row ? m2 : n2), len = (is_row ? n2 : m2);
+      float *scale  = (is_row ? P->row_scale : P->col_scale);
+      for (int i = 0; i < nlines; ++i) {
+        double a_max = 0, a_min = INFINITY;
+        for (int k = 0; k < len; ++k) {
+          double a = fabs(is_row ? elt(A2, i, k) : elt(A2, k, i));
+          if (a == 0) continue;
+          a_max = fmax(a_max, a);
+          a_min = fmin(a_min, a);
+        }
+        if (a_max == 0) continue;
+        double mean = (pass < presolve_scale_passes ? sqrt(a_max * a_min) : a_max);
+        float  s    = nearest_pow2(1 / mean);
+        scale_line(A2, i, is_row, s);
+        scale[i] *= s;
+      }
+    }
+  }
+}
+
+// Builds the scaled reduced problem: A2 = R A C, b2 = R b, and c2 = C c,
+// with bounds lo2 = C^-1 lo and hi2 = C^-1 hi, so that x = C x2.
+static void presolve_build(Presolve *P, alg__Mat A2, alg__Mat b2, alg__Mat c2,
+                           alg__Mat lo2, alg__Mat hi2) {
+  for (int i = 0; i < P->m2; ++i) {
+    for (int j = 0; j < P->n2; ++j) elt(A2, i, j) = elt(P->A, P->rows[i], P->cols[j]);
+  }
+  presolve_scale(P, A2);
+  for (int i = 0; i < P->m2; ++i) col_elt(b2, i) = P->row_scale[i] * P->b_rest[P->rows[i]];
+  for (int j = 0; j < P->n2; ++j) {
+    int k = P->cols[j];
+    col_elt(c2, j)  = P->col_scale[j] * P->c_rest[k];
+    col_elt(lo2, j) = P->lo[k] / P->col_scale[j];
+    col_elt(hi2, j) = P->hi[k] / P->col_scale[j];
+  }
+}
+
+// Sets x from the solution x2 of the reduced problem.
+static void presolve_postsolve(Presolve *P, alg__Mat x2, alg__Mat x) {
+  for (int j = 0; j < P->n2; ++j) P->x_val[P->cols[j]] = P->col_scale[j] * col_elt(x2, j);
+
+  // Each free column singleton solves its row, given every variable that
+  // was still there when it was removed.
+  for (int s = P->nsingles - 1; s >= 0; --s) {
+    int    j = P->singles[2 * s], i = P->singles[2 * s + 1];
+    double sum = elt64(P->b, i, 0);
+    for (int k = 0; k < P->n; ++k) {
+      if (k != j) sum -= elt64(P->A, i, k) * P->x_val[k];
+    }
+    P->x_val[j] = sum / elt64(P->A, i, j);
+  }
+  for (int j = 0; j < P->n; ++j) set_elt64(x, j, 0, P->x_val[j]);
+}
+
+
+// Public functions.
+
+// 1. Create. copy, destroy, or print a matrix.
+
+alg__Mat alg__alloc_matrix(int nrows, int ncols) {
+  alg__Mat M = malloc(sizeof(alg__MatStruct));
+  *M = (alg__MatStruct) {
+         .data  = malloc(data_size(nrows, ncols)),
+         .nrows = nrows,
+         .ncols = ncols,
+         .is_transposed = false,
+         .ld    = ncols };
+  return M;
+}
+
+alg__Mat alg__alloc_matrix64(int nrows, int ncols) {
+  alg__Mat M = alg__alloc_matrix(nrows, ncols);
+  M->data64 = malloc(sizeof(double) * nrows * ncols);
+  return M;
+}
+
+void alg__round_matrix(alg__Mat M) {
+  for (int r = 0; r < M->nrows; ++r) {
+    size_t start = (size_t)r * alg__ld(M);
+    for (int c = 0; c < M->ncols; ++c) M->data[start + c] = M->data64[start + c];
+  }
+}
+
+// The copy of a view has its own data, with ld = ncols.
+alg__Mat alg__copy_matrix(alg__Mat orig) {
+  alg__Mat M = (orig->data64 ? alg__alloc_matrix64 : alg__alloc_matrix)(orig->nrows, orig->ncols);
+  M->is_transposed = orig->is_transposed;
+  for (int r = 0; r < M->nrows; ++r) {
+    size_t src = (size_t)r * alg__ld(orig), dst = (size_t)r * M->ld;
+    memcpy(M->data + dst, orig->data + src, M->ncols * sizeof(float));
+    if (orig->data64) memcpy(M->data64 + dst, orig->data64 + src, M->ncols * sizeof(double));
+  }
+  return M;
+}
+
+void alg__free_matrix(alg__Mat M) {
+  if (M->is_view) {
+    // The data belongs to another matrix.
+  } else if (M->map) {
+    munmap(M->map, M->map_size);
+  } else {
+    free(M->data64);
+    free(M->data);
+  }
+  free(M);
+}
+
+alg__Status alg__save_matrix(alg__Mat M, const char *path) {
+  FileHeader h = { .kind  = file_dense,
+                   .flags = (M->is_transposed ? file_transposed : 0) |
+                            (M->data64 ? file_has_data64 : 0),
+                   .nrows = M->nrows, .ncols = M->ncols, .nnz = (int64_t)M->nrows * M->ncols };
+  FileArray arrays[] = { { M->data,   sizeof(float),  M->nrows, M->ncols, alg__ld(M) },
+                         { M->data64, sizeof(double), M->nrows, M->ncols, alg__ld(M) } };
+  return file_save(path, &h, arrays, M->data64 ? 2 : 1);
+}
+
+alg__Mat alg__map_matrix(const char *path) {
+  size_t map_size;
+  FileHeader *h = file_map(path, file_dense, &map_size);
+  if (h == NULL) return NULL;
+  uint64_t size    = (uint64_t)h->nrows * h->ncols;
+  int has_data64   = (h->flags & file_has_data64) != 0;
+  float   *data    = file_array(h, map_size, 0, size * sizeof(float));
+  double  *data64  = (has_data64 ? file_array(h, map_size, 1, size * sizeof(double)) : NULL);
+  if (data == NULL || (has_data64 && data64 == NULL)) {
+    munmap(h, map_size);
+    alg__err_str = "The file is truncated or corrupt.";
+    return NULL;
+  }
+  alg__Mat M = malloc(sizeof(alg__MatStruct));
+  *M = (alg__MatStruct) {
+         .data     = data,
+         .data64   = data64,
+         .nrows    = h->nrows,
+         .ncols    = h->ncols,
+         .is_transposed = (h->flags & file_transposed) != 0,
+         .ld       = h->ncols,
+         .map      = h,
+         .map_size = map_size };
+  return M;
+}
+
+alg__Mat alg__view(alg__Mat M, int i, int j, int nrows, int ncols) {
+  if (i < 0 || j < 0 || nrows < 0 || ncols < 0 ||
+      i + nrows > num_rows(M) || j + ncols > num_cols(M)) {
+    alg__err_str = "The view is expected to lie within the matrix.";
+    return NULL;
+  }
+  alg__Mat V = malloc(sizeof(alg__MatStruct));
+  *V = sub_view(M, i, j, nrows, ncols);
+  return V;
+}
+
+alg__Mat alg__view_rows(alg__Mat M, int i, int nrows) {
+  return alg__view(M, i, 0, nrows, num_cols(M));
+}
+
+alg__Mat alg__view_cols(alg__Mat M, int j, int ncols) {
+  return alg__view(M, 0, j, num_rows(M), ncols);
+}
+
+alg__Mat alg__view_transpose(alg__Mat M) {
+  alg__Mat V = alg__view(M, 0, 0, num_rows(M), num_cols(M));
+  V->is_transposed = !V->is_transposed;
+  return V;
+}
+
+char *alg__matrix_as_str(alg__Mat M) {
+  char **row_strs = alloca(num_rows(M) * sizeof(char *));
+  size_t sum_bytes = 1;  // Start at 1 for the null terminator.
+  for (int row = 0; row < num_rows(M); ++row) {
+    size_t buf_len = 16 * (num_cols(M) + 1);
+    char *s = row_strs[row] = alloca(buf_len);
+    char *s_end = s + buf_len;
+    s += snprintf(s, s_end - s, "( ");
+    for (int col = 0; col < num_cols(M); ++col) {
+      s += snprintf(s, s_end - s, "%8.2g ", elt(M, row, col));
+    }
+    s += snprintf(s, s_end - s, ")\n");
+    sum_bytes += (s - row_strs[row]);
+  }
+  char *sum_s = malloc(sum_bytes);
+  char *s     = sum_s;
+  for (int r = 0; r < num_rows(M); ++r) s = stpcpy(s, row_strs[r]);
+  return sum_s;
+}
+
+// 2. Basic matrix operations.
+
+float alg__dot_prod(alg__Mat A, int i, alg__Mat B, int j) {
+  if (num_rows(A) != num_rows(B)) {
+    alg__err_str = "Expected A, B to have the same #rows.";
+    return 0.0 / 0.0;  // If NaN is supported, it is returned here.
+  }
+  int    inc_a, inc_b;
+  float *a = col_ptr(A, i, &inc_a);
+  float *b = col_ptr(B, j, &inc_b);
+  return vec_dot(num_rows(A), a, inc_a, b, inc_b);
+}
+
+void alg__mul_and_add(float c, alg__Mat A, int i, alg__Mat B, int j) {
+  int    inc_a, inc_b;
+  float *a = col_ptr(A, i, &inc_a);
+  float *b = col_ptr(B, j, &inc_b);
+  vec_axpy(num_rows(A), c, a, inc_a, b, inc_b);
+}
+
+void alg__scale(float c, alg__Mat A, int i) {
+  int    inc;
+  float *a = col_ptr(A, i, &inc);
+  vec_scal(num_rows(A), c, a, inc);
+}
+
+alg__Status alg__gemm(int trans_a, int trans_b, float alpha, alg__Mat A, alg__Mat B,
+                      float beta, alg__Mat C) {
+  int m = (trans_a ? num_cols(A) : num_rows(A)), k = (trans_a ? num_rows(A) : num_cols(A));
+  int k_b = (trans_b ? num_cols(B) : num_rows(B)), n = (trans_b ? num_rows(B) : num_cols(B));
+  if (k != k_b || num_rows(C) != m || num_cols(C) != n) {
+    alg__err_str = "op(A), op(B), and C are expected to be m x k, k x n, and m x n.";
+    return alg__status_input_error;
+  }
+  gemm(NULL, trans_a, trans_b, alpha, A, B, beta, C, solver_num_threads());
+  return alg__status_ok;
+}
+
+float alg__norm(alg__Mat A, int i) {
+  float norm_squared = alg__dot_prod(A, i, A, i);
+  return sqrtf(norm_squared);
+}
+
+// 3. Decompositions.
+
+// This is modified Gram-Schmidt on the columns of Q.
+static alg__Status gram_schmidt_qr(alg__Mat Q, alg__Mat R) {
+  // The column operations below are fastest on contiguous columns, so we
+  // work on a transposed copy of a row-major Q.
+  alg__Mat W = Q;
+  if (!Q->is_transposed && num_cols(Q) > 1) {
+    W = alg__alloc_matrix(num_cols(Q), num_rows(Q));
+    W->is_transposed = true;
+    for (int r = 0; r < num_rows(Q); ++r) {
+      for (int c = 0; c < num_cols(Q); ++c) elt(W, r, c) = elt(Q, r, c);
+    }
+  }
+
+  alg__Status status = alg__status_ok;
+  // W starts off as an arbitrary tall-or-square matrix A.
+  for (int i = 0; i < num_cols(W); ++i) {
+    float norm = alg__norm(W, i);
+    if (norm == 0) {
+      status = alg__status_lin_dep;
+      continue;
+    }
+    alg__scale(1.0 / norm, W, i);
+    if (R) elt(R, i, i) = norm;
+    for (int j = i + 1; j < num_cols(W); ++j) {
+      float dot_prod = alg__dot_prod(W, i, W, j);
+      if (R) elt(R, i, j) = dot_prod;
+      alg__mul_and_add(-dot_prod, W, i, W, j);
+    }
+  }
+
+  if (W != Q) {
+    for (int r = 0; r < num_rows(Q); ++r) {
+      for (int c = 0; c < num_cols(Q); ++c) elt(Q, r, c) = elt(W, r, c);
+    }
+    alg__free_matrix(W);
+  }
+  return status;
+}
+
+// With a context, this runs on the calling thread, and its temporaries come
+// from the context's scratch memory.
+static alg__Status qr(alg__Context ctx, alg__Mat Q, alg__Mat R, alg__QROptions *opts) {
+  if (num_rows(Q) < num_cols(Q)) {
+    alg__err_str = "Expected alg__QR input to be a tall or square matrix.";
+    return alg__status_input_error;
+  }
+  alg__QROptions default_opts = {0};
+  if (opts == NULL) opts = &default_opts;
+
+  if (R) set_zero(R);
+  if (opts->method == alg__qr_gram_schmidt) return gram_schmidt_qr(Q, R);
+
+  int m = num_rows(Q), n = num_cols(Q);
+  int num_threads = (opts->num_threads > 0 ? opts->num_threads : solver_num_threads());
+  if (ctx) num_threads = 1;
+  float *a = scratch_alloc(ctx, (size_t)m * n * sizeof(float));
+  float *r = scratch_alloc(ctx, (size_t)n * n * sizeof(float));
+  float *a_norms = scratch_alloc(ctx, n * sizeof(float));
+  copy_colmajor(Q, a, false);
+  for (int j = 0; j < n; ++j) a_norms[j] = sqrtf(vec_dot(m, a + (size_t)j * m, 1, a + (size_t)j * m, 1));
+
+  qr_colmajor(ctx, a, m, n, r, opts->method, num_threads);
+
+  // A column whose diagonal entry in R is small next to its norm is nearly
+  // in the span of the columns before it.
+  alg__Status status = alg__status_ok;
+  for (int j = 0; j < n; ++j) {
+    if (r[j + j * n] <= tol * a_norms[j]) status = alg__status_lin_dep;
+    if (R) {
+      for (int i = 0; i <= j; ++i) elt(R, i, j) = r[i + j * n];
+    }
+  }
+  copy_colmajor(Q, a, true);
+
+  scratch_free(ctx, a_norms);
+  scratch_free(ctx, r);
+  scratch_free(ctx, a);
+  return status;
+}
+
+// The scratch bytes used by qr with a context for an m x n matrix.
+static size_t qr_bytes(int m, int n) {
+  return 2 * scratch_bytes((size_t)m * n * sizeof(float)) +
+         scratch_bytes((size_t)n * n * sizeof(float)) + scratch_bytes(n * sizeof(float)) +
+         scratch_bytes(max(n, 1) * sizeof(float)) + 2 * block_reflector_bytes(m);
+}
+
+alg__Status alg__QR(alg__Mat Q, alg__Mat R) {
+  return qr(NULL, Q, R, NULL);
+}
+
+alg__Status alg__QR_opts(alg__Mat Q, alg__Mat R, alg__QROptions *opts) {
+  return qr(NULL, Q, R, opts);
+}
+
+alg__QRFactor alg__qr_factor(alg__Mat A) {
+  alg__QRFactor F = calloc(1, sizeof(struct alg__QRFactorStruct));
+  int m = num_rows(A), n = num_cols(A);
+  qr_reserve(F, m, n);
+  F->m = m;
+  F->n = n;
+  for (int i = 0; i < m; ++i) {
+    for (int j = 0; j < n; ++j) F->a[(size_t)i * F->ld + j] = elt(A, i, j);
+  }
+  qr_refactor(F);
+  return F;
+}
+
+alg__Status alg__qr_add_row(alg__QRFactor F, alg__Mat row) {
+  int n = F->n;
+  if (num_rows(row) != 1 || num_cols(row) != n) {
+    alg__err_str = "row is expected to have size 1 x #cols(A).";
+    return alg__status_input_error;
+  }
+  qr_reserve(F, F->m + 1, n);
+  float *a_row = F->a + (size_t)F->m++ * F->ld;
+  for (int j = 0; j < n; ++j) a_row[j] = elt(row, 0, j);
+  if (F->r_state != r_ok) {
+    F->r_state = r_stale;
+    return alg__status_ok;
+  }
+
+  // Rotate the new row into R, one entry at a time.
+  float *v = qr_work(F, n);
+  memcpy(v, a_row, n * sizeof(float));
+  for (int j = 0; j < n; ++j) {
+    float *r_j = F->r + (size_t)j * F->ld, c, s;
+    r_j[j] = givens(r_j[j], v[j], &c, &s);
+    rotate(n - j - 1, c, s, r_j + j + 1, v + j + 1);
+  }
+  return alg__status_ok;
+}
+
+alg__Status alg__qr_remove_row(alg__QRFactor F, int i) {
+  if (i < 0 || i >= F->m) {
+    alg__err_str = "The row to remove is out of range.";
+    return alg__status_input_error;
+  }
+  float *a_row = F->a + (size_t)i * F->ld;
+  if (F->r_state != r_ok || !qr_downdate(F, a_row)) F->r_state = r_stale;
+  memmove(a_row, a_row + F->ld, (size_t)(F->m - i - 1) * F->ld * sizeof(float));
+  F->m--;
+  return alg__status_ok;
+}
+
+alg__Status alg__qr_add_col(alg__QRFactor F, alg__Mat col) {
+  int m = F->m;
+  if (num_rows(col) != m || num_cols(col) != 1) {
+    alg__err_str = "col is expected to have size #rows(A) x 1.";
+    return alg__status_input_error;
+  }
+  qr_reserve(F, m, F->n + 1);
+  for (int i = 0; i < m; ++i) F->a[(size_t)i * F->ld + F->n] = elt(col, i, 0);
+  if (F->r_state != r_ok) {
+    F->r_state = r_stale;
+  } else if (!qr_append_col(F)) {
+    F->r_state = r_singular;
+  }
+  F->n++;
+  return alg__status_ok;
+}
+
+alg__Status alg__qr_remove_col(alg__QRFactor F, int j) {
+  int m = F->m, n = F->n, ld = F->ld;
+  if (j < 0 || j >= n) {
+    alg__err_str = "The column to remove is out of range.";
+    return alg__status_input_error;
+  }
+  for (int i = 0; i < m; ++i) {
+    float *a_i = F->a + (size_t)i * ld;
+    memmove(a_i + j, a_i + j + 1, (n - j - 1) * sizeof(float));
+  }
+  F->n--;
+  if (F->r_state != r_ok) {
+    F->r_state = r_stale;
+    return alg__status_ok;
+  }
+
+  // Without column j, rows j..n-1 of R have one entry below the diagonal,
+  // which rotations of neighboring rows clear.
+  for (int i = 0; i < n; ++i) {
+    float *r_i = F->r + (size_t)i * ld;
+    memmove(r_i + j, r_i + j + 1, (n - j - 1) * sizeof(float));
+  }
+  for (int k = j; k < n - 1; ++k) {
+    float *r_k = F->r + (size_t)k * ld, *r_k1 = r_k + ld, c, s;
+    r_k[k]  = givens(r_k[k], r_k1[k], &c, &s);
+    r_k1[k] = 0;
+    rotate(n - k - 2, c, s, r_k + k + 1, r_k1 + k + 1);
+  }
+  return alg__status_ok;
+}
+
+alg__Status alg__qr_solve(alg__QRFactor F, alg__Mat B, alg__Mat X) {
+  int m = F->m, n = F->n, k = num_cols(B);
+  if (num_rows(B) != m || num_rows(X) != n || num_cols(X) != k) {
+    alg__err_str = "B and X are expected to be #rows(A) x k and #cols(A) x k.";
+    return alg__status_input_error;
+  }
+  if (F->r_state == r_stale) qr_refactor(F);
+  if (F->r_state == r_singular) {
+    alg__err_str = "A is expected to have full column rank.";
+    return alg__status_lin_dep;
+  }
+
+  // The first step solves R^T R X = A^T B, and the second adds the solution
+  // for the residual B - A X. The right-hand sides are found as rows of
+  // W = B^T A, so that each one is contiguous.
+  int num_threads = solver_num_threads();
+  float *res = qr_work(F, (size_t)m * k + (size_t)k * n), *w = res + (size_t)m * k;
+  alg__MatStruct A   = { .data = F->a, .nrows = m, .ncols = n, .ld = F->ld };
+  alg__MatStruct Res = { .data = res,  .nrows = m, .ncols = k, .ld = k };
+  alg__MatStruct W   = { .data = w,    .nrows = k, .ncols = n, .ld = n };
+  for (int step = 0; step < 2; ++step) {
+    if (step > 0) {
+      for (int i = 0; i < m; ++i) {
+        for (int c = 0; c < k; ++c) res[(size_t)i * k + c] = elt(B, i, c);
+      }
+      gemm(NULL, false, false, -1, &A, X, 1, &Res, num_threads);
+    }
+    gemm(NULL, true, false, 1, step > 0 ? &Res : B, &A, 0, &W, num_threads);
+    for (int c = 0; c < k; ++c) {
+      float *w_c = w + (size_t)c * n;
+      qr_solve_rt(F, w_c);
+      qr_solve_r(F, w_c);
+      for (int j = 0; j < n; ++j) elt(X, j, c) = (step > 0 ? elt(X, j, c) : 0) + w_c[j];
+    }
+  }
+  return alg__status_ok;
+}
+
+alg__Status alg__qr_get_R(alg__QRFactor F, alg__Mat R) {
+  int n = F->n;
+  if (num_rows(R) != n || num_cols(R) != n) {
+    alg__err_str = "R is expected to have size #cols(A) x #cols(A).";
+    return alg__status_input_error;
+  }
+  if (F->r_state == r_stale) qr_refactor(F);
+  if (F->r_state == r_singular) {
+    alg__err_str = "A is expected to have full column rank.";
+    return alg__status_lin_dep;
+  }
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) elt(R, i, j) = (j < i ? 0 : F->r[(size_t)i * F->ld + j]);
+  }
+  return alg__status_ok;
+}
+
+void alg__free_qr_factor(alg__QRFactor F) {
+  if (F == NULL) return;
+  free(F->work);
+  free(F->r);
+  free(F->a);
+  free(F);
+}
+
+alg__RLS alg__alloc_rls(int n, float forget) {
+  alg__RLS S = malloc(sizeof(struct alg__RLSStruct));
+  *S = (struct alg__RLSStruct) {
+         .n = n, .forget = forget,
+         .r     = calloc(max((size_t)n * (n + 1), 1), sizeof(float)),
+         .block = malloc(max((size_t)rls_block * (n + 1), 1) * sizeof(float)) };
+  return S;
+}
+
+alg__Status alg__rls_add(alg__RLS S, alg__Mat X, alg__Mat y) {
+  int n = S->n, k = num_rows(X);
+  if (num_cols(X) != n || num_rows(y) != k || num_cols(y) != 1) {
+    alg__err_str = "X and y are expected to have sizes k x n and k x 1.";
+    return alg__status_input_error;
+  }
+  float sqrt_forget = sqrtf(S->forget);
+  for (int i0 = 0; i0 < k; i0 += rls_block) {
+    int rows = min(rls_block, k - i0);
+
+    // The rows seen so far lose weight for each new row, and each new row
+    // for each one after it.
+    if (S->forget != 1) {
+      float decay = powf(sqrt_forget, rows);
+      vec_scal(n * (n + 1), decay, S->r, 1);
+      S->rss *= (double)decay * decay;
+    }
+    float w = 1;
+    for (int i = rows - 1; i >= 0; --i) {
+      for (int j = 0; j < n; ++j) S->block[i + (size_t)j * rows] = w * elt(X, i0 + i, j);
+      S->block[i + (size_t)n * rows] = w * elt(y, i0 + i, 0);
+      w *= sqrt_forget;
+    }
+    rls_absorb(S, S->block, rows);
+  }
+  return alg__status_ok;
+}
+
+alg__Status alg__rls_solve(alg__RLS S, alg__Mat x) {
+  int n = S->n, ld = n + 1;
+  if (num_rows(x) != n || num_cols(x) != 1) {
+    alg__err_str = "x is expected to have size n x 1.";
+    return alg__status_input_error;
+  }
+  // Column j of R has the norm of column j of the weighted A.
+  for (int j = 0; j < n; ++j) {
+    float norm = 0;
+    for (int i = 0; i <= j; ++i) norm = hypotf(norm, S->r[(size_t)i * ld + j]);
+    if (!(S->r[(size_t)j * ld + j] > tol * norm)) {
+      alg__err_str = "The rows so far don't have full column rank.";
+      return alg__status_lin_dep;
+    }
+  }
+  float *z = S->block;
+  for (int i = n - 1; i >= 0; --i) {
+    const float *r_i = S->r + (size_t)i * ld;
+    z[i] = (r_i[n] - vec_dot(n - i - 1, r_i + i + 1, 1, z + i + 1, 1)) / r_i[i];
+  }
+  for (int i = 0; i < n; ++i) elt(x, i, 0) = z[i];
+  return alg__status_ok;
+}
+
+float alg__rls_residual(alg__RLS S) {
+  return sqrt(S->rss);
+}
+
+void alg__free_rls(alg__RLS S) {
+  if (S == NULL) return;
+  free(S->block);
+  free(S->r);
+  free(S);
+}
+
+// 4. Optimizations.
+
+static alg__Status run_lp(alg__Context ctx, alg__Mat A, alg__Mat b, alg__Mat x,
+                          alg__Mat c, alg__LPOptions *opts);
+static size_t      run_lp_bytes(int m, int n, alg__LPOptions *opts);
+static alg__Status run_lp_bounded(alg__Context ctx, alg__Mat A, alg__Mat b, alg__Mat x,
+                                  alg__Mat c, Bounds *bounds, alg__LPOptions *opts);
+
+// Solves the presolved problem with the same options, less presolve. The
+// bounds are NULL for the constraint x >= 0, which scaling keeps, so any
+// algorithm can solve the reduced problem.
+static alg__Status run_lp_presolved(alg__Context ctx, alg__Mat A, alg__Mat b, alg__Mat x,
+                                    alg__Mat c, Bounds *bounds, alg__LPOptions *opts) {
+  Presolve P;
+  presolve_init(&P, ctx, A, b, c, bounds);
+  alg__Status status = presolve_reduce(&P);
+  if (status != alg__status_ok) {
+    presolve_free(&P);
+    return status;
+  }
+
+  alg__Mat A2  = alloc_tmp_matrix(ctx, P.m2, P.n2);
+  alg__Mat b2  = alloc_tmp_matrix(ctx, P.m2, 1);
+  alg__Mat c2  = alloc_tmp_matrix(ctx, P.n2, 1);
+  alg__Mat lo2 = alloc_tmp_matrix(ctx, P.n2, 1);
+  alg__Mat hi2 = alloc_tmp_matrix(ctx, P.n2, 1);
+  alg__Mat x2  = alloc_tmp_matrix(ctx, P.n2, 1);
+  presolve_build(&P, A2, b2, c2, lo2, hi2);
+
+  // Presolve leaves either both rows and columns, or neither.
+  if (P.n2 > 0) {
+    alg__LPOptions inner = *opts;
+    inner.presolve = false;
+    if (bounds) {
+      Bounds bounds2 = { .lo = lo2, .hi = hi2, .abs_cost = bounds->abs_cost };
+      status = run_lp_bounded(ctx, A2, b2, x2, c2, &bounds2, &inner);
+    } else {
+      status = run_lp(ctx, A2, b2, x2, c2, &inner);
+    }
+  }
+  if (status == alg__status_ok && P.unbdd) {
+    alg__err_str = unbdd_soln_str;
+    status = alg__status_unbdd_soln;
+  }
+  if (status == alg__status_ok) presolve_postsolve(&P, x2, x);
+
+  free_tmp_matrix(ctx, x2);
+  free_tmp_matrix(ctx, hi2);
+  free_tmp_matrix(ctx, lo2);
+  free_tmp_matrix(ctx, c2);
+  free_tmp_matrix(ctx, b2);
+  free_tmp_matrix(ctx, A2);
+  presolve_free(&P);
+  return status;
+}
+
+// The interior point method needs x >= 0, so this solves for the positive
+// and negative parts u, v >= 0 of x = u - v, with A2 = [A, -A] and cost
+// sum_i u_i + v_i.
+static alg__Status l1_min_interior(alg__Context ctx, alg__Mat A, alg__Mat b, alg__Mat x,
+                                   alg__LPOptions *opts) {
+  if (num_rows(A) != num_rows(b) || num_cols(b) != 1) {
+    alg__err_str = "b is expected to have size #rows(A) x 1.";
+    return alg__status_input_error;
+  }
+  if (num_cols(A) != num_rows(x) || num_cols(x) != 1) {
+    alg__err_str = "x is expected to have size #cols(A) x 1.";
+    return alg__status_input_error;
+  }
+  int m = num_rows(A), n = num_cols(A);
+  alg__Mat A2 = alloc_tmp_matrix(ctx, m, 2 * n);
+  for (int i = 0; i < m; ++i) {
+    for (int j = 0; j < n; ++j) {
+      elt(A2, i, j)     =  elt(A, i, j);
+      elt(A2, i, n + j) = -elt(A, i, j);
+    }
+  }
+  alg__Mat c2 = alloc_tmp_matrix(ctx, 2 * n, 1);
+  for (int r = 0; r < 2 * n; ++r) col_elt(c2, r) = 1;
+  alg__Mat x2 = alloc_tmp_matrix(ctx, 2 * n, 1);
+
+  alg__Status status = run_lp(ctx, A2, b, x2, c2, opts);
+  if (status == alg__status_ok) {
+    for (int j = 0; j < n; ++j) col_elt(x, j) = col_elt(x2, j) - col_elt(x2, n + j);
+  }
+
+  free_tmp_matrix(ctx, x2);
+  free_tmp_matrix(ctx, c2);
+  free_tmp_matrix(ctx, A2);
+  return status;
+}
+
+static alg__Status l1_min(alg__Context ctx, alg__Mat A, alg__Mat b, alg__Mat x,
+                          alg__LPOptions *opts) {
+  if (x == NULL) {
+    alg__err_str = "The matrix x is expected to be pre-allocated.";
+    return alg__status_input_error;
+  }
+
+  if (opts && opts->algorithm == alg__lp_interior) return l1_min_interior(ctx, A, b, x, opts);
+
+  // The simplex method handles the cost sum_i |x_i| directly, so there's no
+  // need to split each x_i into positive and negative parts.
+  alg__Mat c = alloc_tmp_matrix(ctx, num_cols(A), 1);
+  for (int r = 0; r < num_rows(c); ++r) col_elt(c, r) = 1;
+
+  Bounds bounds = { .abs_cost = true };
+  alg__Status status = run_lp_bounded(ctx, A, b, x, c, &bounds, opts);
+
+  free_tmp_matrix(ctx, c);
+
+  return status;
+}
+
+static size_t l1_min_bytes(int m, int n, alg__LPOptions *opts) {
+  if (opts->algorithm == alg__lp_interior) {
+    return tmp_matrix_bytes(m, 2 * n) + 2 * tmp_matrix_bytes(2 * n, 1) +
+           run_lp_bytes(m, 2 * n, opts);
+  }
+  return tmp_matrix_bytes(n, 1) + presolve_bytes(m, n, opts) + run_lp_revised_bytes(m, n, opts);
+}
+
+alg__Status alg__l1_min(alg__Mat A, alg__Mat b, alg__Mat x) {
+  return l1_min(NULL, A, b, x, NULL);
+}
+
+// Tries the Householder factorization, and returns false if A lacks full rank.
+static int l2_factor_householder(alg__L2Factor F, alg__Mat A) {
+  int m = F->m, n = F->n, p = max(m, n), q = min(m, n);
+  alg__MatStruct At = *A;
+  At.is_transposed = !A->is_transposed;
+  F->is_tall = (m > n);
+  F->h       = scratch_alloc(F->ctx, (size_t)p * q * sizeof(float));
+  F->tau     = scratch_alloc(F->ctx, max(q, 1) * sizeof(float));
+  copy_colmajor(F->is_tall ? A : &At, F->h, false);
+
+  float *norms = scratch_alloc(F->ctx, max(q, 1) * sizeof(float));
+  for (int j = 0; j < q; ++j) norms[j] = sqrtf(vec_dot(p, F->h + (size_t)j * p, 1, F->h + (size_t)j * p, 1));
+  house_qr(F->ctx, F->h, p, q, p, F->tau, F->ctx ? 1 : solver_num_threads());
+  int is_full_rank = true;
+  for (int j = 0; j < q; ++j) {
+    if (fabsf(F->h[j + (size_t)j * p]) <= tol * norms[j]) is_full_rank = false;
+  }
+  scratch_free(F->ctx, norms);
+  if (is_full_rank) return true;
+
+  scratch_free(F->ctx, F->h);
+  scratch_free(F->ctx, F->tau);
+  F->h = F->tau = NULL;
+  F->is_tall    = false;
+  return false;
+}
+
+// Factors A with temporaries and the factors themselves in the scratch
+// memory of ctx; with a context, this runs on the calling thread only.
+static alg__L2Factor l2_factor(alg__Context ctx, alg__Mat A) {
+  int m = num_rows(A), n = num_cols(A);
+  alg__L2Factor F = scratch_alloc(ctx, sizeof(struct alg__L2FactorStruct));
+  *F = (struct alg__L2FactorStruct) {
+         .m = m, .n = n, .ctx = ctx,
+         .work_cap = max(m, n) + 1,
+         .work     = scratch_alloc(ctx, (max(m, n) + 1) * sizeof(float)) };
+  if (l2_factor_householder(F, A)) return F;
+  F->q = scratch_alloc(ctx, (size_t)n * m * sizeof(float));
+  F->r = scratch_alloc(ctx, (size_t)m * m * sizeof(float));
+  memset(F->q, 0, (size_t)n * m * sizeof(float));
+  memset(F->r, 0, (size_t)m * m * sizeof(float));
+
+  // Run modified Gram-Schmidt on the rows of A, one row at a time. A row
+  // that is numerically in the span of the earlier rows gets a zero column in
+  // Q and a zero on the diagonal of R.
+  float *v  = scratch_alloc(ctx, n * sizeof(float));
+  float *Qt = scratch_alloc(ctx, (size_t)m * n * sizeof(float));  // Row k is column k of Q.
+  memset(Qt, 0, (size_t)m * n * sizeof(float));
+  for (int i = 0; i < m; ++i) {
+    double a_norm = 0;
+    for (int j = 0; j < n; ++j) {
+      v[j] = elt(A, i, j);
+      a_norm += v[j] * v[j];
+    }
+    for (int k = 0; k < i; ++k) {
+      float *q_k = Qt + k * n;
+      if (F->r[k * m + k] == 0) continue;
+      double dot = 0;
+      for (int j = 0; j < n; ++j) dot += q_k[j] * v[j];
+      for (int j = 0; j < n; ++j) v[j] -= dot * q_k[j];
+      F->r[k * m + i] = dot;
+    }
+    double norm = 0;
+    for (int j = 0; j < n; ++j) norm += v[j] * v[j];
+    norm = sqrt(norm);
+    if (norm <= tol * sqrt(a_norm)) continue;
+    F->r[i * m + i] = norm;
+    for (int j = 0; j < n; ++j) Qt[i * n + j] = v[j] / norm;
+  }
+  for (int k = 0; k < m; ++k) {
+    for (int j = 0; j < n; ++j) F->q[j * m + k] = Qt[k * n + j];
+  }
+  scratch_free(ctx, Qt);
+  scratch_free(ctx, v);
+  return F;
+}
+
+// The scratch bytes used by l2_factor, with room for one right-hand side.
+static size_t l2_factor_bytes(int m, int n) {
+  int p = max(m, n), q = min(m, n);
+  return scratch_bytes(sizeof(struct alg__L2FactorStruct)) +
+         scratch_bytes((max(m, n) + 1) * sizeof(float)) +
+         scratch_bytes((size_t)p * q * sizeof(float)) +
+         2 * scratch_bytes(max(q, 1) * sizeof(float)) +
+         block_reflector_bytes(p) +
+         2 * scratch_bytes((size_t)n * m * sizeof(float)) +
+         scratch_bytes((size_t)m * m * sizeof(float)) +
+         scratch_bytes(n * sizeof(float));
+}
+
+alg__L2Factor alg__l2_factor(alg__Mat A) {
+  return l2_factor(NULL, A);
+}
+
+// Solves with the Householder factors in F->h, one column of B at a time.
+// If is_lsq is set, a tall A gives the least squares solution instead of
+// requiring Ax = b.
+static alg__Status l2_solve_householder(alg__L2Factor F, alg__Mat B, alg__Mat X, int is_lsq) {
+  int m = F->m, n = F->n, p = max(m, n), q = min(m, n);
+  const float *h = F->h;
+  float *y = F->work;
+  for (int c = 0; c < num_cols(B); ++c) {
+    if (F->is_tall) {
+      // With A = Q R, set y = Q^T b; Ax = b has a solution exactly when the
+      // last m - n entries of y are zero, which we check up to roundoff.
+      float b_norm = 0;
+      for (int i = 0; i < m; ++i) y[i] = elt(B, i, c);
+      b_norm = sqrtf(vec_dot(m, y, 1, y, 1));
+      for (int j = 0; j < q; ++j) apply_reflector(p - j, F->tau[j], h + j + (size_t)j * p, y + j);
+      if (!is_lsq && sqrtf(vec_dot(p - q, y + q, 1, y + q, 1)) > tol * b_norm) {
+        alg__err_str = "The solution set is empty.";
+        return alg__status_no_soln;
+      }
+      // Solve R x = y by back substitution.
+      for (int i = q - 1; i >= 0; --i) {
+        float sum = y[i];
+        for (int j = i + 1; j < q; ++j) sum -= h[i + (size_t)j * p] * y[j];
+        y[i] = sum / h[i + (size_t)i * p];
+      }
+    } else {
+      // With A^T = Q R, solve R^T z = b, and then x = Q z is the solution in
+      // the row span of A.
+      for (int i = 0; i < q; ++i) {
+        y[i] = (elt(B, i, c) - vec_dot(i, h + (size_t)i * p, 1, y, 1)) / h[i + (size_t)i * p];
+      }
+      memset(y + q, 0, (p - q) * sizeof(float));
+      for (int j = q - 1; j >= 0; --j) apply_reflector(p - j, F->tau[j], h + j + (size_t)j * p, y + j);
+    }
+    for (int j = 0; j < n; ++j) elt(X, j, c) = y[j];
+  }
+  return alg__status_ok;
+}
+
+alg__Status alg__l2_solve(alg__L2Factor F, alg__Mat B, alg__Mat X) {
+  int m = F->m, n = F->n;
+  if (num_rows(B) != m || num_rows(X) != n || num_cols(B) != num_cols(X)) {
+    alg__err_str = "B and X are expected to be #rows(A) x k and #cols(A) x k.";
+    return alg__status_input_error;
+  }
+  int k    = num_cols(B);
+  int need = (F->h ? max(m, n) : m * k);
+  if (need > F->work_cap) {
+    scratch_free(F->ctx, F->work);
+    F->work_cap = need;
+    F->work     = scratch_alloc(F->ctx, F->work_cap * sizeof(float));
+  }
+  if (F->h) return l2_solve_householder(F, B, X, false);
+
+  // Solve R^T Z = B by forward substitution; row i of Z is z[i * k ..].
+  // A row of A that depends on earlier rows needs a matching entry in B, up
+  // to roundoff on the scale of B's column.
+  float *z = F->work;
+  for (int c = 0; c < k; ++c) {
+    float b_max = 0;
+    for (int i = 0; i < m; ++i) b_max = fmaxf(b_max, fabsf(elt(B, i, c)));
+    for (int i = 0; i < m; ++i) {
+      float b_i  = elt(B, i, c);
+      float sum  = b_i, scale = b_max;
+      for (int p = 0; p < i; ++p) {
+        float term = F->r[p * m + i] * z[p * k + c];
+        sum   -= term;
+        scale += fabsf(term);
+      }
+      float r_ii = F->r[i * m + i];
+      if (r_ii != 0) {
+        z[i * k + c] = sum / r_ii;
+        continue;
+      }
+      if (fabsf(sum) > tol * scale) {
+        alg__err_str = "The solution set is empty.";
+        return alg__status_no_soln;
+      }
+      z[i * k + c] = 0;
+    }
+  }
+
+  // Set X = Q Z.
+  alg__MatStruct Q = { .data = F->q, .nrows = n, .ncols = m, .ld = m };
+  alg__MatStruct Z = { .data = z,    .nrows = m, .ncols = k, .ld = k };
+  gemm(F->ctx, false, false, 1, &Q, &Z, 0, X, solver_num_threads());
+  return alg__status_ok;
+}
+
+static void l2_factor_free(alg__L2Factor F) {
+  if (F == NULL) return;
+  alg__Context ctx = F->ctx;
+  void *ptrs[] = { F->h, F->tau, F->q, F->r, F->work, F };
+  for (int i = 0; i < (int)(sizeof(ptrs) / sizeof(ptrs[0])); ++i) scratch_free(ctx, ptrs[i]);
+}
+
+void alg__free_l2_factor(alg__L2Factor F) {
+  l2_factor_free(F);
+}
+
+// The normal equations.
+//
+// When one side of A is at least chol_min_aspect times the other, the small
+// Gram matrix G = A^T A or A A^T is formed with gemm and factored by Cholesky
+// as L L^T. This reads A in place, where QR would copy and rewrite all of it.
+// Forming G squares the condition number of A, so a G that looks badly
+// conditioned is left to QR instead.
+
+#define chol_min_aspect 4
+#define chol_min_rcond  1e-3  // The least (min L_ii / max L_ii)^2 we accept.
+#define normal_eq_steps 2
+
+// Factors the n x n symmetric row-major matrix a in place as L L^T, with L
+// in the lower triangle. Returns false if a is not numerically positive
+// definite, or if its condition number, estimated from the diagonal of L,
+// exceeds 1 / chol_min_rcond.
+static int chol_factor(float *a, int n) {
+  float d_min = INFINITY, d_max = 0;
+  for (int j = 0; j < n; ++j) {
+    float *a_j = a + (size_t)j * n;
+    float d    = a_j[j] - vec_dot(j, a_j, 1, a_j, 1);
+    if (!(d > tol * a_j[j])) return false;
+    a_j[j] = d = sqrtf(d);
+    for (int i = j + 1; i < n; ++i) {
+      float *a_i = a + (size_t)i * n;
+      a_i[j] = (a_i[j] - vec_dot(j, a_i, 1, a_j, 1)) / d;
+    }
+    d_min = fminf(d_min, d);
+    d_max = fmaxf(d_max, d);
+  }
+  return n == 0 || (d_min / d_max) * (d_min / d_max) >= chol_min_rcond;
+}
+
+// Solves L L^T z = x in place, where L is the output of chol_factor.
+static void chol_solve(const float *l, int n, float *x) {
+  for (int i = 0; i < n; ++i) {
+    x[i] = (x[i] - vec_dot(i, l + (size_t)i * n, 1, x, 1)) / l[i + (size_t)i * n];
+  }
+  for (int i = n - 1; i >= 0; --i) {
+    x[i] /= l[i + (size_t)i * n];
+    vec_axpy(i, -x[i], l + (size_t)i * n, 1, x, 1);
+  }
+}
+
+// Sets x to the least squares solution A^T A x = A^T b when A is tall, and to
+// the least norm solution x = A^T z with A A^T z = b otherwise. Returns false,
+// with x unset, if A is too close to square or G is rejected by chol_factor.
+// The solve is followed by normal_eq_steps - 1 steps of refinement, each of
+// which solves again for the residual b - A x; in float, the first solve
+// alone loses about twice as many digits as QR would.
+static int normal_eq_solve(alg__Context ctx, alg__Mat A, alg__Mat b, alg__Mat x) {
+  int m = num_rows(A), n = num_cols(A), q = min(m, n);
+  if (q == 0 || max(m, n) < chol_min_aspect * q) return false;
+  int is_tall = (m > n), num_threads = (ctx ? 1 : solver_num_threads());
+
+  float *g = scratch_alloc(ctx, (size_t)q * q * sizeof(float));
+  alg__MatStruct G = { .data = g, .nrows = q, .ncols = q, .ld = q };
+  gemm(ctx, is_tall, !is_tall, 1, A, A, 0, &G, num_threads);
+  if (!chol_factor(g, q)) {
+    scratch_free(ctx, g);
+    return false;
+  }
+
+  // Each step solves G z = A^T r or G z = r for the residual r, and adds z
+  // or A^T z to x.
+  float *r = scratch_alloc(ctx, m * sizeof(float));
+  float *z = scratch_alloc(ctx, q * sizeof(float));
+  alg__MatStruct R = { .data = r, .nrows = m, .ncols = 1, .ld = 1 };
+  alg__MatStruct Z = { .data = z, .nrows = q, .ncols = 1, .ld = 1 };
+  for (int j = 0; j < n; ++j) elt(x, j, 0) = 0;
+  for (int step = 0; step < normal_eq_steps; ++step) {
+    for (int i = 0; i < m; ++i) r[i] = elt(b, i, 0);
+    if (step > 0) gemm(ctx, false, false, -1, A, x, 1, &R, num_threads);
+    if (is_tall) {
+      gemm(ctx, true, false, 1, A, &R, 0, &Z, num_threads);
+    } else {
+      memcpy(z, r, m * sizeof(float));
+    }
+    chol_solve(g, q, z);
+    if (is_tall) {
+      for (int j = 0; j < n; ++j) elt(x, j, 0) += z[j];
+    } else {
+      gemm(ctx, true, false, 1, A, &Z, 1, x, num_threads);
+    }
+  }
+  scratch_free(ctx, z);
+  scratch_free(ctx, r);
+  scratch_free(ctx, g);
+  return true;
+}
+
+// Returns true if ||b - A x||_2 <= tol ||b||_2, which is the test the QR
+// solver applies to a tall A.
+static int is_l2_soln(alg__Context ctx, alg__Mat A, alg__Mat b, alg__Mat x) {
+  int m = num_rows(A);
+  float *r = scratch_alloc(ctx, max(m, 1) * sizeof(float));
+  alg__MatStruct R = { .data = r, .nrows = m, .ncols = 1, .ld = 1 };
+  for (int i = 0; i < m; ++i) r[i] = elt(b, i, 0);
+  float b_norm = sqrtf(vec_dot(m, r, 1, r, 1));
+  gemm(ctx, false, false, -1, A, x, 1, &R, ctx ? 1 : solver_num_threads());
+  int is_soln = (sqrtf(vec_dot(m, r, 1, r, 1)) <= tol * b_norm);
+  scratch_free(ctx, r);
+  return is_soln;
+}
+
+// The scratch bytes used by normal_eq_solve and is_l2_soln.
+static size_t normal_eq_bytes(int m, int n) {
+  int q = min(m, n);
+  if (q == 0 || max(m, n) < chol_min_aspect * q) return 0;
+  return scratch_bytes((size_t)q * q * sizeof(float)) + gemm_bytes(q, q, max(m, n)) +
+         2 * scratch_bytes(m * sizeof(float)) + scratch_bytes(q * sizeof(float));
+}
+
+static alg__Status l2_min(alg__Context ctx, alg__Mat A, alg__Mat b, alg__Mat x) {
+  if (x == NULL) {
+    alg__err_str = "The matrix x is expected to be pre-allocated.";
+    return alg__status_input_error;
+  }
+  if (num_rows(A) != num_rows(b)) {
+    alg__err_str = "A and b must have the same number of rows.";
+    return alg__status_input_error;
+  }
+  if (num_cols(A) != num_rows(x) || num_cols(x) != 1) {
+    alg__err_str = "x is expected to have size #cols(A) x 1.";
+    return alg__status_input_error;
+  }
+
+  // A tall A that fails the residual test goes on to QR, which tells an
+  // inconsistent b from roundoff in the normal equations.
+  if (normal_eq_solve(ctx, A, b, x) &&
+      (num_rows(A) < num_cols(A) || is_l2_soln(ctx, A, b, x))) {
+    return alg__status_ok;
+  }
+
+  alg__L2Factor F = l2_factor(ctx, A);
+  alg__Status status = alg__l2_solve(F, b, x);
+  l2_factor_free(F);
 
   return status;
 }
 
+// The scratch bytes used by l2_min.
+static size_t l2_min_bytes(int m, int n) {
+  return normal_eq_bytes(m, n) + l2_factor_bytes(m, n);
+}
+
 alg__Status alg__l2_min(alg__Mat A, alg__Mat b, alg__Mat x) {
+  return l2_min(NULL, A, b, x);
+}
+
+alg__Status alg__l2_lsq(alg__Mat A, alg__Mat b, alg__Mat x) {
   if (x == NULL) {
     alg__err_str = "The matrix x is expected to be pre-allocated.";
     return alg__status_input_error;
@@ -277,34 +5057,48 @@ alg__Status alg__l2_min(alg__Mat A, alg__Mat b, alg__Mat x) {
     alg__err_str = "x is expected to have size #cols(A) x 1.";
     return alg__status_input_error;
   }
+  int m = num_rows(A), n = num_cols(A);
+  if (m < n) {
+    alg__err_str = "A is expected to have at least as many rows as columns.";
+    return alg__status_input_error;
+  }
+  if (normal_eq_solve(NULL, A, b, x)) return alg__status_ok;
 
-  // We want to work with rows of A (and Q).
-  A->is_transposed = !A->is_transposed;
-  alg__Mat Q = alg__copy_matrix(A);
-  alg__QR(Q, NULL);
-
-  for (int i = 0; i < num_cols(A); ++i) {
-    float a_i_q_i = alg__dot_prod(A, i, Q, i);
-    float a_i_x   = alg__dot_prod(A, i, x, 0);
-    float diff    = col_elt(b, i) - a_i_x;
-    if (diff == 0) continue;  // Don't worry about a_i_q_i = 0 in this case.
-    if (a_i_q_i == 0) {
-      alg__err_str = "The solution set is empty.";
-      return alg__status_no_soln;
-    }
-    float alpha = diff / a_i_q_i;
-    alg__mul_and_add(alpha, Q, i, x, 0);
+  struct alg__L2FactorStruct F = { .m = m, .n = n };
+  if (!l2_factor_householder(&F, A)) {
+    alg__err_str = "A is expected to have full column rank.";
+    return alg__status_lin_dep;
   }
+  F.work = scratch_alloc(NULL, max(m, 1) * sizeof(float));
+  alg__Status status = l2_solve_householder(&F, b, x, true);
+  void *ptrs[] = { F.h, F.tau, F.work };
+  for (int i = 0; i < 3; ++i) scratch_free(NULL, ptrs[i]);
+  return status;
+}
 
-  // Clean up.
-  A->is_transposed = !A->is_transposed;
-  alg__free_matrix(Q);
+alg__Status alg__l2_solve_refined(alg__L2Factor F, alg__Mat A, alg__Mat B, alg__Mat X) {
+  if (num_rows(A) != F->m || num_cols(A) != F->n) {
+    alg__err_str = "A is expected to be the matrix that F factors.";
+    return alg__status_input_error;
+  }
+  alg__Status status = alg__l2_solve(F, B, X);
+  if (status != alg__status_ok) return status;
 
+  int     n    = F->n;
+  int    *cols = malloc((n > 0 ? n : 1) * sizeof(int));
+  double *x    = malloc((n > 0 ? n : 1) * sizeof(double));
+  for (int j = 0; j < n; ++j) cols[j] = j;
+  for (int c = 0; c < num_cols(B); ++c) {
+    for (int j = 0; j < n; ++j) x[j] = elt(X, j, c);
+    refine_solution(F, A, cols, n, B, c, x);
+    for (int j = 0; j < n; ++j) set_elt64(X, j, c, x[j]);
+  }
+  free(x);
+  free(cols);
   return alg__status_ok;
 }
 
-alg__Status alg__linf_min (alg__Mat A, alg__Mat b, alg__Mat x) {
-
+alg__Status alg__l2_min_refined(alg__Mat A, alg__Mat b, alg__Mat x) {
   if (x == NULL) {
     alg__err_str = "The matrix x is expected to be pre-allocated.";
     return alg__status_input_error;
@@ -318,67 +5112,106 @@ alg__Status alg__linf_min (alg__Mat A, alg__Mat b, alg__Mat x) {
     return alg__status_input_error;
   }
 
-  // We convert A -> A2 -> A3. The first conversion is only
-  // to convert unrestricted to restricted variables.
-  // That is, the user didn't say x >= 0 but LP uses that constraint,
-  // so we wrap our application of LP to meet the user's expectations.
-  alg__Mat A2 = convert_to_restricted_vars(A);
+  alg__L2Factor F = alg__l2_factor(A);
+  alg__Status status = alg__l2_solve_refined(F, A, b, x);
+  alg__free_l2_factor(F);
 
-  // Our approach is to add one slack variable s_i for each
-  // variable x_i in A2, and another variable t to measure ||x||_inf.
-  // The added inequalities correspond to x_i <= t, captured
-  // by the slack variables as s_i = t - x_i >= 0, and sent in
-  // as x_i + s_i - t = 0.
-  // This is captured in the augmented matrices A3 and b3:
-  //
-  //        <x> <s> <t>    b3:
-  //  A3 = ( A2  0   0 )  ( b )
-  //       ( I   I  -1 )  ( 0 )
-  //
-  // (There is no b2; I use the name b3 for consistency with A3.)
+  return status;
+}
 
-  // Set up the augmented parameter matrix A3.
-  int nr = num_rows(A2);
-  int nc = num_cols(A2);
-  alg__Mat A3 = alg__alloc_matrix(nr + nc, 2 * nc + 1);
-  memset(A3->data, 0, num_rows(A3) * num_cols(A3) * sizeof(float));
+// Returns ||v||_inf for a column vector v.
+static float max_abs_entry(alg__Mat v) {
+  float val = 0;
+  for (int i = 0; i < num_rows(v); ++i) val = fmaxf(val, fabsf(col_elt(v, i)));
+  return val;
+}
 
-  // Set A2 as a submatrix of A3.
-  for (int r = 0; r < nr; ++r) {
-    for (int c = 0; c < nc; ++c) {
-      elt(A3, r, c) = elt(A2, r, c);
+// Returns true if x solves Ax = b to within tol of the size of the terms
+// of Ax and b, using res for #rows(b) floats of scratch. Exactly one of A or
+// sp, which is in CSC form, is expected to be non-NULL.
+static int linf_is_soln(alg__Mat A, alg__SpMat sp, alg__Mat b, alg__Mat x, float *res) {
+  int   m     = num_rows(b);
+  float scale = 1;
+  for (int i = 0; i < m; ++i) res[i] = -col_elt(b, i), scale += fabsf(res[i]);
+  for (int j = 0; j < num_rows(x); ++j) {
+    float x_j = col_elt(x, j);
+    if (sp) {
+      sp_col_axpy(sp, j, x_j, res);
+      for (int t = sp->start[j]; t < sp->start[j + 1]; ++t) scale += fabsf(sp->vals[t] * x_j);
+    } else {
+      for (int i = 0; i < m; ++i) res[i] += elt(A, i, j) * x_j, scale += fabsf(elt(A, i, j) * x_j);
     }
   }
-  // Set up the two identity (I) submatrices of A3.
-  for (int r = 0; r < nc; ++r) {
-    elt(A3, r + nr, r +  0) = 1;
-    elt(A3, r + nr, r + nc) = 1;
+  float err = 0;
+  for (int i = 0; i < m; ++i) err += fabsf(res[i]);
+  return err <= tol * scale;
+}
+
+static alg__Status linf_min(alg__Context ctx, alg__Mat A, alg__Mat b, alg__Mat x,
+                            alg__LPOptions *opts) {
+
+  if (x == NULL) {
+    alg__err_str = "The matrix x is expected to be pre-allocated.";
+    return alg__status_input_error;
+  }
+  if (num_rows(A) != num_rows(b)) {
+    alg__err_str = "A and b must have the same number of rows.";
+    return alg__status_input_error;
   }
-  // Set up the -1 column of A3.
-  for (int r = nr; r < num_rows(A3); ++r) {
-    elt(A3, r, num_cols(A3) - 1) = -1;
+  if (num_cols(A) != num_rows(x) || num_cols(x) != 1) {
+    alg__err_str = "x is expected to have size #cols(A) x 1.";
+    return alg__status_input_error;
   }
 
-  // Set up b3, the augmented version of b.
-  alg__Mat b3 = alg__alloc_matrix(nr + nc, 1);
-  for (int r = 0; r < num_rows(b3); ++r) {
-    col_elt(b3, r) = (r < nr ? col_elt(b, r) : 0);
-  }
+  // With t = ||x||_inf, the scaled variables z = x / t and w = 1 / t satisfy
+  // A z - b w = 0 and -1 <= z_i <= 1, and minimizing t is maximizing w. So
+  // we solve an LP with only one more column than A, and set x = z / w:
+  //
+  //        <z> <w>
+  //  A2 = ( A  -b/t0 ),  b2 = 0,  c2 = (0 .. 0 -1).
+  //
+  // The bounds on z need no extra rows. Here t0 = ||x0||_inf for the least
+  // norm solution x0, which keeps the best w in [1, sqrt(n)]; otherwise w
+  // could fall below tol, and x = z / w would magnify its error. That w is
+  // then 1 / t for t = ||x||_inf / t0. If Ax = b has no solution, the
+  // largest w is 0, but x0 usually shows that first.
+  int nr = num_rows(A);
+  int n  = num_cols(A);
+  alg__Status status = l2_min(ctx, A, b, x);
+  if (status != alg__status_ok) return status;
+  float t0 = max_abs_entry(x);
+  if (t0 == 0) return alg__status_ok;
 
-  // Set up c3, the cost matrix. The cost is simply the value of t.
-  alg__Mat c3 = alg__alloc_matrix(num_cols(A3), 1);
-  memset(c3->data, 0, num_rows(c3) * sizeof(float));
-  col_elt(c3, num_rows(c3) - 1) = 1;
+  alg__Mat A2 = alloc_tmp_matrix(ctx, nr, n + 1);
+  for (int r = 0; r < nr; ++r) {
+    for (int c = 0; c < n; ++c) elt(A2, r, c) = elt(A, r, c);
+    elt(A2, r, n) = -col_elt(b, r) / t0;
+  }
+  alg__Mat b2 = alloc_tmp_matrix(ctx, nr, 1);
+  set_zero(b2);
+  alg__Mat c2 = alloc_tmp_matrix(ctx, n + 1, 1);
+  set_zero(c2);
+  col_elt(c2, n) = -1;
 
-  // Set up x3.
-  alg__Mat x3 = alg__alloc_matrix(num_cols(A3), 1);
+  alg__Mat lo2 = alloc_tmp_matrix(ctx, n + 1, 1);
+  alg__Mat hi2 = alloc_tmp_matrix(ctx, n + 1, 1);
+  for (int r = 0; r < n + 1; ++r) {
+    col_elt(lo2, r) = (r < n ? -1 : 0);
+    col_elt(hi2, r) = (r < n ?  1 : INFINITY);
+  }
+  alg__Mat x2 = alloc_tmp_matrix(ctx, n + 1, 1);
 
-  alg__Status status = alg__run_lp(A3, b3, x3, c3);
+  Bounds bounds = { .lo = lo2, .hi = hi2 };
+  status = run_lp_bounded(ctx, A2, b2, x2, c2, &bounds, opts);
   if (status != alg__status_ok) goto end_linf;
 
-  // Copy out the user-facing values from x3.
-  for (int r = 0; r < num_rows(x); ++r) {
-    col_elt(x, r) = col_elt(x3, 2 * r) - col_elt(x3, 2 * r + 1);
+  float w = col_elt(x2, n);
+  for (int r = 0; r < n; ++r) col_elt(x, r) = (w > 0 ? t0 * col_elt(x2, r) / w : 0);
+  // b2 is no longer needed, so it holds the residual.
+  if (w <= 0 || !linf_is_soln(A, NULL, b, x, b2->data)) {
+    alg__err_str = "There are no solutions x with Ax=b.";
+    status = alg__status_no_soln;
+    goto end_linf;
   }
 
   dbg_printf("x:\n");
@@ -386,16 +5219,58 @@ alg__Status alg__linf_min (alg__Mat A, alg__Mat b, alg__Mat x) {
 
 end_linf:
 
-  alg__free_matrix(x3);
-  alg__free_matrix(c3);
-  alg__free_matrix(b3);
-  alg__free_matrix(A3);
-  alg__free_matrix(A2);
+  free_tmp_matrix(ctx, x2);
+  free_tmp_matrix(ctx, hi2);
+  free_tmp_matrix(ctx, lo2);
+  free_tmp_matrix(ctx, c2);
+  free_tmp_matrix(ctx, b2);
+  free_tmp_matrix(ctx, A2);
 
   return status;
 }
 
-alg__Status alg__run_lp(alg__Mat A, alg__Mat b, alg__Mat x, alg__Mat c) {
+static size_t linf_min_bytes(int m, int n, alg__LPOptions *opts) {
+  return l2_min_bytes(m, n) + tmp_matrix_bytes(m, n + 1) + tmp_matrix_bytes(m, 1) + 4 * tmp_matrix_bytes(n + 1, 1) +
+         presolve_bytes(m, n + 1, opts) + run_lp_revised_bytes(m, n + 1, opts);
+}
+
+alg__Status alg__linf_min (alg__Mat A, alg__Mat b, alg__Mat x) {
+  return linf_min(NULL, A, b, x, NULL);
+}
+
+alg__Basis alg__alloc_basis() {
+  return calloc(1, sizeof(struct alg__BasisStruct));
+}
+
+void alg__free_basis(alg__Basis basis) {
+  if (basis == NULL) return;
+  free(basis->head);
+  free(basis->at_hi);
+  free(basis);
+}
+
+void alg__extend_basis(alg__Basis basis, int new_rows, int new_cols) {
+  if (basis == NULL || !basis->is_set || new_rows < 0 || new_cols < 0) return;
+  int m = basis->m + new_rows, n = basis->n + new_cols;
+
+  // The artificial variables are renumbered to follow the new columns, and
+  // those of the new rows join the basis.
+  basis->head = realloc(basis->head, (m > 0 ? m : 1) * sizeof(int));
+  for (int p = 0; p < basis->m; ++p) {
+    if (basis->head[p] >= basis->n) basis->head[p] += new_cols;
+  }
+  for (int p = basis->m; p < m; ++p) basis->head[p] = n + p;
+  basis->at_hi = realloc(basis->at_hi, n + 1);
+  memset(basis->at_hi + basis->n, 0, new_cols);
+  basis->m = m;
+  basis->n = n;
+}
+
+static alg__Status run_lp(alg__Context ctx, alg__Mat A, alg__Mat b, alg__Mat x,
+                          alg__Mat c, alg__LPOptions *opts) {
+
+  alg__LPOptions default_opts = {0};
+  if (opts == NULL) opts = &default_opts;
 
   dbg_printf("\n");
   dbg_printf("A is %dx%d, b is %dx%d, x is %dx%d, c is %dx%d\n",
@@ -404,38 +5279,41 @@ alg__Status alg__run_lp(alg__Mat A, alg__Mat b, alg__Mat x, alg__Mat c) {
              num_rows(x), num_cols(x),
              num_rows(c), num_cols(c));
 
-  // Check that the size of A matches b, x, and c.
-  if (num_rows(A) != num_rows(b) ||
-      num_cols(A) != num_rows(x) ||
-      num_cols(A) != num_rows(c)) {
-    alg__err_str = "The input sizes of A, b, x, c do not all match.";
-    return alg__status_input_error;
-  }
-  // Check that x, b, and c are single-column matrices.
-  if (num_cols(x) != 1 || num_cols(b) != 1 || num_cols(c) != 1) {
-    alg__err_str = "x, b, and c are all expected to be single-column matrices.";
-    return alg__status_input_error;
-  }
+  alg__Status status = check_lp_sizes(num_rows(A), num_cols(A), b, x, c);
+  if (status != alg__status_ok) return status;
 
   dbg_printf("A:\n"); dbg_print_matrix(A);
   dbg_printf("b:\n"); dbg_print_matrix(b);
   dbg_printf("x:\n"); dbg_print_matrix(x);
   dbg_printf("c:\n"); dbg_print_matrix(c);
 
+  if (opts->presolve) return run_lp_presolved(ctx, A, b, x, c, NULL, opts);
+  if (opts->algorithm == alg__lp_revised) return run_lp_revised(ctx, A, NULL, b, x, c, NULL, opts);
+  if (opts->algorithm == alg__lp_interior) return run_lp_interior(ctx, A, NULL, b, x, c, opts);
 
   // Phase 1.
-  alg__Mat tab1 = alg__alloc_matrix(num_rows(A) + 2, num_cols(A) + num_rows(A) + 3);
-  alg__Mat tab2 = alg__alloc_matrix(num_rows(A) + 1, num_cols(A) + 2);
+  // The columns of tab1 are the phase 1 objective, the artificial variables,
+  // the phase 2 objective, the columns of A, and b. The phase 2 tableau tab2
+  // is a view of the lower right part of tab1, so it needs no copy.
+  double   t     = now_seconds();
+  Phase    phase = phase1;
+  alg__Mat tab1  = alloc_tmp_matrix(ctx, num_rows(A) + 2, num_cols(A) + num_rows(A) + 3);
+  alg__MatStruct tab2_view = sub_view(tab1, 1, num_rows(A) + 1, num_rows(A) + 1, num_cols(A) + 2);
+  alg__Mat tab2 = &tab2_view;
+  if (tableau_warm_start(ctx, tab2, A, b, c, opts->basis, tableau_num_threads(ctx, opts))) {
+    goto start_phase2;
+  }
+
   // Set up the artificial variable cost row = the top row in tab1.
   for (int col = 0; col < num_cols(tab1); ++col) {
     float val = (col == 0 ? 1 : 0);
     // The artifical variables each have cost 1, the negative of which is in the top row.
-    if (2 <= col && col <= num_rows(A) + 1) val = -1;
+    if (1 <= col && col <= num_rows(A)) val = -1;
     elt(tab1, 0, col) = val;
   }
   // Set up the cost row to be used in phase 2 = the second row in tab1.
   for (int col = 0; col < num_cols(tab1); ++col) {
-    float val = (col == 1 ? 1 : 0);
+    float val = (col == num_rows(A) + 1 ? 1 : 0);
     int c_idx = col - (num_rows(A) + 2);
     if (0 <= c_idx && c_idx < num_rows(c)) {
       val = -col_elt(c, c_idx);
@@ -449,7 +5327,7 @@ alg__Status alg__run_lp(alg__Mat A, alg__Mat b, alg__Mat x, alg__Mat c) {
       if (col == num_cols(tab1) - 1) {
         val = col_elt(b, row - 2);
       }
-      int artif_col_idx = col - 2;
+      int artif_col_idx = col - 1;
       if (artif_col_idx >= 0 && artif_col_idx < num_rows(A)) {
         int artif_row_idx = row - 2;
         val = (artif_col_idx == artif_row_idx ? 1 : 0);
@@ -469,67 +5347,693 @@ alg__Status alg__run_lp(alg__Mat A, alg__Mat b, alg__Mat x, alg__Mat c) {
   dbg_printf("tableau for phase 1:\n");
   dbg_print_matrix(tab1);
 
-  alg__Status status = apply_lp(tab1, phase1);
+  status = apply_lp(ctx, tab1, phase1, NULL, opts);
   if (status != alg__status_ok) goto end_lp;  // It may be an unbounded solution set.
 
   dbg_printf("After phase 1, tableau is:\n");
   dbg_print_matrix(tab1);
 
   // Check if an initial feasible solution was found.
-  if (fabs(elt(tab1, 0, num_cols(tab1) - 1)) > tol) {
+  if (fabs(elt(tab1, 0, num_cols(tab1) - 1)) > phase1_tol(b)) {
     alg__err_str = "There are no solutions x with Ax=b and x>=0.";
-    return alg__status_no_soln;
+    status = alg__status_no_soln;
+    goto end_lp;
   }
 
-  // Phase 2.
-  // Copy over the submatrix of tab1 that we will continue working with.
-  for (int row = 0; row < num_rows(tab2); ++row) {
-    for (int col = 0; col < num_cols(tab2); ++col) {
-      // The src_col is either the 2nd col of tab1 or
-      // the columns after the artificial variables.
-      int src_col = (col == 0 ? 1 : col + 1 + num_rows(A));
-      elt(tab2, row, col) = elt(tab1, row + 1, src_col);
+  // Pivot any artificial variables left in the basis (at a zero level) out
+  // of it, since phase 2 drops their columns. A row where this is impossible
+  // is all zeros outside the artificial columns, and is redundant.
+  int *basic_col = scratch_alloc(ctx, num_rows(tab1) * sizeof(int));
+  find_basic_cols(tab1, 2, basic_col);
+  for (int row = 2; row < num_rows(tab1); ++row) {
+    if (basic_col[row] < 1 || basic_col[row] > num_rows(A)) continue;
+    int   pivot_col = -1;
+    float big       = tol;
+    for (int col = num_rows(A) + 2; col < num_cols(tab1) - 1; ++col) {
+      if (fabs(elt(tab1, row, col)) > big) {
+        pivot_col = col;
+        big       = fabs(elt(tab1, row, col));
+      }
     }
+    if (pivot_col == -1) continue;
+    make_col_a_01_col(tab1, row, pivot_col, tableau_num_threads(ctx, opts));
+    stats_pivot(opts, phase1, tableau_var(tab1, phase1, pivot_col),
+                tableau_var(tab1, phase1, basic_col[row]), true, elt(tab1, 0, num_cols(tab1) - 1));
   }
+  scratch_free(ctx, basic_col);
+
+  // Phase 2 works on the view tab2, which drops the phase 1 objective and
+  // the artificial columns.
 
+start_phase2:
+  stats_add_time(opts, phase, &t);
+  phase = phase2;
   dbg_printf("phase 2 tableau is starting as:\n");
   dbg_print_matrix(tab2);
 
-  status = apply_lp(tab2, phase2);
+  status = apply_lp(ctx, tab2, phase2, c, opts);
   if (status != alg__status_ok) goto end_lp;  // It may be an unbounded solution set.
 
   dbg_printf("After phase 2, tableau is:\n");
   dbg_print_matrix(tab2);
 
-  // Copy the result out to x and clean up.
-  memset(x->data, 0, num_rows(x) * sizeof(float));
-  for (int c = 0; c < num_cols(x); ++c) col_elt(x, c) = 0;
+  // Copy the result out to x and clean up. Each row's basic variable, whose
+  // column is a 01 column, gets the value in that row's last column. Only
+  // one such column per row is used, since A may have duplicate columns.
+  set_zero(x);
   int last_col = num_cols(tab2) - 1;
-  for (int c = 1; c < last_col; ++c) {
-    // Check to see if c is a 01 column; if yes, it gives us a value in x.
-    int set_row = -1;
-    for (int r = 0; r < num_rows(tab2); ++r) {
-      float val = elt(tab2, r, c);
-      if (val == 0) continue;
-      if (set_row != -1 || val != 1) {
-        // This means it's not a 01 column.
-        set_row = -2;
-        break;
-      }
-      set_row = r;  // This is the first val=1 we've seen in the column.
-    }
-    if (set_row > 0) {
-      col_elt(x, c - 1) = elt(tab2, set_row, last_col);
-    }
+  basic_col = scratch_alloc(ctx, num_rows(tab2) * sizeof(int));
+  find_basic_cols(tab2, 1, basic_col);
+  for (int r = 1; r < num_rows(tab2); ++r) {
+    if (basic_col[r] != -1) col_elt(x, basic_col[r] - 1) = elt(tab2, r, last_col);
+  }
+  // Rows without a basic column are redundant, with a basic artificial variable.
+  for (int r = 1; r < num_rows(tab2); ++r) {
+    basic_col[r - 1] = (basic_col[r] == -1 ? num_cols(A) + r - 1 : basic_col[r] - 1);
   }
+  if (opts->refine) refine_lp_solution(ctx, A, b, x, basic_col);
+  basis_store(opts->basis, num_rows(A), num_cols(A), basic_col);
+  scratch_free(ctx, basic_col);
 
   dbg_printf("x:\n");
   dbg_print_matrix(x);
 
 end_lp:
-  alg__free_matrix(tab2);
-  alg__free_matrix(tab1);
+  stats_add_time(opts, phase, &t);
+  free_tmp_matrix(ctx, tab1);
+
+  return status;
+}
+
+// The scratch bytes used by run_lp with a context for an m x n matrix A.
+static size_t run_lp_bytes(int m, int n, alg__LPOptions *opts) {
+  size_t bytes = presolve_bytes(m, n, opts);
+  if (opts->algorithm == alg__lp_revised)  return bytes + run_lp_revised_bytes(m, n, opts);
+  if (opts->algorithm == alg__lp_interior) return bytes + run_lp_interior_bytes(m, n, opts);
+  bytes += tmp_matrix_bytes(m + 2, n + m + 3) +
+                 apply_lp_bytes(m + 2, n + m + 3, opts) + scratch_bytes((m + 2) * sizeof(int)) +
+                 apply_lp_bytes(m + 1, n + 2, opts) + scratch_bytes((m + 1) * sizeof(int));
+  if (opts->basis) bytes += scratch_bytes(n + m) + scratch_bytes(m + 1);
+  if (opts->refine) bytes += refine_lp_bytes(m, n);
+  return bytes;
+}
+
+alg__Status alg__run_lp(alg__Mat A, alg__Mat b, alg__Mat x, alg__Mat c) {
+  return run_lp(NULL, A, b, x, c, NULL);
+}
+
+alg__Status alg__run_lp_opts(alg__Mat A, alg__Mat b, alg__Mat x, alg__Mat c,
+                             alg__LPOptions *opts) {
+  stats_begin(opts);
+  return stats_end(NULL, opts, alg__problem_lp, x, c, run_lp(NULL, A, b, x, c, opts));
+}
+
+static alg__Status check_lp_bounded_sizes(alg__Mat A, alg__Mat b, alg__Mat x, alg__Mat c,
+                                          Bounds *bounds) {
+  alg__Status status = check_lp_sizes(num_rows(A), num_cols(A), b, x, c);
+  if (status != alg__status_ok) return status;
+  alg__Mat lims[] = { bounds->lo, bounds->hi };
+  for (int i = 0; i < 2; ++i) {
+    if (lims[i] && (num_rows(lims[i]) != num_cols(A) || num_cols(lims[i]) != 1)) {
+      alg__err_str = "lo and hi are expected to have size #cols(A) x 1.";
+      return alg__status_input_error;
+    }
+  }
+  return alg__status_ok;
+}
+
+// Bounded variables need the revised simplex method, so opts->algorithm is
+// ignored here.
+static alg__Status run_lp_bounded(alg__Context ctx, alg__Mat A, alg__Mat b, alg__Mat x,
+                                  alg__Mat c, Bounds *bounds, alg__LPOptions *opts) {
+  alg__LPOptions default_opts = {0};
+  if (opts == NULL) opts = &default_opts;
+
+  alg__Status status = check_lp_bounded_sizes(A, b, x, c, bounds);
+  if (status != alg__status_ok) return status;
+  if (opts->presolve) return run_lp_presolved(ctx, A, b, x, c, bounds, opts);
+  return run_lp_revised(ctx, A, NULL, b, x, c, bounds, opts);
+}
+
+alg__Status alg__run_lp_bounded(alg__Mat A, alg__Mat b, alg__Mat x, alg__Mat c,
+                                alg__Mat lo, alg__Mat hi, alg__LPOptions *opts) {
+  Bounds bounds = { .lo = lo, .hi = hi };
+  stats_begin(opts);
+  return stats_end(NULL, opts, alg__problem_lp, x, c,
+                   run_lp_bounded(NULL, A, b, x, c, &bounds, opts));
+}
+
+struct alg__LPSolverStruct {
+  Simplex        S;
+  int            has_simplex;    // Set once S is allocated.
+  alg__Mat       b, x, c;
+  alg__LPOptions opts;
+  alg__Status    status;         // alg__status_in_progress until the solve ends.
+  const char    *err_str;        // The error of status, if any.
+  size_t         scratch_want;   // The heap_scratch_want of this solve.
+};
+
+alg__LPSolver alg__start_lp(alg__Mat A, alg__Mat b, alg__Mat x, alg__Mat c,
+                            alg__Mat lo, alg__Mat hi, alg__LPOptions *opts) {
+  alg__LPSolver solver = malloc(sizeof(struct alg__LPSolverStruct));
+  *solver = (struct alg__LPSolverStruct) { .b = b, .x = x, .c = c };
+  if (opts) solver->opts = *opts;
+  stats_begin(&solver->opts);
+
+  Bounds bounds = { .lo = lo, .hi = hi };
+  solver->status = check_lp_bounded_sizes(A, b, x, c, &bounds);
+  if (solver->status == alg__status_ok) {
+    simplex_init(NULL, &solver->S, A, NULL, b, &bounds, &solver->opts);
+    solver->has_simplex = true;
+    solver->status      = simplex_start(&solver->S, c, solver->opts.basis);
+  }
+  solver->scratch_want = heap_scratch_want;
+  if (solver->status != alg__status_in_progress) {
+    solver->err_str = alg__err_str;
+    stats_end(NULL, &solver->opts, alg__problem_lp, x, c, solver->status);
+  }
+  return solver;
+}
+
+alg__Status alg__step_lp(alg__LPSolver solver, int max_pivots, double max_seconds) {
+  if (solver->status != alg__status_in_progress) {
+    alg__err_str = solver->err_str;
+    return solver->status;
+  }
+  // Several solves may take turns on this thread, so each keeps its own
+  // count of heap scratch.
+  heap_scratch_want = solver->scratch_want;
+  Simplex *S     = &solver->S;
+  S->step_pivots = 0;
+  S->max_pivots  = max(max_pivots, 0);
+  S->deadline    = (max_seconds > 0 ? now_seconds() + max_seconds : INFINITY);
+  alg__Status status = simplex_continue(S, solver->c);
+  if (status == alg__status_in_progress) {
+    alg__err_str = "The solve is still in progress.";
+  } else {
+    if (status == alg__status_ok) simplex_finish(S, solver->b, solver->x, &solver->opts);
+    stats_end(NULL, &solver->opts, alg__problem_lp, solver->x, solver->c, status);
+    solver->status  = status;
+    solver->err_str = alg__err_str;
+  }
+  solver->scratch_want = heap_scratch_want;
+  return status;
+}
+
+void alg__free_lp_solver(alg__LPSolver solver) {
+  if (solver == NULL) return;
+  if (solver->has_simplex) simplex_free(&solver->S);
+  free(solver);
+}
+
+
+// 5. Contexts and batches.
+
+alg__Context alg__alloc_context() {
+  return calloc(1, sizeof(alg__ContextStruct));
+}
+
+void alg__free_context(alg__Context ctx) {
+  if (ctx == NULL) return;
+  if (!ctx->scratch_is_borrowed) free(ctx->scratch);
+  free(ctx);
+}
+
+void alg__set_scratch(alg__Context ctx, void *mem, size_t size) {
+  if (!ctx->scratch_is_borrowed) free(ctx->scratch);
+  // scratch_alloc hands out multiples of 16 bytes from the base, so start the
+  // block at the first 16-byte aligned address in mem.
+  size_t slack = (16 - (uintptr_t)mem % 16) % 16;
+  if (slack > size) slack = size;
+  ctx->scratch             = (char *)mem + slack;
+  ctx->scratch_size        = size - slack;
+  ctx->scratch_is_borrowed = true;
+}
+
+void alg__reserve_scratch(alg__Context ctx, size_t size) {
+  if (size <= ctx->scratch_size) return;
+  if (!ctx->scratch_is_borrowed) free(ctx->scratch);
+  ctx->scratch             = malloc(size);
+  ctx->scratch_size        = size;
+  ctx->scratch_is_borrowed = false;
+}
+
+size_t alg__scratch_bytes(alg__ProblemType type, int m, int n, alg__LPOptions *opts) {
+  alg__LPOptions default_opts = {0};
+  if (opts == NULL) opts = &default_opts;
+  switch (type) {
+    case alg__problem_lp:   return run_lp_bytes(m, n, opts);
+    case alg__problem_l1:   return l1_min_bytes(m, n, opts);
+    case alg__problem_l2:   return l2_min_bytes(m, n);
+    case alg__problem_linf: return linf_min_bytes(m, n, opts);
+  }
+  return 0;
+}
+
+size_t alg__QR_scratch_bytes(int m, int n) {
+  return qr_bytes(m, n);
+}
+
+alg__Status alg__QR_ctx(alg__Context ctx, alg__Mat A_to_Q, alg__Mat R) {
+  ctx_begin(ctx);
+  return ctx_end(ctx, qr(ctx, A_to_Q, R, NULL));
+}
+
+alg__Status alg__l1_min_ctx(alg__Context ctx, alg__Mat A, alg__Mat b, alg__Mat x) {
+  ctx_begin(ctx);
+  stats_begin(&ctx->lp_opts);
+  alg__Status status = l1_min(ctx, A, b, x, &ctx->lp_opts);
+  return ctx_end(ctx, stats_end(ctx, &ctx->lp_opts, alg__problem_l1, x, NULL, status));
+}
+
+alg__Status alg__l2_min_ctx(alg__Context ctx, alg__Mat A, alg__Mat b, alg__Mat x) {
+  ctx_begin(ctx);
+  return ctx_end(ctx, l2_min(ctx, A, b, x));
+}
+
+alg__Status alg__linf_min_ctx(alg__Context ctx, alg__Mat A, alg__Mat b, alg__Mat x) {
+  ctx_begin(ctx);
+  stats_begin(&ctx->lp_opts);
+  alg__Status status = linf_min(ctx, A, b, x, &ctx->lp_opts);
+  return ctx_end(ctx, stats_end(ctx, &ctx->lp_opts, alg__problem_linf, x, NULL, status));
+}
+
+alg__Status alg__run_lp_ctx(alg__Context ctx, alg__Mat A, alg__Mat b, alg__Mat x,
+                            alg__Mat c) {
+  ctx_begin(ctx);
+  stats_begin(&ctx->lp_opts);
+  alg__Status status = run_lp(ctx, A, b, x, c, &ctx->lp_opts);
+  return ctx_end(ctx, stats_end(ctx, &ctx->lp_opts, alg__problem_lp, x, c, status));
+}
+
+// The shared state of the threads in alg__solve_batch. Each thread claims
+// the next unsolved problem until none are left.
+typedef struct {
+  alg__Problem   *problems;
+  int             num_problems;
+  int             next;  // The next unclaimed problem; guarded by lock.
+  pthread_mutex_t lock;
+  alg__LPOptions  opts;
+} Batch;
+
+static void *batch_worker(void *arg) {
+  Batch *batch = arg;
+  int was_batch_thread = is_batch_thread;  // The calling thread is a worker too.
+  is_batch_thread = true;
+  alg__Context ctx = alg__alloc_context();
+  ctx->lp_opts = batch->opts;
+  while (true) {
+    pthread_mutex_lock(&batch->lock);
+    int i = batch->next++;
+    pthread_mutex_unlock(&batch->lock);
+    if (i >= batch->num_problems) break;
+
+    alg__Problem *p = batch->problems + i;
+    switch (p->type) {
+      case alg__problem_lp:   p->status = alg__run_lp_ctx  (ctx, p->A, p->b, p->x, p->c); break;
+      case alg__problem_l1:   p->status = alg__l1_min_ctx  (ctx, p->A, p->b, p->x);       break;
+      case alg__problem_l2:   p->status = alg__l2_min_ctx  (ctx, p->A, p->b, p->x);       break;
+      case alg__problem_linf: p->status = alg__linf_min_ctx(ctx, p->A, p->b, p->x);       break;
+      default:
+        ctx->err_str = "Unknown problem type.";
+        p->status    = alg__status_input_error;
+    }
+    p->err_str = ctx->err_str;
+  }
+  alg__free_context(ctx);
+  is_batch_thread = was_batch_thread;
+  return NULL;
+}
+
+alg__Status alg__solve_batch(alg__Problem *problems, int num_problems, int num_threads,
+                             alg__LPOptions *opts) {
+  if (num_threads <= 0) num_threads = default_num_threads();
+  if (num_threads > num_problems) num_threads = num_problems;
+  if (num_threads < 1) num_threads = 1;
+
+  Batch batch = { .problems = problems, .num_problems = num_problems, .next = 0 };
+  if (opts) batch.opts = *opts;
+  batch.opts.basis = NULL;  // A basis and stats can't be shared between threads.
+  batch.opts.stats = NULL;
+  pthread_mutex_init(&batch.lock, NULL);
+
+  // This thread is one of the workers.
+  pthread_t *threads = malloc(num_threads * sizeof(pthread_t));
+  int num_started = 0;
+  for (int t = 1; t < num_threads; ++t) {
+    if (pthread_create(&threads[num_started], NULL, batch_worker, &batch) == 0) num_started++;
+  }
+  batch_worker(&batch);
+  for (int t = 0; t < num_started; ++t) pthread_join(threads[t], NULL);
+  free(threads);
+  pthread_mutex_destroy(&batch.lock);
+
+  for (int i = 0; i < num_problems; ++i) {
+    if (problems[i].status != alg__status_ok) {
+      alg__err_str = problems[i].err_str;
+      return problems[i].status;
+    }
+  }
+  return alg__status_ok;
+}
+
+
+// 6. Sparse matrices.
+
+alg__SpMat alg__alloc_sparse(int nrows, int ncols, int nnz,
+                             int *rows, int *cols, float *vals, int is_csr) {
+  for (int t = 0; t < nnz; ++t) {
+    if (rows[t] < 0 || rows[t] >= nrows || cols[t] < 0 || cols[t] >= ncols) {
+      alg__err_str = "A sparse matrix entry is out of range.";
+      return NULL;
+    }
+  }
+
+  // Store the triplets in the opposite order first; switching formats then
+  // sorts the minor indices for us.
+  alg__SpMat T = sp_alloc(nrows, ncols, nnz, !is_csr);
+  int *minor = (is_csr ? cols : rows);
+  int *major = (is_csr ? rows : cols);
+  int nminor = (is_csr ? ncols : nrows);
+  for (int t = 0; t < nnz; ++t) T->start[minor[t] + 1]++;
+  for (int i = 0; i < nminor; ++i) T->start[i + 1] += T->start[i];
+  int *next = malloc(nminor * sizeof(int));
+  memcpy(next, T->start, nminor * sizeof(int));
+  for (int t = 0; t < nnz; ++t) {
+    int u = next[minor[t]]++;
+    T->idx[u]  = major[t];
+    T->vals[u] = vals[t];
+  }
+  free(next);
+  alg__SpMat A = sp_switch_format(T);
+  alg__free_sparse(T);
+
+  // Sum duplicate entries in place.
+  int nmajor = (is_csr ? nrows : ncols);
+  int u = 0, t = 0;
+  for (int j = 0; j < nmajor; ++j) {
+    int end = A->start[j + 1];
+    A->start[j] = u;
+    for (; t < end; ++t) {
+      if (u > A->start[j] && A->idx[u - 1] == A->idx[t]) {
+        A->vals[u - 1] += A->vals[t];
+      } else {
+        A->idx[u]  = A->idx[t];
+        A->vals[u] = A->vals[t];
+        u++;
+      }
+    }
+  }
+  A->start[nmajor] = A->nnz = u;
+  return A;
+}
+
+alg__SpMat alg__sparse_from_matrix(alg__Mat M, int is_csr) {
+  int nmajor = (is_csr ? num_rows(M) : num_cols(M));
+  int nminor = (is_csr ? num_cols(M) : num_rows(M));
+  int nnz = 0;
+  for (int r = 0; r < num_rows(M); ++r) {
+    for (int c = 0; c < num_cols(M); ++c) nnz += (elt(M, r, c) != 0);
+  }
+  alg__SpMat A = sp_alloc(num_rows(M), num_cols(M), nnz, is_csr);
+  int t = 0;
+  for (int j = 0; j < nmajor; ++j) {
+    for (int i = 0; i < nminor; ++i) {
+      float val = (is_csr ? elt(M, j, i) : elt(M, i, j));
+      if (val == 0) continue;
+      A->idx[t]    = i;
+      A->vals[t++] = val;
+    }
+    A->start[j + 1] = t;
+  }
+  return A;
+}
+
+void alg__free_sparse(alg__SpMat A) {
+  if (A->map) {
+    munmap(A->map, A->map_size);
+  } else {
+    free(A->vals);
+    free(A->idx);
+    free(A->start);
+  }
+  free(A);
+}
+
+alg__Status alg__save_sparse(alg__SpMat A, const char *path) {
+  int nmajor = (A->is_csr ? A->nrows : A->ncols);
+  FileHeader h = { .kind  = file_sparse, .flags = (A->is_csr ? file_csr : 0),
+                   .nrows = A->nrows, .ncols = A->ncols, .nnz = A->nnz };
+  FileArray arrays[] = { { A->start, sizeof(int),   1, nmajor + 1, 0 },
+                         { A->idx,   sizeof(int),   1, A->nnz,     0 },
+                         { A->vals,  sizeof(float), 1, A->nnz,     0 } };
+  return file_save(path, &h, arrays, 3);
+}
+
+// Only the ends of start are checked, so that a mapped matrix is not read
+// in full until it's used; the rest is trusted to be as alg__save_sparse
+// wrote it.
+alg__SpMat alg__map_sparse(const char *path) {
+  size_t map_size;
+  FileHeader *h = file_map(path, file_sparse, &map_size);
+  if (h == NULL) return NULL;
+  int      is_csr = (h->flags & file_csr) != 0;
+  int64_t  nmajor = (is_csr ? h->nrows : h->ncols), nnz = h->nnz;
+  int     *start  = file_array(h, map_size, 0, (uint64_t)(nmajor + 1) * sizeof(int));
+  int     *idx    = file_array(h, map_size, 1, (uint64_t)nnz * sizeof(int));
+  float   *vals   = file_array(h, map_size, 2, (uint64_t)nnz * sizeof(float));
+  if (nnz > INT_MAX || start == NULL || idx == NULL || vals == NULL ||
+      start[0] != 0 || start[nmajor] != nnz) {
+    munmap(h, map_size);
+    alg__err_str = "The file is truncated or corrupt.";
+    return NULL;
+  }
+  alg__SpMat A = malloc(sizeof(alg__SpMatStruct));
+  *A = (alg__SpMatStruct) {
+         .vals     = vals,
+         .idx      = idx,
+         .start    = start,
+         .nrows    = h->nrows,
+         .ncols    = h->ncols,
+         .nnz      = nnz,
+         .is_csr   = is_csr,
+         .map      = h,
+         .map_size = map_size };
+  return A;
+}
+
+float alg__sp_dot_prod(alg__SpMat A, int i, alg__Mat B, int j) {
+  if (A->nrows != num_rows(B)) {
+    alg__err_str = "Expected A, B to have the same #rows.";
+    return 0.0 / 0.0;  // If NaN is supported, it is returned here.
+  }
+  float sum = 0;
+  if (A->is_csr) {
+    for (int k = 0; k < A->nrows; ++k) {
+      float *val = sp_find(A, k, i);
+      if (val) sum += *val * elt(B, k, j);
+    }
+  } else {
+    for (int t = A->start[i]; t < A->start[i + 1]; ++t) {
+      sum += A->vals[t] * elt(B, A->idx[t], j);
+    }
+  }
+  return sum;
+}
+
+void alg__sp_mul_and_add(float c, alg__SpMat A, int i, alg__Mat B, int j) {
+  if (A->is_csr) {
+    for (int k = 0; k < A->nrows; ++k) {
+      float *val = sp_find(A, k, i);
+      if (val) elt(B, k, j) += c * *val;
+    }
+  } else {
+    for (int t = A->start[i]; t < A->start[i + 1]; ++t) {
+      elt(B, A->idx[t], j) += c * A->vals[t];
+    }
+  }
+}
+
+alg__Status alg__sp_l1_min(alg__SpMat A, alg__Mat b, alg__Mat x) {
+  if (x == NULL) {
+    alg__err_str = "The matrix x is expected to be pre-allocated.";
+    return alg__status_input_error;
+  }
+  alg__Mat c = alg__alloc_matrix(A->ncols, 1);
+  for (int r = 0; r < A->ncols; ++r) col_elt(c, r) = 1;
+  alg__Status status = check_lp_sizes(A->nrows, A->ncols, b, x, c);
+  if (status == alg__status_ok) {
+    // As in alg__l1_min, the simplex method handles the cost sum_i |x_i|
+    // directly.
+    alg__SpMat     csc     = (A->is_csr ? sp_switch_format(A) : A);
+    alg__LPOptions opts    = {0};
+    Bounds         bounds  = { .abs_cost = true };
+    status = run_lp_revised(NULL, NULL, csc, b, x, c, &bounds, &opts);
+    if (csc != A) alg__free_sparse(csc);
+  }
+  alg__free_matrix(c);
+
+  return status;
+}
+
+alg__Status alg__sp_l2_min(alg__SpMat A, alg__Mat b, alg__Mat x) {
+  if (x == NULL) {
+    alg__err_str = "The matrix x is expected to be pre-allocated.";
+    return alg__status_input_error;
+  }
+  if (A->nrows != num_rows(b)) {
+    alg__err_str = "A and b must have the same number of rows.";
+    return alg__status_input_error;
+  }
+  if (A->ncols != num_rows(x) || num_cols(x) != 1) {
+    alg__err_str = "x is expected to have size #cols(A) x 1.";
+    return alg__status_input_error;
+  }
+
+  // We run conjugate gradients on A A^T y = b, tracking x = A^T y instead
+  // of y itself; this is Craig's method. Vectors are kept in double.
+  int m = A->nrows, n = A->ncols;
+  double *xd = calloc(n, sizeof(double));
+  double *p   = malloc(n * sizeof(double));
+  double *ATr = malloc(n * sizeof(double));
+  double *r   = malloc(m * sizeof(double));
+  double *Ap  = malloc(m * sizeof(double));
+  for (int i = 0; i < m; ++i) r[i] = col_elt(b, i);
+
+  double b_norm = sqrt(vec_dot_d(r, r, m));
+  double rr     = b_norm * b_norm;
+  double a_max  = 0;
+  for (int t = 0; t < A->nnz; ++t) a_max = fmax(a_max, fabs(A->vals[t]));
+  sp_matvec(A, r, p, true);
+  for (int iter = 0; iter < 2 * m + 10 && sqrt(rr) > 1e-6 * b_norm; ++iter) {
+    double pp = vec_dot_d(p, p, n);
+    // A tiny p means that r is (nearly) orthogonal to the column span of A;
+    // this happens when Ax=b has no solutions.
+    if (pp <= 1e-12 * a_max * a_max * rr) break;
+    double alpha = rr / pp;
+    for (int j = 0; j < n; ++j) xd[j] += alpha * p[j];
+    sp_matvec(A, p, Ap, false);
+    for (int i = 0; i < m; ++i) r[i] -= alpha * Ap[i];
+    double rr_new = vec_dot_d(r, r, m);
+    double beta   = rr_new / rr;
+    rr = rr_new;
+    sp_matvec(A, r, ATr, true);
+    for (int j = 0; j < n; ++j) p[j] = ATr[j] + beta * p[j];
+  }
+
+  alg__Status status = alg__status_ok;
+  if (sqrt(rr) > tol * (1 + b_norm)) {
+    alg__err_str = "The solution set is empty.";
+    status = alg__status_no_soln;
+  } else {
+    for (int j = 0; j < n; ++j) col_elt(x, j) = xd[j];
+  }
+
+  free(Ap);
+  free(r);
+  free(ATr);
+  free(p);
+  free(xd);
+
+  return status;
+}
+
+alg__Status alg__sp_linf_min(alg__SpMat A, alg__Mat b, alg__Mat x) {
+  if (x == NULL) {
+    alg__err_str = "The matrix x is expected to be pre-allocated.";
+    return alg__status_input_error;
+  }
+  if (A->nrows != num_rows(b)) {
+    alg__err_str = "A and b must have the same number of rows.";
+    return alg__status_input_error;
+  }
+  if (A->ncols != num_rows(x) || num_cols(x) != 1) {
+    alg__err_str = "x is expected to have size #cols(A) x 1.";
+    return alg__status_input_error;
+  }
+  alg__SpMat csc = (A->is_csr ? sp_switch_format(A) : A);
+
+  // This solves the same scaled LP as alg__linf_min, with A2 = [A, -b/t0]
+  // built directly in CSC form.
+  int nr = A->nrows;
+  int n  = A->ncols;
+  alg__Status status = alg__sp_l2_min(csc, b, x);
+  float t0 = max_abs_entry(x);
+  if (status != alg__status_ok || t0 == 0) {
+    if (csc != A) alg__free_sparse(csc);
+    return status;
+  }
+
+  int b_nnz = 0;
+  for (int r = 0; r < nr; ++r) b_nnz += (col_elt(b, r) != 0);
+  alg__SpMat A2 = sp_alloc(nr, n + 1, csc->nnz + b_nnz, false);
+  memcpy(A2->vals,  csc->vals,  csc->nnz * sizeof(float));
+  memcpy(A2->idx,   csc->idx,   csc->nnz * sizeof(int));
+  memcpy(A2->start, csc->start, (n + 1) * sizeof(int));
+  int t2 = csc->nnz;
+  for (int r = 0; r < nr; ++r) {
+    if (col_elt(b, r) == 0) continue;
+    A2->idx[t2]    = r;
+    A2->vals[t2++] = -col_elt(b, r) / t0;
+  }
+  A2->start[n + 1] = t2;
+
+  alg__Mat b2  = alg__alloc_matrix(nr, 1);
+  alg__Mat c2  = alg__alloc_matrix(n + 1, 1);
+  alg__Mat lo2 = alg__alloc_matrix(n + 1, 1);
+  alg__Mat hi2 = alg__alloc_matrix(n + 1, 1);
+  alg__Mat x2  = alg__alloc_matrix(n + 1, 1);
+  set_zero(b2);
+  set_zero(c2);
+  col_elt(c2, n) = -1;
+  for (int r = 0; r < n + 1; ++r) {
+    col_elt(lo2, r) = (r < n ? -1 : 0);
+    col_elt(hi2, r) = (r < n ?  1 : INFINITY);
+  }
+
+  alg__LPOptions opts   = {0};
+  Bounds         bounds = { .lo = lo2, .hi = hi2 };
+  status = run_lp_revised(NULL, NULL, A2, b2, x2, c2, &bounds, &opts);
+  if (status == alg__status_ok) {
+    float w = col_elt(x2, n);
+    for (int r = 0; r < n; ++r) col_elt(x, r) = (w > 0 ? t0 * col_elt(x2, r) / w : 0);
+    if (w <= 0 || !linf_is_soln(NULL, csc, b, x, b2->data)) {
+      alg__err_str = "There are no solutions x with Ax=b.";
+      status = alg__status_no_soln;
+    }
+  }
+
+  alg__free_matrix(x2);
+  alg__free_matrix(hi2);
+  alg__free_matrix(lo2);
+  alg__free_matrix(c2);
+  alg__free_matrix(b2);
+  alg__free_sparse(A2);
+  if (csc != A) alg__free_sparse(csc);
 
   return status;
 }
 
+alg__Status alg__sp_run_lp(alg__SpMat A, alg__Mat b, alg__Mat x, alg__Mat c) {
+  return alg__sp_run_lp_opts(A, b, x, c, NULL);
+}
+
+alg__Status alg__sp_run_lp_opts(alg__SpMat A, alg__Mat b, alg__Mat x, alg__Mat c,
+                                alg__LPOptions *opts) {
+  alg__LPOptions default_opts = {0};
+  if (opts == NULL) opts = &default_opts;
+  stats_begin(opts);
+
+  alg__Status status = check_lp_sizes(A->nrows, A->ncols, b, x, c);
+  if (status != alg__status_ok) return stats_end(NULL, opts, alg__problem_lp, x, c, status);
+
+  alg__SpMat csc = (A->is_csr ? sp_switch_format(A) : A);
+  if (opts->algorithm == alg__lp_interior) {
+    status = run_lp_interior(NULL, NULL, csc, b, x, c, opts);
+  } else {
+    status = run_lp_revised(NULL, NULL, csc, b, x, c, NULL, opts);
+  }
+  if (csc != A) alg__free_sparse(csc);
+
+  return stats_end(NULL, opts, alg__problem_lp, x, c, status);
+}
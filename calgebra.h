@@ -10,11 +10,18 @@
 #include <string.h>
 
 // The element in the ith row and jth column (0-indexed), denoted
-// m_ij, is at data[i * ncols + j]; this is row-major order.
+// m_ij, is at data[i * ld + j]; this is row-major order. The leading
+// dimension ld is ncols, except in views of larger matrices.
 typedef struct {
   float *data;
   int nrows, ncols;
   int is_transposed;
+  double *data64;  // Optional double precision entries; see alg__alloc_matrix64.
+  int ld;          // The distance between the starts of consecutive rows in
+                   // data; 0 means they're adjacent. Read it with alg__ld.
+  int is_view;     // Set if the data belongs to another matrix.
+  void *map;       // The file mapping that holds data, if any; see alg__map_matrix.
+  size_t map_size;
 } alg__MatStruct, *alg__Mat;
 
 typedef enum {
@@ -22,12 +29,14 @@ typedef enum {
   alg__status_no_soln,
   alg__status_unbdd_soln,
   alg__status_input_error,
-  alg__status_lin_dep
+  alg__status_lin_dep,
+  alg__status_in_progress
 } alg__Status;
 
 // The most recent error message is stored here.  This is set
-// whenever a status other than alg__status_ok is returned
-extern const char *alg__err_str;
+// whenever a status other than alg__status_ok is returned.
+// Each thread has its own copy.
+extern _Thread_local const char *alg__err_str;
 
 // 1. Matrix setup, cleanup, and printing.
 
@@ -41,19 +50,70 @@ void     alg__free_matrix   (alg__Mat M);
       //                        4, 5, 6 );
 #define  alg__set_matrix(M, ...) \
   { float v[] = { __VA_ARGS__ }; \
-  memcpy(M->data, v, sizeof(v)); }
+  for (int r_ = 0; r_ < M->nrows; ++r_) \
+    memcpy(M->data + r_ * alg__ld(M), v + r_ * M->ncols, M->ncols * sizeof(float)); }
 
       // Returns a newly-allocated string; caller must free it.
 char *   alg__matrix_as_str (alg__Mat M);
 
+// Matrices can be saved in a binary file format and mapped back into memory
+// without being parsed or copied; alg__save_sparse and alg__map_sparse in
+// section 6 do the same for sparse matrices. A mapped matrix reads its
+// entries from the file as they're used. It may be written to, but the
+// changes stay in memory and are not saved to the file. Free it with
+// alg__free_matrix as usual. Files are tied to the byte order of the machine
+// that wrote them.
+
+      // Writes M, including any double entries, to a new file at path.
+alg__Status alg__save_matrix (alg__Mat M, const char *path);
+      // Returns NULL and sets alg__err_str if the file can't be read, or was
+      // not written by alg__save_matrix.
+alg__Mat    alg__map_matrix  (const char *path);
+
+// A matrix from alg__alloc_matrix64 also keeps its entries in double
+// precision, in data64. Most functions only use the float entries in data;
+// the refined solvers below read double inputs and write double outputs.
+// After setting the double entries, call alg__round_matrix to update the
+// float ones.
+alg__Mat alg__alloc_matrix64 (int nrows, int ncols);
+void     alg__round_matrix   (alg__Mat M);
+
+#define  alg__set_matrix64(M, ...) \
+  { double v[] = { __VA_ARGS__ }; \
+  for (int r_ = 0; r_ < M->nrows; ++r_) \
+    memcpy(M->data64 + r_ * alg__ld(M), v + r_ * M->ncols, M->ncols * sizeof(double)); \
+  alg__round_matrix(M); }
+
+// A view is a matrix whose entries belong to another matrix M, so that
+// changes to either are seen in both. Views work anywhere a matrix does; free
+// them with alg__free_matrix, which leaves M alone. The view constructors
+// return NULL and set alg__err_str if the range is outside of M.
+
+      // The nrows x ncols submatrix of M starting at row i and column j.
+alg__Mat alg__view           (alg__Mat M, int i, int j, int nrows, int ncols);
+      // Rows i to i + nrows - 1 of M, or columns j to j + ncols - 1.
+alg__Mat alg__view_rows      (alg__Mat M, int i, int nrows);
+alg__Mat alg__view_cols      (alg__Mat M, int j, int ncols);
+      // The transpose of M.
+alg__Mat alg__view_transpose (alg__Mat M);
+
 // 2. Basic matrix operations.
 //
       // In the comments, we use A[i] to mean the ith column of A.
  
+      // The leading dimension of A. A struct built without ld, which leaves
+      // it 0, has its stored rows next to each other, as if ld were ncols.
+#define  alg__ld(A) ((A)->ld ? (A)->ld : (A)->ncols)
+
       // Use alg__elt(A, i, j) as either a value or variable (r- or l-value).
 #define  alg__elt(A, i, j) \
-  (A->data[(i) * (A->is_transposed ? 1 : A->ncols) + \
-           (j) * (A->is_transposed ? A->ncols : 1)])
+  ((A)->data[(i) * ((A)->is_transposed ? 1 : alg__ld(A)) + \
+             (j) * ((A)->is_transposed ? alg__ld(A) : 1)])
+
+      // The same for the double entries of a matrix from alg__alloc_matrix64.
+#define  alg__elt64(A, i, j) \
+  ((A)->data64[(i) * ((A)->is_transposed ? 1 : alg__ld(A)) + \
+               (j) * ((A)->is_transposed ? alg__ld(A) : 1)])
 
       // Returns < A[i], B[j] >.
 float    alg__dot_prod             (alg__Mat A, int i, alg__Mat B, int j);
@@ -67,12 +127,80 @@ void     alg__scale       (float c, alg__Mat A, int i);
       // Returns ||A[i]||_2.
 float    alg__norm                 (alg__Mat A, int i);
 
+      // C = alpha op(A) op(B) + beta C, where op(A) is A^T if trans_a is set
+      // and A otherwise, and likewise for B. C may not overlap A or B. Large
+      // products are blocked for the caches and run on several threads.
+alg__Status alg__gemm (int trans_a, int trans_b, float alpha, alg__Mat A, alg__Mat B,
+                       float beta, alg__Mat C);
+
 
 // 3. Decompositions.
 
       // Provide a reduced QR decomposition; R may be NULL to ignore it.
 alg__Status alg__QR (alg__Mat A_to_Q, alg__Mat R);
 
+// QR methods. TSQR needs at least two row blocks, one per thread, each with
+// 2n rows or more. With one thread, as in a context solve, or with fewer
+// than 4n rows, alg__qr_tsqr falls back to Householder.
+typedef enum {
+  alg__qr_auto,          // The default; TSQR for tall-skinny inputs, else Householder.
+  alg__qr_householder,   // Blocked Householder with threaded trailing updates.
+  alg__qr_tsqr,          // Householder on row blocks in parallel, then on their R's.
+  alg__qr_gram_schmidt   // Modified Gram-Schmidt, one column at a time.
+} alg__QRMethod;
+
+// Options for alg__QR_opts. A zero-initialized struct gives the defaults.
+typedef struct {
+  alg__QRMethod method;
+  int num_threads;       // 0 = one per core.
+} alg__QROptions;
+
+      // The same as alg__QR, with the given options; opts may be NULL.
+alg__Status alg__QR_opts (alg__Mat A_to_Q, alg__Mat R, alg__QROptions *opts);
+
+// An updatable QR factorization of an m x n matrix A, for least squares
+// problems whose data change a row or a column at a time. It keeps its own
+// copy of A and the R of A = Q R. Each update costs O(n^2) time, or O(m n)
+// for a new column; an update that can't be made stably leaves R to be
+// refactored by the next solve.
+typedef struct alg__QRFactorStruct *alg__QRFactor;
+
+alg__QRFactor alg__qr_factor      (alg__Mat A);
+      // Appends a row to A; row is 1 x #cols(A).
+alg__Status   alg__qr_add_row     (alg__QRFactor F, alg__Mat row);
+      // Removes row i of A; the rows after it move up.
+alg__Status   alg__qr_remove_row  (alg__QRFactor F, int i);
+      // Appends a column to A; col is #rows(A) x 1.
+alg__Status   alg__qr_add_col     (alg__QRFactor F, alg__Mat col);
+      // Removes column j of A; the columns after it move left.
+alg__Status   alg__qr_remove_col  (alg__QRFactor F, int j);
+      // Sets each column of X to the x with min ||Ax - B[j]||_2. B is
+      // #rows(A) x k, and X is #cols(A) x k. Returns alg__status_lin_dep if
+      // A lacks full column rank.
+alg__Status   alg__qr_solve       (alg__QRFactor F, alg__Mat B, alg__Mat X);
+      // Copies R, which is #cols(A) x #cols(A) with a nonnegative diagonal.
+alg__Status   alg__qr_get_R       (alg__QRFactor F, alg__Mat R);
+void          alg__free_qr_factor (alg__QRFactor F);
+
+// Streaming least squares for rows that arrive over time. An alg__RLS takes
+// the rows of A and b in chunks of any size, and keeps only the triangular
+// factor R of the rows seen so far, so its memory is O(n^2) however many rows
+// pass through. Each row's squared residual is weighted by forget^t, where t
+// is the number of rows after it; forget = 1 weighs every row equally, and
+// it is expected to be in (0, 1].
+typedef struct alg__RLSStruct *alg__RLS;
+
+alg__RLS    alg__alloc_rls    (int n, float forget);
+      // Adds the rows of X, which is k x n, to A and those of y, which is
+      // k x 1, to b.
+alg__Status alg__rls_add      (alg__RLS S, alg__Mat X, alg__Mat y);
+      // Sets x, which is n x 1, to the current x with min ||Ax - b||_2.
+      // Returns alg__status_lin_dep while A lacks full column rank.
+alg__Status alg__rls_solve    (alg__RLS S, alg__Mat x);
+      // The weighted ||Ax - b||_2 at the current solution.
+float       alg__rls_residual (alg__RLS S);
+void        alg__free_rls     (alg__RLS S);
+
 // 4. Optimizations.
 
 // The next three functions solve this problem for p=1, 2, or infinity:
@@ -84,7 +212,280 @@ alg__Status alg__l1_min   (alg__Mat A, alg__Mat b, alg__Mat x);
 alg__Status alg__l2_min   (alg__Mat A, alg__Mat b, alg__Mat x);
 alg__Status alg__linf_min (alg__Mat A, alg__Mat b, alg__Mat x);
 
+// The least squares problem for an A with at least as many rows as columns:
+//    Find x which gives    min ||Ax - b||_2.
+// A is expected to have full column rank; otherwise this returns
+// alg__status_lin_dep. Like alg__l2_min, this uses the normal equations
+// when A has at least 4 times as many rows as columns and isn't badly
+// conditioned, and Householder QR otherwise.
+alg__Status alg__l2_lsq   (alg__Mat A, alg__Mat b, alg__Mat x);
+
+// A factorization of A for solving the l2 problem above for many b.
+// Building it costs O(m n min(m, n)) time for an m x n matrix A; each solve
+// then costs O(m n) per column of B, and allocates nothing once its scratch
+// space has grown to the largest B seen.
+typedef struct alg__L2FactorStruct *alg__L2Factor;
+
+alg__L2Factor alg__l2_factor      (alg__Mat A);
+      // Sets each column of X to the x with min ||x||_2 and Ax = B[j].
+      // B is #rows(A) x k, and X is #cols(A) x k.
+alg__Status   alg__l2_solve       (alg__L2Factor F, alg__Mat B, alg__Mat X);
+void          alg__free_l2_factor (alg__L2Factor F);
+
+// Mixed precision versions of the l2 solvers. These solve in float as
+// above, and then apply iterative refinement: each step finds the residual
+// B - A X in double and solves for a correction with the float factors.
+// This gives nearly double precision when A is not badly conditioned. The
+// double entries of A, B, and X are used when they have them.
+alg__Status   alg__l2_solve_refined (alg__L2Factor F, alg__Mat A, alg__Mat B, alg__Mat X);
+alg__Status   alg__l2_min_refined   (alg__Mat A, alg__Mat b, alg__Mat x);
+
 // Solve a general linear programming problem.
 // Specifically, find x that minimizes (c^T * x) with Ax=b, x >= 0.
 // The l1_min function above is a wrapper around this.
 alg__Status alg__run_lp   (alg__Mat A, alg__Mat b, alg__Mat x, alg__Mat c);
+
+typedef enum {
+  alg__lp_tableau,  // The default; pivots on a dense (m+2) x (n+m+3) tableau.
+  alg__lp_revised,  // Keeps an LU-factored basis; better for many rows.
+  alg__lp_interior  // A primal-dual interior point method; see crossover below.
+} alg__LPAlgorithm;
+
+// Pricing rules choose the entering column of each pivot.
+typedef enum {
+  alg__pricing_bland,     // The default; the first improving column.
+  alg__pricing_dantzig,   // The column with the largest reduced cost.
+  alg__pricing_partial,   // Dantzig's rule on a rotating window of columns.
+  alg__pricing_devex,     // Steepest edge approximated with reference weights.
+  alg__pricing_steepest   // Steepest edge.
+} alg__Pricing;
+
+// An opaque basis, which lists the basic variables at the end of a solve.
+// Passing it to a later solve with the same shape of A lets that solve skip
+// phase 1 when the basis is still feasible for the new b. With the revised
+// algorithm, a basis that is no longer feasible but is still optimal for c,
+// as after b changes, is instead re-optimized with the dual simplex method.
+typedef struct alg__BasisStruct *alg__Basis;
+
+alg__Basis alg__alloc_basis  ();
+void       alg__free_basis   (alg__Basis basis);
+
+      // Fits a stored basis to a problem whose A gains new_rows rows at the
+      // bottom and new_cols columns at the right, such as slack columns for
+      // new inequality rows; b, c, and any bounds grow to match. The solve
+      // with the new A continues from the old optimum with the dual simplex
+      // method, as long as the new columns don't lower the cost.
+void       alg__extend_basis (alg__Basis basis, int new_rows, int new_cols);
+
+// Statistics of one solve, filled in when the stats option is set.
+typedef struct {
+  int    phase1_pivots;      // Pivots toward a feasible x: phase 1, or the dual
+                             // simplex method from a stored basis.
+  int    phase2_pivots;      // Pivots that lower c^T x from a feasible x.
+  int    degenerate_pivots;  // Pivots, in either phase, that left x unchanged.
+  int    bound_flips;        // Moves of a nonbasic variable to its other bound,
+                             // which change x but not the basis; these are
+                             // not counted as pivots.
+  int    interior_iters;     // Iterations of alg__lp_interior.
+  double phase1_seconds;     // Wall time in each phase of the simplex method,
+  double phase2_seconds;     // and in the interior point iterations.
+  double interior_seconds;
+  size_t scratch_bytes;      // The scratch memory the solve used; see
+                             // alg__scratch_bytes. Without a context, this
+                             // is the total of all its heap allocations,
+                             // which is what a context would need, and not
+                             // the peak heap use.
+  double objective;          // The final c^T x, or ||x|| for the l1 and linf
+                             // problems; NAN when the solve failed.
+} alg__SolveStats;
+
+// A function called after each simplex pivot with the phase (1 or 2), the
+// objective of that phase, and the entering and leaving variables, where
+// variable #cols(A) + i is the artificial variable of row i. With presolve,
+// these belong to the reduced problem.
+typedef void (*alg__PivotCallback)(void *data, int phase, double objective,
+                                   int entering, int leaving);
+
+// Options for alg__run_lp_opts. A zero-initialized struct gives the defaults.
+typedef struct {
+  alg__LPAlgorithm algorithm;
+  int refactor_freq;  // Pivots between refactorizations (revised only); 0 = 64.
+
+  alg__Pricing pricing;
+  int partial_size;   // Columns per alg__pricing_partial window; 0 = max(n/8, 16).
+  int stall_limit;    // Degenerate pivots in a row before using Bland's rule; 0 = 50.
+
+  alg__Basis basis;   // If not NULL, the starting basis; a successful solve
+                      // replaces it with the optimal basis.
+
+  int refine;         // If set, the final basic solution is refined in double,
+                      // as in alg__l2_solve_refined. Ignored for sparse A.
+
+  int crossover;      // If set, alg__lp_interior finishes at a vertex with the
+                      // revised simplex method, and stores its basis. Without
+                      // it, x is interior to the optimal face when that face
+                      // isn't a single point, and basis and refine are ignored.
+
+  int presolve;       // If set, rows and columns whose values are forced are
+                      // removed first, and the rest is scaled; x is still in
+                      // terms of the original variables, but basis belongs to
+                      // the reduced problem. Ignored for sparse A.
+
+  int num_threads;    // Threads for each pivot of alg__lp_tableau on a large
+                      // tableau; 0 = one per core.
+
+  alg__SolveStats   *stats;          // If not NULL, filled in by each solve.
+  alg__PivotCallback on_pivot;       // If not NULL, called after each pivot,
+  void              *on_pivot_data;  // with this as its first argument.
+} alg__LPOptions;
+
+// The same as alg__run_lp, with the given options; opts may be NULL.
+alg__Status alg__run_lp_opts (alg__Mat A, alg__Mat b, alg__Mat x, alg__Mat c,
+                              alg__LPOptions *opts);
+
+// The same as alg__run_lp_opts, with the constraint lo <= x <= hi in place of
+// x >= 0. The bounds are #cols(A) x 1, and their entries may be -INFINITY or
+// INFINITY; lo may be NULL for zeros, and hi for INFINITY. Free and bounded
+// variables are handled directly, without extra columns. This always uses
+// the revised simplex method.
+alg__Status alg__run_lp_bounded (alg__Mat A, alg__Mat b, alg__Mat x, alg__Mat c,
+                                 alg__Mat lo, alg__Mat hi, alg__LPOptions *opts);
+
+// A solve of alg__run_lp_bounded that runs a few pivots at a time, so that
+// one thread can take turns between many solves, or give up on a slow one
+// by freeing it. It always uses the revised simplex method, and ignores the
+// presolve option.
+typedef struct alg__LPSolverStruct *alg__LPSolver;
+
+      // Sets up the solve; lo and hi may be NULL as in alg__run_lp_bounded.
+      // The matrices and opts->basis are used until the solve ends, and x is
+      // set then. Input errors are returned by the first alg__step_lp.
+alg__LPSolver alg__start_lp      (alg__Mat A, alg__Mat b, alg__Mat x, alg__Mat c,
+                                  alg__Mat lo, alg__Mat hi, alg__LPOptions *opts);
+
+      // Runs at most max_pivots pivots, and starts no new pivot once
+      // max_seconds have passed; either may be <= 0 for no limit. Each call
+      // runs at least one pivot. Only basis changes count as pivots, not
+      // bound flips, except that the end of phase 1 may take extra pivots to
+      // move artificial variables out of the basis. Returns
+      // alg__status_in_progress if the solve isn't done yet, and otherwise
+      // its final status, which later calls return again.
+alg__Status   alg__step_lp       (alg__LPSolver solver, int max_pivots, double max_seconds);
+
+void          alg__free_lp_solver(alg__LPSolver solver);
+
+// 5. Contexts and batches.
+
+// A context carries the state of a series of solves on one thread, so that
+// several threads can solve at once. Every temporary of a solve comes from
+// its scratch memory, which grows to fit the largest problem seen and is then
+// reused, so that later solves make no heap allocations. Solves with a
+// context run on the calling thread only.
+typedef struct {
+  const char    *err_str;  // Set by each call below; NULL on success.
+  alg__LPOptions lp_opts;  // Used by the solvers below; zero for the defaults.
+
+  // Scratch memory; for internal use.
+  char  *scratch;
+  size_t scratch_size, scratch_used, scratch_want;
+  int    scratch_is_borrowed;  // Set by alg__set_scratch.
+} alg__ContextStruct, *alg__Context;
+
+alg__Context alg__alloc_context ();
+void         alg__free_context  (alg__Context ctx);
+
+      // Makes ctx use the size bytes at mem as its scratch memory. The caller
+      // owns mem and must keep it until ctx is freed or given other memory.
+      // This memory is never grown; a solve that needs more allocates the
+      // rest itself and frees it before returning. The block starts at the
+      // first 16-byte aligned address in mem; any bytes before it go unused.
+void         alg__set_scratch    (alg__Context ctx, void *mem, size_t size);
+
+      // Grows the scratch memory of ctx to at least size bytes.
+void         alg__reserve_scratch(alg__Context ctx, size_t size);
+
+      // These match the functions above, with errors reported in ctx->err_str.
+alg__Status alg__QR_ctx      (alg__Context ctx, alg__Mat A_to_Q, alg__Mat R);
+alg__Status alg__l1_min_ctx  (alg__Context ctx, alg__Mat A, alg__Mat b, alg__Mat x);
+alg__Status alg__l2_min_ctx  (alg__Context ctx, alg__Mat A, alg__Mat b, alg__Mat x);
+alg__Status alg__linf_min_ctx(alg__Context ctx, alg__Mat A, alg__Mat b, alg__Mat x);
+alg__Status alg__run_lp_ctx  (alg__Context ctx, alg__Mat A, alg__Mat b, alg__Mat x,
+                              alg__Mat c);
+
+typedef enum {
+  alg__problem_lp,
+  alg__problem_l1,
+  alg__problem_l2,
+  alg__problem_linf
+} alg__ProblemType;
+
+      // Returns the scratch bytes that a solve of the given type needs for an
+      // m x n matrix A, with lp_opts equal to opts, which may be NULL. A
+      // context with this much scratch memory solves such a problem without
+      // heap allocations.
+size_t alg__scratch_bytes   (alg__ProblemType type, int m, int n, alg__LPOptions *opts);
+
+      // The same for alg__QR_ctx with an m x n matrix A_to_Q.
+size_t alg__QR_scratch_bytes(int m, int n);
+
+// One problem in a batch. Problems may share their input matrices A, b, and c.
+typedef struct {
+  alg__ProblemType type;
+  alg__Mat A, b, x;
+  alg__Mat c;            // Only used by alg__problem_lp.
+  alg__Status status;    // Set by alg__solve_batch.
+  const char *err_str;   // Set by alg__solve_batch; NULL on success.
+} alg__Problem;
+
+      // Solves the problems on num_threads threads, or one per core if
+      // num_threads <= 0. Each thread uses its own context, with lp_opts
+      // copied from opts, which may be NULL; the basis and stats options are
+      // ignored.
+      // Returns the status of the first problem that failed, or
+      // alg__status_ok if none did.
+alg__Status alg__solve_batch(alg__Problem *problems, int num_problems, int num_threads,
+                             alg__LPOptions *opts);
+
+// 6. Sparse matrices.
+
+// A sparse matrix in compressed sparse column (CSC) or row (CSR) form.
+// In CSC form, the nonzeros of column j are vals[t] in row idx[t] for
+// start[j] <= t < start[j + 1], with rows in increasing order. In CSR
+// form, the roles of rows and columns are swapped.
+typedef struct {
+  float *vals;
+  int   *idx;
+  int   *start;
+  int    nrows, ncols, nnz;
+  int    is_csr;
+  void  *map;      // The file mapping that holds the arrays, if any.
+  size_t map_size;
+} alg__SpMatStruct, *alg__SpMat;
+
+      // Builds a matrix from the nnz triplets (rows[t], cols[t], vals[t]);
+      // duplicate entries are summed. Returns NULL if an index is out of range.
+alg__SpMat alg__alloc_sparse       (int nrows, int ncols, int nnz,
+                                    int *rows, int *cols, float *vals, int is_csr);
+      // Returns a sparse copy of the nonzero entries of M.
+alg__SpMat alg__sparse_from_matrix (alg__Mat M, int is_csr);
+void       alg__free_sparse        (alg__SpMat A);
+      // These match alg__save_matrix and alg__map_matrix for a sparse A.
+alg__Status alg__save_sparse       (alg__SpMat A, const char *path);
+alg__SpMat  alg__map_sparse        (const char *path);
+
+      // These match alg__dot_prod and alg__mul_and_add for a sparse A.
+float    alg__sp_dot_prod             (alg__SpMat A, int i, alg__Mat B, int j);
+void     alg__sp_mul_and_add (float c, alg__SpMat A, int i, alg__Mat B, int j);
+
+// These match the solvers in section 4 for a sparse A; their time and memory
+// scale with the number of nonzeros. The LP-based solvers use the revised
+// simplex method, except that alg__sp_run_lp_opts also takes alg__lp_interior,
+// whose normal equations are a dense #rows(A) x #rows(A) matrix.
+// alg__sp_l2_min uses the conjugate gradient method on A A^T.
+
+alg__Status alg__sp_l1_min      (alg__SpMat A, alg__Mat b, alg__Mat x);
+alg__Status alg__sp_l2_min      (alg__SpMat A, alg__Mat b, alg__Mat x);
+alg__Status alg__sp_linf_min    (alg__SpMat A, alg__Mat b, alg__Mat x);
+alg__Status alg__sp_run_lp      (alg__SpMat A, alg__Mat b, alg__Mat x, alg__Mat c);
+alg__Status alg__sp_run_lp_opts (alg__SpMat A, alg__Mat b, alg__Mat x, alg__Mat c,
+                                 alg__LPOptions *opts);
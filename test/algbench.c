@@ -0,0 +1,330 @@
+// algbench.c
+//
+// https://github.com/tylerneylon/calgebra
+//
+// Times the solvers on seeded random problems across a sweep of sizes, and
+// writes the results as JSON. Usage:
+//
+//   algbench [--quick] [--seed N] [--out FILE] [--baseline FILE] [--threshold T]
+//
+// With --baseline, each timing is compared with the same entry of an earlier
+// output, and the exit status is 1 if any is slower by more than a factor of
+// T (default 1.5), or if a solve that succeeded there now fails.
+//
+
+#include "calgebra.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define max_reps     50
+#define rep_seconds  0.2    // Each entry repeats until it has taken this long.
+#define noise_floor  1e-4   // Timings below this many seconds are not gated.
+#define sp_density   0.1
+
+typedef struct {
+  char   name[32];
+  int    m, n;
+  double seconds;  // The fastest repetition.
+  int    reps;
+  int    status;
+} Result;
+
+
+// Problem generators.
+
+// A xorshift64* generator, so that a seed gives the same problems everywhere.
+static uint64_t rng_state = 1;
+
+static double rand_unit() {
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return (double)((rng_state * 2685821657736338717ULL) >> 11) / 9007199254740992.0;
+}
+
+// Entries are uniform in [-1, 1).
+static alg__Mat rand_dense(int m, int n) {
+  alg__Mat A = alg__alloc_matrix(m, n);
+  for (int i = 0; i < m; ++i) {
+    for (int j = 0; j < n; ++j) alg__elt(A, i, j) = 2 * rand_unit() - 1;
+  }
+  return A;
+}
+
+// Each entry is nonzero with probability sp_density, and each column has at
+// least one nonzero.
+static alg__SpMat rand_sparse(int m, int n) {
+  int    cap  = m * n + n, nnz = 0;
+  int   *rows = malloc(cap * sizeof(int));
+  int   *cols = malloc(cap * sizeof(int));
+  float *vals = malloc(cap * sizeof(float));
+  for (int j = 0; j < n; ++j) {
+    rows[nnz] = (int)(rand_unit() * m), cols[nnz] = j, vals[nnz++] = 2 * rand_unit() - 1;
+    for (int i = 0; i < m; ++i) {
+      if (rand_unit() >= sp_density) continue;
+      rows[nnz] = i, cols[nnz] = j, vals[nnz++] = 2 * rand_unit() - 1;
+    }
+  }
+  alg__SpMat A = alg__alloc_sparse(m, n, nnz, rows, cols, vals, false);
+  free(vals);
+  free(cols);
+  free(rows);
+  return A;
+}
+
+// An LP that is feasible and bounded: b = A x0 for some x0 >= 0, and
+// c = A^T y + s for some s >= 0, so that y is dual feasible.
+static void rand_lp(alg__Mat A, alg__Mat b, alg__Mat c) {
+  int m = A->nrows, n = A->ncols;
+  for (int i = 0; i < m; ++i) alg__elt(b, i, 0) = 0;
+  for (int j = 0; j < n; ++j) {
+    float x0 = (rand_unit() < 0.5 ? 0 : rand_unit());
+    for (int i = 0; i < m; ++i) alg__elt(b, i, 0) += alg__elt(A, i, j) * x0;
+  }
+  double *y = malloc(m * sizeof(double));
+  for (int i = 0; i < m; ++i) y[i] = 2 * rand_unit() - 1;
+  for (int j = 0; j < n; ++j) {
+    double cj = rand_unit();
+    for (int i = 0; i < m; ++i) cj += alg__elt(A, i, j) * y[i];
+    alg__elt(c, j, 0) = cj;
+  }
+  free(y);
+}
+
+
+// Timing.
+
+static double now_seconds() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + 1e-9 * t.tv_nsec;
+}
+
+typedef enum { qr, l1, l2, linf, lp, gemm } SolverType;
+
+typedef struct {
+  SolverType type;
+  int        is_sparse;
+  alg__Mat   A, A_copy, b, c, x, R;
+  alg__SpMat sp;
+} Problem;
+
+static alg__Status run_once(Problem *P) {
+  switch (P->type) {
+    case qr:
+      return alg__QR(P->A_copy, P->R);
+    case l1:
+      if (P->is_sparse) return alg__sp_l1_min(P->sp, P->b, P->x);
+      return alg__l1_min(P->A, P->b, P->x);
+    case l2:
+      if (P->is_sparse) return alg__sp_l2_min(P->sp, P->b, P->x);
+      return alg__l2_min(P->A, P->b, P->x);
+    case linf:
+      if (P->is_sparse) return alg__sp_linf_min(P->sp, P->b, P->x);
+      return alg__linf_min(P->A, P->b, P->x);
+    case lp:
+      if (P->is_sparse) return alg__sp_run_lp(P->sp, P->b, P->x, P->c);
+      return alg__run_lp(P->A, P->b, P->x, P->c);
+    case gemm:
+      return alg__gemm(false, false, 1, P->A, P->A, 0, P->R);
+  }
+  return alg__status_input_error;
+}
+
+// Times the fastest of several runs, and leaves the status of the last.
+static void time_problem(Problem *P, Result *r) {
+  double total = 0;
+  r->seconds = INFINITY;
+  for (r->reps = 0; r->reps < max_reps && total < rep_seconds; ++r->reps) {
+    // QR overwrites its input, so each run gets a fresh copy.
+    if (P->type == qr) {
+      for (int i = 0; i < P->A->nrows; ++i) {
+        for (int j = 0; j < P->A->ncols; ++j) alg__elt(P->A_copy, i, j) = alg__elt(P->A, i, j);
+      }
+    }
+    double start = now_seconds();
+    r->status = run_once(P);
+    double elapsed = now_seconds() - start;
+    total += elapsed;
+    if (elapsed < r->seconds) r->seconds = elapsed;
+  }
+}
+
+// Runs the benchmark of one solver at one size, and appends its result.
+static void bench(SolverType type, int is_sparse, int m, int n, Result *results, int *nresults) {
+  static const char *names[] = { "QR", "l1_min", "l2_min", "linf_min", "run_lp", "gemm" };
+  Problem P = { .type = type, .is_sparse = is_sparse };
+  P.A = rand_dense(m, n);
+  P.b = rand_dense(m, 1);
+  P.x = alg__alloc_matrix(n, 1);
+  if (type == qr) {
+    P.A_copy = alg__alloc_matrix(m, n);
+    P.R      = alg__alloc_matrix(n, n);
+  }
+  if (type == gemm) P.R = alg__alloc_matrix(m, n);
+  if (type == lp) {
+    P.c = alg__alloc_matrix(n, 1);
+    if (is_sparse) {
+      P.sp = rand_sparse(m, n);
+      alg__free_matrix(P.A);
+      P.A = alg__alloc_matrix(m, n);
+      for (int i = 0; i < m; ++i) {
+        for (int j = 0; j < n; ++j) alg__elt(P.A, i, j) = 0;
+      }
+      for (int j = 0; j < n; ++j) {
+        for (int t = P.sp->start[j]; t < P.sp->start[j + 1]; ++t) {
+          alg__elt(P.A, P.sp->idx[t], j) = P.sp->vals[t];
+        }
+      }
+    }
+    rand_lp(P.A, P.b, P.c);
+  } else if (is_sparse) {
+    P.sp = rand_sparse(m, n);
+  }
+
+  Result *r = &results[(*nresults)++];
+  snprintf(r->name, sizeof(r->name), "%s%s", is_sparse ? "sp_" : "", names[type]);
+  r->m = m;
+  r->n = n;
+  time_problem(&P, r);
+  printf("%-12s %4d x %-4d %10.6f s  (%d rep%s)%s\n", r->name, m, n, r->seconds, r->reps,
+         r->reps == 1 ? "" : "s", r->status == alg__status_ok ? "" : "  failed");
+
+  if (P.sp)     alg__free_sparse(P.sp);
+  if (P.R)      alg__free_matrix(P.R);
+  if (P.A_copy) alg__free_matrix(P.A_copy);
+  if (P.c)      alg__free_matrix(P.c);
+  alg__free_matrix(P.x);
+  alg__free_matrix(P.b);
+  alg__free_matrix(P.A);
+}
+
+
+// Output and comparison.
+
+// Each result is on a line of its own, so that read_results can parse the
+// output with sscanf.
+static int write_results(const char *path, uint64_t seed, Result *results, int nresults) {
+  FILE *f = fopen(path, "w");
+  if (f == NULL) return false;
+  fprintf(f, "{\n  \"seed\": %llu,\n  \"results\": [\n", (unsigned long long)seed);
+  for (int k = 0; k < nresults; ++k) {
+    Result *r = &results[k];
+    fprintf(f, "    {\"name\": \"%s\", \"m\": %d, \"n\": %d, \"seconds\": %.9f, "
+               "\"reps\": %d, \"status\": %d}%s\n",
+            r->name, r->m, r->n, r->seconds, r->reps, r->status, k + 1 < nresults ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+  fclose(f);
+  return true;
+}
+
+// Returns the number of results read, or -1 if the file can't be opened.
+static int read_results(const char *path, Result *results, int max_results) {
+  FILE *f = fopen(path, "r");
+  if (f == NULL) return -1;
+  char line[256];
+  int  nresults = 0;
+  while (nresults < max_results && fgets(line, sizeof(line), f)) {
+    Result *r = &results[nresults];
+    int n = sscanf(line, " {\"name\": \"%31[^\"]\", \"m\": %d, \"n\": %d, \"seconds\": %lf, "
+                         "\"reps\": %d, \"status\": %d}",
+                   r->name, &r->m, &r->n, &r->seconds, &r->reps, &r->status);
+    if (n == 6) ++nresults;
+  }
+  fclose(f);
+  return nresults;
+}
+
+// Returns the number of regressions against the baseline.
+static int compare_results(Result *results, int nresults, Result *base, int nbase,
+                           double threshold) {
+  int regressions = 0;
+  printf("\n%-12s %11s %12s %12s %8s\n", "name", "size", "baseline", "now", "ratio");
+  for (int k = 0; k < nresults; ++k) {
+    Result *r = &results[k], *b = NULL;
+    for (int t = 0; t < nbase && b == NULL; ++t) {
+      if (!strcmp(base[t].name, r->name) && base[t].m == r->m && base[t].n == r->n) b = &base[t];
+    }
+    if (b == NULL) continue;
+    double ratio = r->seconds / b->seconds;
+    int is_slower = (ratio > threshold && r->seconds > noise_floor);
+    int now_fails = (r->status != alg__status_ok && b->status == alg__status_ok);
+    printf("%-12s %4d x %-4d %12.6f %12.6f %8.2f%s\n", r->name, r->m, r->n, b->seconds,
+           r->seconds, ratio, is_slower ? "  REGRESSED" : now_fails ? "  FAILS" : "");
+    regressions += (is_slower || now_fails);
+  }
+  return regressions;
+}
+
+
+// Main.
+
+int main(int argc, char **argv) {
+  const char *out_path = NULL, *baseline_path = NULL;
+  double      threshold = 1.5;
+  int         quick = false;
+  uint64_t    seed = 1;
+  for (int i = 1; i < argc; ++i) {
+    int has_arg = (i + 1 < argc);
+    if      (!strcmp(argv[i], "--quick"))                quick = true;
+    else if (!strcmp(argv[i], "--seed") && has_arg)      seed = strtoull(argv[++i], NULL, 10);
+    else if (!strcmp(argv[i], "--out") && has_arg)       out_path = argv[++i];
+    else if (!strcmp(argv[i], "--baseline") && has_arg)  baseline_path = argv[++i];
+    else if (!strcmp(argv[i], "--threshold") && has_arg) threshold = atof(argv[++i]);
+    else {
+      fprintf(stderr, "Usage: %s [--quick] [--seed N] [--out FILE] [--baseline FILE] "
+                      "[--threshold T]\n", argv[0]);
+      return 2;
+    }
+  }
+  rng_state = seed ? seed : 1;
+
+  // The LP-based problems have n = 3m, as with a dictionary of 3 atoms per
+  // measurement; QR is on a tall 3n x n matrix, and gemm squares an n x n one.
+  int sizes[]  = { 16, 32, 64, 128 };
+  int nsizes   = (quick ? 2 : 4);
+  int max_results = 16 * nsizes;
+  Result *results = malloc(max_results * sizeof(Result));
+  int     nresults = 0;
+  for (int s = 0; s < nsizes; ++s) {
+    int m = sizes[s], n = 3 * m;
+    bench(qr, false, n, m, results, &nresults);
+    bench(gemm, false, n, n, results, &nresults);
+    for (int is_sparse = 0; is_sparse < 2; ++is_sparse) {
+      bench(l1,   is_sparse, m, n, results, &nresults);
+      bench(l2,   is_sparse, m, n, results, &nresults);
+      bench(linf, is_sparse, m, n, results, &nresults);
+      bench(lp,   is_sparse, m, n, results, &nresults);
+    }
+  }
+
+  if (out_path && !write_results(out_path, seed, results, nresults)) {
+    fprintf(stderr, "Can't write %s\n", out_path);
+    return 2;
+  }
+
+  int status = 0;
+  if (baseline_path) {
+    Result *base  = malloc(max_results * sizeof(Result));
+    int     nbase = read_results(baseline_path, base, max_results);
+    if (nbase < 0) {
+      fprintf(stderr, "Can't read %s\n", baseline_path);
+      status = 2;
+    } else {
+      int regressions = compare_results(results, nresults, base, nbase, threshold);
+      printf("\n%d regression%s past a ratio of %.2f.\n", regressions,
+             regressions == 1 ? "" : "s", threshold);
+      status = (regressions > 0);
+    }
+    free(base);
+  }
+  free(results);
+  return status;
+}
@@ -7,9 +7,11 @@
 #include "test/ctest.h"
 
 #include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 int test_basic_ops() {
   // We start with
@@ -67,6 +69,219 @@ int test_basic_ops() {
   return test_success;
 }
 
+int test_long_vector_ops() {
+  // These columns are long enough to use the vector kernels, with a tail
+  // left over. Column j of A has entries k + j, and B is A transposed, so
+  // its columns are contiguous in memory.
+  int n = 37;
+  alg__Mat A = alg__alloc_matrix(n, 2);
+  alg__Mat B = alg__alloc_matrix(2, n);
+  for (int k = 0; k < n; ++k) {
+    for (int j = 0; j < 2; ++j) {
+      alg__elt(A, k, j) = k + j;
+      alg__elt(B, j, k) = k + j;
+    }
+  }
+  B->is_transposed = 1;
+
+  // sum_k k * (k + 1) = (n - 1) n (n + 1) / 3.
+  float expected = (n - 1) * n * (n + 1) / 3;
+  test_that(alg__dot_prod(A, 0, A, 1) == expected);
+  test_that(alg__dot_prod(B, 0, B, 1) == expected);
+  test_that(alg__dot_prod(A, 0, B, 1) == expected);
+
+  // Afterwards, column 1 of each is all ones.
+  alg__mul_and_add(-1, A, 0, A, 1);
+  alg__mul_and_add(-1, B, 0, B, 1);
+  alg__scale(3, A, 1);
+  alg__scale(3, B, 1);
+  for (int k = 0; k < n; ++k) {
+    test_that(alg__elt(A, k, 1) == 3);
+    test_that(alg__elt(B, k, 1) == 3);
+  }
+  test_that(alg__norm(B, 1) == sqrtf(9 * n));
+
+  alg__free_matrix(A);
+  alg__free_matrix(B);
+
+  return test_success;
+}
+
+// Fills M with small integers, so that products of up to a few hundred
+// terms are exact in float.
+static void fill_ints(alg__Mat M, int seed) {
+  for (int i = 0; i < M->nrows; ++i) {
+    for (int j = 0; j < M->ncols; ++j) alg__elt(M, i, j) = (i * 31 + j * 17 + seed) % 13 - 6;
+  }
+}
+
+int test_gemm() {
+  // The shapes cross the block sizes of the product, and the largest runs on
+  // several threads. Each case checks every combination of transposes,
+  // made either with the flags or with transposed matrices.
+  int shapes[][3] = { { 2, 3, 4 }, { 7, 5, 9 }, { 30, 17, 40 }, { 130, 70, 300 } };
+  for (int s = 0; s < 4; ++s) {
+    int m = shapes[s][0], n = shapes[s][1], k = shapes[s][2];
+    for (int flags = 0; flags < 8; ++flags) {
+      int trans_a = flags & 1, trans_b = (flags >> 1) & 1, use_views = flags >> 2;
+      alg__Mat A = (trans_a ? alg__alloc_matrix(k, m) : alg__alloc_matrix(m, k));
+      alg__Mat B = (trans_b ? alg__alloc_matrix(n, k) : alg__alloc_matrix(k, n));
+      alg__Mat C = alg__alloc_matrix(m, n);
+      fill_ints(A, 1);
+      fill_ints(B, 2);
+      fill_ints(C, 3);
+      alg__Mat C0 = alg__copy_matrix(C);
+      alg__Mat opA = A, opB = B;
+      if (use_views) {
+        // Flip the flags into transposed views, which hold the same op(A).
+        if (trans_a) opA = alg__view_transpose(A);
+        if (trans_b) opB = alg__view_transpose(B);
+      }
+      int ta = (use_views ? 0 : trans_a), tb = (use_views ? 0 : trans_b);
+      test_that(alg__gemm(ta, tb, 2, opA, opB, -1, C) == alg__status_ok);
+
+      int all_match = 1;
+      for (int i = 0; i < m; ++i) {
+        for (int j = 0; j < n; ++j) {
+          float sum = 0;
+          for (int p = 0; p < k; ++p) {
+            sum += (trans_a ? alg__elt(A, p, i) : alg__elt(A, i, p)) *
+                   (trans_b ? alg__elt(B, j, p) : alg__elt(B, p, j));
+          }
+          if (alg__elt(C, i, j) != 2 * sum - alg__elt(C0, i, j)) all_match = 0;
+        }
+      }
+      test_that(all_match);
+
+      if (opA != A) alg__free_matrix(opA);
+      if (opB != B) alg__free_matrix(opB);
+      alg__free_matrix(A);
+      alg__free_matrix(B);
+      alg__free_matrix(C);
+      alg__free_matrix(C0);
+    }
+  }
+
+  // C can be a view, and beta = 0 ignores its old entries.
+  alg__Mat A = alg__alloc_matrix(9, 9);
+  alg__Mat M = alg__alloc_matrix(12, 12);
+  fill_ints(A, 4);
+  for (int i = 0; i < 12; ++i) {
+    for (int j = 0; j < 12; ++j) alg__elt(M, i, j) = NAN;
+  }
+  alg__Mat C = alg__view(M, 1, 2, 9, 9);
+  test_that(alg__gemm(0, 1, 1, A, A, 0, C) == alg__status_ok);
+  for (int i = 0; i < 9; ++i) {
+    for (int j = 0; j < 9; ++j) {
+      float sum = 0;
+      for (int p = 0; p < 9; ++p) sum += alg__elt(A, i, p) * alg__elt(A, j, p);
+      test_that(alg__elt(C, i, j) == sum);
+    }
+  }
+  test_that(isnan(alg__elt(M, 0, 0)) && isnan(alg__elt(M, 11, 11)));
+
+  // Mismatched sizes are an input error.
+  test_that(alg__gemm(0, 0, 1, A, M, 0, C) == alg__status_input_error);
+
+  alg__free_matrix(C);
+  alg__free_matrix(M);
+  alg__free_matrix(A);
+
+  return test_success;
+}
+
+int test_views() {
+  // M holds the problem from test_l1_min in rows 1-2: A in columns 1-3 and b
+  // in column 4.
+  alg__Mat M = alg__alloc_matrix(4, 5);
+  alg__set_matrix(M,  0,  0,  0,  0,  0,
+                      0,  4,  4,  1,  8,
+                      0,  8,  0,  1,  8,
+                      0,  0,  0,  0,  0 );
+  alg__Mat A = alg__view(M, 1, 1, 2, 3);
+  alg__Mat b = alg__view(M, 1, 4, 2, 1);
+  test_that(A->ld == 5 && alg__elt(A, 1, 0) == 8);
+  test_that(alg__dot_prod(A, 0, b, 0) == 96);
+
+  // x is the last column of X, and the solvers write only there.
+  alg__Mat X = alg__alloc_matrix(3, 2);
+  alg__set_matrix(X, 7, 7,
+                     7, 7,
+                     7, 7);
+  alg__Mat x = alg__view_cols(X, 1, 1);
+
+  test_that(alg__l1_min(A, b, x) == alg__status_ok);
+  test_that(fabs(alg__elt(x, 0, 0) - 1) < 0.001);
+  test_that(fabs(alg__elt(x, 1, 0) - 1) < 0.001);
+  test_that(fabs(alg__elt(x, 2, 0) - 0) < 0.001);
+  test_that(alg__elt(X, 0, 0) == 7 && alg__elt(X, 2, 0) == 7);
+
+  alg__LPOptions opts = { .algorithm = alg__lp_revised };
+  alg__Mat c = alg__alloc_matrix(3, 1);
+  alg__set_matrix(c, 1, 1, 1);
+  test_that(alg__run_lp_opts(A, b, x, c, &opts) == alg__status_ok);
+  test_that(fabs(alg__elt(x, 0, 0) - 1) < 0.001);
+
+  test_that(alg__linf_min(A, b, x) == alg__status_ok);
+  test_that(alg__l2_min(A, b, x) == alg__status_ok);
+  test_that(fabs(4 * alg__elt(x, 0, 0) + 4 * alg__elt(x, 1, 0) + alg__elt(x, 2, 0) - 8) < 0.001);
+
+  // A transposed view shares the entries of M.
+  alg__Mat At = alg__view_transpose(A);
+  test_that(At->ld == 5 && alg__elt(At, 2, 1) == 1);
+  alg__elt(At, 0, 1) = 9;
+  test_that(alg__elt(M, 2, 1) == 9);
+
+  // QR factors a view in place, leaving the rest of M alone.
+  alg__Mat Q = alg__view(M, 0, 1, 3, 2);
+  alg__Mat R = alg__alloc_matrix(2, 2);
+  test_that(alg__QR(Q, R) == alg__status_ok);
+  test_that(fabs(alg__dot_prod(Q, 0, Q, 1)) < 0.001);
+  test_that(fabs(alg__norm(Q, 0) - 1) < 0.001);
+  test_that(alg__elt(M, 3, 1) == 0 && alg__elt(M, 1, 4) == 8);
+
+  // A view of a view, set and copied.
+  alg__Mat V = alg__view_cols(A, 1, 2);
+  alg__Mat W = alg__view_rows(V, 1, 1);
+  alg__set_matrix(W, 5, 6);
+  test_that(alg__elt(M, 2, 2) == 5 && alg__elt(M, 2, 3) == 6);
+  alg__Mat W2 = alg__copy_matrix(W);
+  test_that(W2->is_view == 0 && W2->ld == 2 && alg__elt(W2, 0, 1) == 6);
+
+  test_that(alg__view(M, 3, 0, 2, 1) == NULL);
+  test_that(alg__view_cols(M, -1, 2) == NULL);
+
+  // A struct built by hand without ld, as before there was one, still works,
+  // along with its views and transpose.
+  float lit_data[] = { 4, 4, 1,
+                       8, 0, 1 };
+  alg__MatStruct lit   = { .data = lit_data, .nrows = 2, .ncols = 3 };
+  alg__MatStruct lit_t = { .data = lit_data, .nrows = 2, .ncols = 3, .is_transposed = 1 };
+  alg__Mat L = &lit, Lt = &lit_t;
+  test_that(alg__ld(L) == 3 && alg__elt(L, 1, 0) == 8 && alg__elt(L, 0, 2) == 1);
+  test_that(alg__elt(Lt, 2, 0) == 1 && alg__elt(Lt, 0, 1) == 8);
+  test_that(alg__l1_min(L, b, x) == alg__status_ok);
+  test_that(fabs(alg__elt(x, 0, 0) - 1) < 0.001 && fabs(alg__elt(x, 1, 0) - 1) < 0.001);
+  alg__Mat lit_col = alg__view_cols(L, 2, 1);
+  test_that(lit_col->ld == 3 && alg__elt(lit_col, 1, 0) == 1);
+  alg__free_matrix(lit_col);
+
+  alg__free_matrix(W2);
+  alg__free_matrix(W);
+  alg__free_matrix(V);
+  alg__free_matrix(R);
+  alg__free_matrix(Q);
+  alg__free_matrix(At);
+  alg__free_matrix(c);
+  alg__free_matrix(x);
+  alg__free_matrix(X);
+  alg__free_matrix(b);
+  alg__free_matrix(A);
+  alg__free_matrix(M);
+
+  return test_success;
+}
+
 // TODO Also test R.
 
 int test_QR() {
@@ -116,6 +331,85 @@ int test_QR() {
   return test_success;
 }
 
+int test_QR_methods() {
+  // This is large enough for several panels and threaded updates, and tall
+  // enough for TSQR to split it into row blocks.
+  int m = 600, n = 70;
+  alg__Mat A = alg__alloc_matrix(m, n);
+  for (int i = 0; i < m; ++i) {
+    for (int j = 0; j < n; ++j) alg__elt(A, i, j) = sinf(i * 0.37f + j * j * 0.11f) + (i == j);
+  }
+  alg__Mat Q = alg__alloc_matrix(m, n);
+  alg__Mat R = alg__alloc_matrix(n, n);
+
+  alg__QRMethod methods[] = { alg__qr_auto, alg__qr_householder, alg__qr_tsqr,
+                              alg__qr_gram_schmidt };
+  for (int t = 0; t < 4; ++t) {
+    memcpy(Q->data, A->data, m * n * sizeof(float));
+    alg__QROptions opts = { .method = methods[t], .num_threads = 3 };
+    alg__Status status = alg__QR_opts(Q, R, &opts);
+    test_that(status == alg__status_ok);
+
+    // Check that Q R = A, that Q is orthonormal, and that R is upper
+    // triangular with a nonnegative diagonal.
+    float max_err = 0;
+    for (int i = 0; i < m; ++i) {
+      for (int j = 0; j < n; ++j) {
+        float sum = 0;
+        for (int k = 0; k <= j; ++k) sum += alg__elt(Q, i, k) * alg__elt(R, k, j);
+        max_err = fmaxf(max_err, fabsf(sum - alg__elt(A, i, j)));
+      }
+    }
+    test_that(max_err < 0.001);
+    for (int i = 0; i < n; ++i) {
+      test_that(alg__elt(R, i, i) >= 0);
+      for (int j = 0; j < i; ++j) test_that(alg__elt(R, i, j) == 0);
+      for (int j = i; j < n; ++j) {
+        test_that(fabs(alg__dot_prod(Q, i, Q, j) - (i == j)) < 0.001);
+      }
+    }
+  }
+
+  // A transposed input gives the same factors.
+  alg__Mat At = alg__alloc_matrix(n, m);
+  At->is_transposed = 1;
+  for (int i = 0; i < m; ++i) {
+    for (int j = 0; j < n; ++j) alg__elt(At, i, j) = alg__elt(A, i, j);
+  }
+  alg__Mat R2 = alg__alloc_matrix(n, n);
+  alg__QR(At, R2);
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) test_that(fabs(alg__elt(R, i, j) - alg__elt(R2, i, j)) < 0.01);
+  }
+
+  // A repeated column is linearly dependent.
+  for (int i = 0; i < m; ++i) alg__elt(At, i, n - 1) = alg__elt(At, i, 3);
+  test_that(alg__QR(At, NULL) == alg__status_lin_dep);
+
+  // The l2 solvers use the same factorization; here A is tall, so Ax = b
+  // has a solution only for b in the column span of A.
+  alg__Mat x = alg__alloc_matrix(n, 1);
+  alg__Mat b = alg__alloc_matrix(m, 1);
+  for (int i = 0; i < m; ++i) {
+    alg__elt(b, i, 0) = 0;
+    for (int j = 0; j < n; ++j) alg__elt(b, i, 0) += alg__elt(A, i, j) * (j % 3);
+  }
+  test_that(alg__l2_min(A, b, x) == alg__status_ok);
+  for (int j = 0; j < n; ++j) test_that(fabs(alg__elt(x, j, 0) - (j % 3)) < 0.001);
+  alg__elt(b, 0, 0) += 1;
+  test_that(alg__l2_min(A, b, x) == alg__status_no_soln);
+
+  alg__free_matrix(b);
+  alg__free_matrix(x);
+  alg__free_matrix(R2);
+  alg__free_matrix(At);
+  alg__free_matrix(R);
+  alg__free_matrix(Q);
+  alg__free_matrix(A);
+
+  return test_success;
+}
+
 int test_lp_pt1() {
   alg__Mat A = alg__alloc_matrix(1, 2);
   alg__set_matrix(A, 1, 5);
@@ -185,6 +479,49 @@ int test_l2_min() {
   return test_success;
 }
 
+int test_l2_factor() {
+  // These are the rows of A from test_l2_min, plus their sum, which makes
+  // the third row redundant.
+  alg__Mat A = alg__alloc_matrix(3, 3);
+  alg__set_matrix(A,  5,  2,  3,
+                      1,  4, -3,
+                      6,  6,  0 );
+  alg__L2Factor F = alg__l2_factor(A);
+
+  // We expect the answers x = (1 1 0)^T and 2x.
+  alg__Mat B = alg__alloc_matrix(3, 2);
+  alg__set_matrix(B,  7, 14,
+                      5, 10,
+                     12, 24 );
+  alg__Mat X = alg__alloc_matrix(3, 2);
+  alg__Status status = alg__l2_solve(F, B, X);
+  test_that(status == alg__status_ok);
+
+  float ans[] = { 1, 1, 0 };
+  for (int i = 0; i < 3; ++i) {
+    test_that(fabs(alg__elt(X, i, 0) - ans[i]) < 0.001);
+    test_that(fabs(alg__elt(X, i, 1) - 2 * ans[i]) < 0.001);
+  }
+
+  // Now the redundant row disagrees with the others.
+  alg__elt(B, 2, 1) = 25;
+  status = alg__l2_solve(F, B, X);
+  test_that(status == alg__status_no_soln);
+
+  // B and X need matching shapes.
+  alg__Mat x = alg__alloc_matrix(3, 1);
+  status = alg__l2_solve(F, B, x);
+  test_that(status == alg__status_input_error);
+
+  alg__free_matrix(x);
+  alg__free_matrix(X);
+  alg__free_matrix(B);
+  alg__free_l2_factor(F);
+  alg__free_matrix(A);
+
+  return test_success;
+}
+
 int test_l2_error_cases() {
   alg__Mat A = alg__alloc_matrix(1, 1);
   alg__Mat b = alg__alloc_matrix(2, 1);
@@ -197,6 +534,9 @@ int test_l2_error_cases() {
 
   alg__free_matrix(A);
   A = alg__alloc_matrix(2, 2);
+  alg__set_matrix(A, 1, 0,
+                     0, 1);
+  alg__set_matrix(b, 1, 2);
 
   status = alg__l2_min(A, b, NULL);
   test_that(status == alg__status_input_error);
@@ -207,6 +547,246 @@ int test_l2_error_cases() {
   return test_success;
 }
 
+// Returns the largest entry of |A^T (b - A x)| over the largest |A^T b|,
+// which is zero at the least squares solution x.
+static float lsq_error(alg__Mat A, alg__Mat b, alg__Mat x) {
+  int m = A->nrows, n = A->ncols;
+  float err = 0, scale = 0;
+  for (int j = 0; j < n; ++j) {
+    double g = 0, atb = 0;
+    for (int i = 0; i < m; ++i) {
+      double r = alg__elt(b, i, 0);
+      for (int k = 0; k < n; ++k) r -= alg__elt(A, i, k) * alg__elt(x, k, 0);
+      g   += alg__elt(A, i, j) * r;
+      atb += alg__elt(A, i, j) * alg__elt(b, i, 0);
+    }
+    err   = fmaxf(err, fabs(g));
+    scale = fmaxf(scale, fabs(atb));
+  }
+  return err / scale;
+}
+
+int test_l2_lsq() {
+  // A 400 x 6 problem is solved by the normal equations, a 9 x 6 one by QR,
+  // and a 400 x 6 one with two nearly equal columns by QR as well, as its
+  // normal equations are badly conditioned. None of them has Ax = b.
+  int rows[] = { 400, 9, 400 }, n = 6;
+  for (int t = 0; t < 3; ++t) {
+    int m = rows[t];
+    alg__Mat A = alg__alloc_matrix(m, n);
+    alg__Mat b = alg__alloc_matrix(m, 1);
+    alg__Mat x = alg__alloc_matrix(n, 1);
+    for (int i = 0; i < m; ++i) {
+      for (int j = 0; j < n; ++j) alg__elt(A, i, j) = sinf(i * 0.37f + j * j * 0.11f) + (i == j);
+      if (t == 2) alg__elt(A, i, n - 1) = alg__elt(A, i, 0) + 0.001f * cosf(i * 0.7f);
+      alg__elt(b, i, 0) = cosf(i * 0.23f) + 2;
+    }
+    test_that(alg__l2_lsq(A, b, x) == alg__status_ok);
+    test_that(lsq_error(A, b, x) < 1e-4);
+
+    // With b = A x, alg__l2_min finds the same x, and with a context it
+    // stays within alg__scratch_bytes.
+    for (int i = 0; i < m; ++i) {
+      alg__elt(b, i, 0) = 0;
+      for (int j = 0; j < n; ++j) alg__elt(b, i, 0) += alg__elt(A, i, j) * alg__elt(x, j, 0);
+    }
+    alg__Mat x2 = alg__alloc_matrix(n, 1);
+    alg__Context ctx = alg__alloc_context();
+    test_that(alg__l2_min_ctx(ctx, A, b, x2) == alg__status_ok);
+    test_that(ctx->scratch_want <= alg__scratch_bytes(alg__problem_l2, m, n, NULL));
+    for (int j = 0; j < n; ++j) test_that(fabs(alg__elt(x2, j, 0) - alg__elt(x, j, 0)) < 0.01);
+    alg__free_context(ctx);
+    alg__free_matrix(x2);
+    alg__free_matrix(x);
+    alg__free_matrix(b);
+    alg__free_matrix(A);
+  }
+
+  // A wide A, whose least norm solution comes from the normal equations,
+  // gets the same answer from alg__l2_min as from the QR factors.
+  alg__Mat A = alg__alloc_matrix(5, 40);
+  alg__Mat b = alg__alloc_matrix(5, 1);
+  alg__Mat x = alg__alloc_matrix(40, 1);
+  alg__Mat x2 = alg__alloc_matrix(40, 1);
+  for (int i = 0; i < 5; ++i) {
+    for (int j = 0; j < 40; ++j) alg__elt(A, i, j) = sinf(i * 1.3f + j * 0.29f) + (i == j);
+    alg__elt(b, i, 0) = i + 1;
+  }
+  test_that(alg__l2_min(A, b, x) == alg__status_ok);
+  alg__L2Factor F = alg__l2_factor(A);
+  test_that(alg__l2_solve(F, b, x2) == alg__status_ok);
+  for (int j = 0; j < 40; ++j) test_that(fabs(alg__elt(x, j, 0) - alg__elt(x2, j, 0)) < 1e-4);
+  alg__free_l2_factor(F);
+
+  // The tall problem needs full column rank, and a wide one is an error.
+  alg__Mat At = alg__view_transpose(A);
+  alg__Mat b2 = alg__alloc_matrix(40, 1);
+  alg__Mat x5 = alg__alloc_matrix(5, 1);
+  for (int i = 0; i < 40; ++i) alg__elt(At, i, 4) = alg__elt(At, i, 1);
+  test_that(alg__l2_lsq(At, b2, x5) == alg__status_lin_dep);
+  test_that(alg__l2_lsq(A, b, x) == alg__status_input_error);
+
+  alg__free_matrix(x5);
+  alg__free_matrix(b2);
+  alg__free_matrix(At);
+  alg__free_matrix(x2);
+  alg__free_matrix(x);
+  alg__free_matrix(b);
+  alg__free_matrix(A);
+
+  return test_success;
+}
+
+// Checks that F, after its updates, matches a fresh factorization of A:
+// the same R as alg__QR, and least squares solutions for b.
+static int check_qr_factor(alg__QRFactor F, alg__Mat A, alg__Mat b) {
+  int n = A->ncols;
+  alg__Mat Q  = alg__copy_matrix(A);
+  alg__Mat R  = alg__alloc_matrix(n, n);
+  alg__Mat R2 = alg__alloc_matrix(n, n);
+  alg__Mat x  = alg__alloc_matrix(n, 1);
+  test_that(alg__QR(Q, R) == alg__status_ok);
+  test_that(alg__qr_get_R(F, R2) == alg__status_ok);
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) test_that(fabs(alg__elt(R, i, j) - alg__elt(R2, i, j)) < 1e-3);
+  }
+  test_that(alg__qr_solve(F, b, x) == alg__status_ok);
+  test_that(lsq_error(A, b, x) < 1e-4);
+  alg__free_matrix(x);
+  alg__free_matrix(R2);
+  alg__free_matrix(R);
+  alg__free_matrix(Q);
+  return test_success;
+}
+
+int test_qr_updates() {
+  // A window of 40 rows slides down the rows of data, one row at a time,
+  // over the first n columns.
+  int m = 40, n = 5, num_rows = 70;
+  alg__Mat data = alg__alloc_matrix(num_rows, n + 1);
+  alg__Mat y    = alg__alloc_matrix(num_rows, 1);
+  for (int i = 0; i < num_rows; ++i) {
+    for (int j = 0; j <= n; ++j) alg__elt(data, i, j) = sinf(i * 0.37f + j * j * 0.11f) + (i % 7 == j);
+    alg__elt(y, i, 0) = cosf(i * 0.23f) + 2;
+  }
+  alg__Mat A = alg__view(data, 0, 0, m, n);
+  alg__QRFactor F = alg__qr_factor(A);
+  alg__free_matrix(A);
+  for (int t = 1; t + m <= num_rows; ++t) {
+    alg__Mat row = alg__view(data, t + m - 1, 0, 1, n);
+    test_that(alg__qr_add_row(F, row) == alg__status_ok);
+    test_that(alg__qr_remove_row(F, 0) == alg__status_ok);
+    alg__free_matrix(row);
+    if (t % 10 != 0) continue;
+    A = alg__view(data, t, 0, m, n);
+    alg__Mat b = alg__view(y, t, 0, m, 1);
+    check_qr_factor(F, A, b);
+    alg__free_matrix(b);
+    alg__free_matrix(A);
+  }
+
+  // The last window gains column n, and then loses column 1.
+  int t = num_rows - m;
+  alg__Mat col = alg__view(data, t, n, m, 1);
+  alg__Mat b   = alg__view(y, t, 0, m, 1);
+  test_that(alg__qr_add_col(F, col) == alg__status_ok);
+  A = alg__view(data, t, 0, m, n + 1);
+  check_qr_factor(F, A, b);
+  alg__free_matrix(A);
+  test_that(alg__qr_remove_col(F, 1) == alg__status_ok);
+  A = alg__alloc_matrix(m, n);
+  for (int i = 0; i < m; ++i) {
+    for (int j = 0; j < n; ++j) alg__elt(A, i, j) = alg__elt(data, t + i, j + (j >= 1));
+  }
+  check_qr_factor(F, A, b);
+
+  // A repeated column makes the solve fail until it's removed again.
+  alg__Mat x = alg__alloc_matrix(n + 1, 1);
+  alg__Mat a0 = alg__view(A, 0, 0, m, 1);
+  test_that(alg__qr_add_col(F, a0) == alg__status_ok);
+  test_that(alg__qr_solve(F, b, x) == alg__status_lin_dep);
+  test_that(alg__qr_remove_col(F, n) == alg__status_ok);
+  check_qr_factor(F, A, b);
+
+  // Sizes and indices are checked.
+  test_that(alg__qr_add_row(F, a0) == alg__status_input_error);
+  test_that(alg__qr_remove_row(F, m) == alg__status_input_error);
+  test_that(alg__qr_remove_col(F, -1) == alg__status_input_error);
+  test_that(alg__qr_solve(F, b, x) == alg__status_input_error);
+
+  alg__free_matrix(a0);
+  alg__free_matrix(x);
+  alg__free_matrix(A);
+  alg__free_matrix(b);
+  alg__free_matrix(col);
+  alg__free_qr_factor(F);
+  alg__free_matrix(y);
+  alg__free_matrix(data);
+
+  return test_success;
+}
+
+int test_rls() {
+  // The rows arrive in chunks of several sizes, some of which cross the
+  // blocks that alg__rls_add works in. The answers should match those of
+  // alg__l2_lsq on all of the rows, weighted by sqrt(forget)^(later rows).
+  int m = 600, n = 5, chunks[] = { 2, 1, 7, 300, 290 };
+  float forgets[] = { 1, 0.995f };
+  alg__Mat A  = alg__alloc_matrix(m, n);
+  alg__Mat b  = alg__alloc_matrix(m, 1);
+  alg__Mat Aw = alg__alloc_matrix(m, n);
+  alg__Mat bw = alg__alloc_matrix(m, 1);
+  alg__Mat x  = alg__alloc_matrix(n, 1);
+  alg__Mat x2 = alg__alloc_matrix(n, 1);
+  for (int i = 0; i < m; ++i) {
+    for (int j = 0; j < n; ++j) alg__elt(A, i, j) = sinf(i * 0.37f + j * j * 0.11f) + (i % 7 == j);
+    alg__elt(b, i, 0) = cosf(i * 0.23f) + 2;
+  }
+  for (int f = 0; f < 2; ++f) {
+    alg__RLS S = alg__alloc_rls(n, forgets[f]);
+    int i0 = 0;
+    for (int c = 0; c < 5; ++c) {
+      alg__Mat X = alg__view(A, i0, 0, chunks[c], n);
+      alg__Mat y = alg__view(b, i0, 0, chunks[c], 1);
+      test_that(alg__rls_add(S, X, y) == alg__status_ok);
+      alg__free_matrix(y);
+      alg__free_matrix(X);
+      i0 += chunks[c];
+      // Until there are n rows, x isn't determined.
+      if (i0 < n) test_that(alg__rls_solve(S, x) == alg__status_lin_dep);
+    }
+    test_that(alg__rls_solve(S, x) == alg__status_ok);
+
+    double rss = 0;
+    for (int i = 0; i < m; ++i) {
+      float w = powf(sqrtf(forgets[f]), m - 1 - i);
+      for (int j = 0; j < n; ++j) alg__elt(Aw, i, j) = w * alg__elt(A, i, j);
+      alg__elt(bw, i, 0) = w * alg__elt(b, i, 0);
+    }
+    test_that(alg__l2_lsq(Aw, bw, x2) == alg__status_ok);
+    for (int j = 0; j < n; ++j) test_that(fabs(alg__elt(x, j, 0) - alg__elt(x2, j, 0)) < 1e-3);
+    for (int i = 0; i < m; ++i) {
+      double r = alg__elt(bw, i, 0);
+      for (int j = 0; j < n; ++j) r -= alg__elt(Aw, i, j) * alg__elt(x, j, 0);
+      rss += r * r;
+    }
+    test_that(fabs(alg__rls_residual(S) - sqrt(rss)) < 1e-3 * sqrt(rss));
+
+    test_that(alg__rls_add(S, x, b) == alg__status_input_error);
+    test_that(alg__rls_solve(S, b) == alg__status_input_error);
+    alg__free_rls(S);
+  }
+
+  alg__free_matrix(x2);
+  alg__free_matrix(x);
+  alg__free_matrix(bw);
+  alg__free_matrix(Aw);
+  alg__free_matrix(b);
+  alg__free_matrix(A);
+
+  return test_success;
+}
+
 int test_no_soln_cases() {
   // We'll set up Ax=b to have so solutions.
   // Specifically, A=0 and b=1.
@@ -225,6 +805,9 @@ int test_no_soln_cases() {
   status = alg__l2_min(A, b, x);
   test_that(status == alg__status_no_soln);
 
+  status = alg__linf_min(A, b, x);
+  test_that(status == alg__status_no_soln);
+
   alg__Mat c = alg__alloc_matrix(1, 1);
   status = alg__run_lp(A, b, x, c);
   test_that(status == alg__status_no_soln);
@@ -317,16 +900,1393 @@ int test_linf_min() {
   test_that(fabs(alg__elt(x, 0, 0) - -1) < 0.001);
   test_that(fabs(alg__elt(x, 1, 0) -  1) < 0.001);
 
+  // The set of solutions of x0 + x1 + 2 x2 = 8, x0 - x1 = 0 is
+  // (4 4 0) + t(-1 -1 1), and x = (2 2 2)^T has the least ||x||_inf.
+  alg__Mat A2 = alg__alloc_matrix(2, 3);
+  alg__set_matrix(A2, 1,  1, 2,
+                      1, -1, 0 );
+  alg__Mat b2 = alg__alloc_matrix(2, 1);
+  alg__set_matrix(b2, 8, 0);
+  alg__Mat x2 = alg__alloc_matrix(3, 1);
+
+  status = alg__linf_min(A2, b2, x2);
+  test_that(status == alg__status_ok);
+  for (int j = 0; j < 3; ++j) test_that(fabs(alg__elt(x2, j, 0) - 2) < 0.001);
+
+  // With b = 0, the answer is x = 0.
+  alg__set_matrix(b2, 0, 0);
+  status = alg__linf_min(A2, b2, x2);
+  test_that(status == alg__status_ok);
+  for (int j = 0; j < 3; ++j) test_that(alg__elt(x2, j, 0) == 0);
+
+  // This A is nonsingular, and its only solution has ||x||_inf in the
+  // hundreds, so without scaling, w = 1 / ||x||_inf is small enough that
+  // x = z / w magnifies the simplex roundoff past the residual test.
+  alg__Mat A3 = alg__alloc_matrix(4, 4);
+  alg__set_matrix(A3, -0.08,  10,    7,   -9,
+                      -7,      0.05, -10,  4,
+                      -0.02,  -1,    8,   -7,
+                      -6,     -8,   -7,    0.03 );
+  alg__Mat b3 = alg__alloc_matrix(4, 1);
+  alg__set_matrix(b3, -1, 1800, -16, -200);
+  alg__Mat x3 = alg__alloc_matrix(4, 1);
+  alg__Mat y3 = alg__alloc_matrix(4, 1);
+
+  status = alg__linf_min(A3, b3, x3);
+  test_that(status == alg__status_ok);
+  test_that(alg__l2_min(A3, b3, y3) == alg__status_ok);
+  for (int j = 0; j < 4; ++j) {
+    test_that(fabs(alg__elt(x3, j, 0) - alg__elt(y3, j, 0)) < 0.001 * fabs(alg__elt(y3, j, 0)) + 0.01);
+  }
+
+  alg__free_matrix(y3);
+  alg__free_matrix(x3);
+  alg__free_matrix(b3);
+  alg__free_matrix(A3);
+  alg__free_matrix(x2);
+  alg__free_matrix(b2);
+  alg__free_matrix(A2);
+
+  return test_success;
+}
+
+int test_revised_lp() {
+  alg__LPOptions opts = { .algorithm = alg__lp_revised, .refactor_freq = 2 };
+
+  // This is the problem from test_lp_pt2.
+  alg__Mat A = alg__alloc_matrix(3, 5);
+  alg__set_matrix(A,  1,  0,  0,  0,  1,
+                      0,  1,  0,  4, -5,
+                      0,  0,  1, -4,  1 );
+  alg__Mat b = alg__alloc_matrix(3, 1);
+  alg__set_matrix(b, 7, -7, -5);
+  alg__Mat c = alg__alloc_matrix(5, 1);
+  alg__set_matrix(c, 0, 0, 0, 3, 2);
+  alg__Mat x = alg__alloc_matrix(5, 1);
+
+  alg__Status status = alg__run_lp_opts(A, b, x, c, &opts);
+  test_that(status == alg__status_ok);
+
+  float ans[] = { 4, 0, 0, 2, 3 };
+  for (int i = 0; i < 5; ++i) {
+    test_that(fabs(alg__elt(x, i, 0) - ans[i]) < 0.001);
+  }
+
+  alg__free_matrix(x);
+  alg__free_matrix(c);
+  alg__free_matrix(b);
+  alg__free_matrix(A);
+
+  // The second row is redundant, so an artificial variable can't be pivoted
+  // out of the basis after phase 1. We expect x = (0 1)^T as in test_lp_pt1.
+  A = alg__alloc_matrix(2, 2);
+  alg__set_matrix(A, 1, 5,
+                     2, 10);
+  b = alg__alloc_matrix(2, 1);
+  alg__set_matrix(b, 5, 10);
+  c = alg__alloc_matrix(2, 1);
+  alg__set_matrix(c, 1, 1);
+  x = alg__alloc_matrix(2, 1);
+
+  status = alg__run_lp_opts(A, b, x, c, &opts);
+  test_that(status == alg__status_ok);
+  test_that(fabs(alg__elt(x, 0, 0) - 0) < 0.001);
+  test_that(fabs(alg__elt(x, 1, 0) - 1) < 0.001);
+
+  // Now there are no solutions.
+  alg__set_matrix(b, 5, 11);
+  status = alg__run_lp_opts(A, b, x, c, &opts);
+  test_that(status == alg__status_no_soln);
+
+  // And now the solution set is unbounded.
+  alg__set_matrix(A, 1, 0,
+                     2, 0);
+  alg__set_matrix(b, 1, 2);
+  alg__set_matrix(c, -1, -1);
+  status = alg__run_lp_opts(A, b, x, c, &opts);
+  test_that(status == alg__status_unbdd_soln);
+
+  alg__free_matrix(x);
+  alg__free_matrix(c);
+  alg__free_matrix(b);
+  alg__free_matrix(A);
+
+  return test_success;
+}
+
+int test_bounded_lp() {
+  // Minimize -x0 - x1 with x0 + x1 + x2 = 3 and x0, x1 in [0, 1]. Both x0
+  // and x1 stop at their upper bounds without becoming basic.
+  alg__Mat A = alg__alloc_matrix(1, 3);
+  alg__set_matrix(A, 1, 1, 1);
+  alg__Mat b = alg__alloc_matrix(1, 1);
+  alg__set_matrix(b, 3);
+  alg__Mat c = alg__alloc_matrix(3, 1);
+  alg__set_matrix(c, -1, -1, 0);
+  alg__Mat hi = alg__alloc_matrix(3, 1);
+  alg__set_matrix(hi, 1, 1, INFINITY);
+  alg__Mat x = alg__alloc_matrix(3, 1);
+
+  alg__Status status = alg__run_lp_bounded(A, b, x, c, NULL, hi, NULL);
+  test_that(status == alg__status_ok);
+  for (int j = 0; j < 3; ++j) test_that(fabs(alg__elt(x, j, 0) - 1) < 0.001);
+
+  // Minimizing -x0 - 2 x1 with x0 + x1 + x2 = 1.5, x0, x1 in [0, 1], and
+  // x2 = 0 ends with x1 leaving the basis at its upper bound. Refactoring
+  // after every pivot checks that the refactor sees x1 there.
+  alg__LPOptions opts = { .refactor_freq = 1 };
+  alg__set_matrix(b, 1.5);
+  alg__set_matrix(c, -1, -2, 0);
+  alg__set_matrix(hi, 1, 1, 0);
+  status = alg__run_lp_bounded(A, b, x, c, NULL, hi, &opts);
+  test_that(status == alg__status_ok);
+  test_that(fabs(alg__elt(x, 0, 0) - 0.5) < 0.001);
+  test_that(fabs(alg__elt(x, 1, 0) - 1.0) < 0.001);
+
+  // With x0 free, x1 = 0, and x2 in [1, 5], maximizing x0 in
+  // x0 - x1 - x2 = -8 gives x = (-3, 0, 5).
+  alg__set_matrix(A, 1, -1, -1);
+  alg__set_matrix(b, -8);
+  alg__set_matrix(c, -1, 0, 0);
+  alg__Mat lo = alg__alloc_matrix(3, 1);
+  alg__set_matrix(lo, -INFINITY, 0, 1);
+  alg__set_matrix(hi, INFINITY, 0, 5);
+  status = alg__run_lp_bounded(A, b, x, c, lo, hi, NULL);
+  test_that(status == alg__status_ok);
+  test_that(fabs(alg__elt(x, 0, 0) - -3) < 0.001);
+  test_that(fabs(alg__elt(x, 1, 0) -  0) < 0.001);
+  test_that(fabs(alg__elt(x, 2, 0) -  5) < 0.001);
+
+  // Since x2 >= 1, x0 <= -8 leaves no feasible point.
+  alg__set_matrix(hi, -8, 0, 5);
+  status = alg__run_lp_bounded(A, b, x, c, lo, hi, NULL);
+  test_that(status == alg__status_no_soln);
+
+  // Without an upper bound on x2, x0 is unbounded above.
+  alg__set_matrix(hi, INFINITY, INFINITY, INFINITY);
+  status = alg__run_lp_bounded(A, b, x, c, lo, hi, NULL);
+  test_that(status == alg__status_unbdd_soln);
+
+  // Crossed bounds are an input error.
+  alg__set_matrix(lo, 0, 2, 0);
+  alg__set_matrix(hi, 1, 1, 1);
+  status = alg__run_lp_bounded(A, b, x, c, lo, hi, NULL);
+  test_that(status == alg__status_input_error);
+
+  alg__free_matrix(lo);
+  alg__free_matrix(x);
+  alg__free_matrix(hi);
+  alg__free_matrix(c);
+  alg__free_matrix(b);
+  alg__free_matrix(A);
+
+  return test_success;
+}
+
+int test_pricing() {
+  // This is Beale's example, on which Dantzig's rule with a naive tie break
+  // cycles. The optimal value is -1/20 at x = (3/100 0 0 1/25 0 1 0)^T.
+  alg__Mat A = alg__alloc_matrix(3, 7);
+  alg__set_matrix(A, 1, 0, 0, 0.25,  -60, -0.04, 9,
+                     0, 1, 0, 0.5,   -90, -0.02, 3,
+                     0, 0, 1, 0,       0,  1,    0 );
+  alg__Mat b = alg__alloc_matrix(3, 1);
+  alg__set_matrix(b, 0, 0, 1);
+  alg__Mat c = alg__alloc_matrix(7, 1);
+  alg__set_matrix(c, 0, 0, 0, -0.75, 150, -0.02, 6);
+  alg__Mat x = alg__alloc_matrix(7, 1);
+
+  alg__Pricing rules[] = { alg__pricing_bland, alg__pricing_dantzig, alg__pricing_partial,
+                           alg__pricing_devex, alg__pricing_steepest };
+  for (int alg = alg__lp_tableau; alg <= alg__lp_revised; ++alg) {
+    for (int i = 0; i < 5; ++i) {
+      alg__LPOptions opts = { .algorithm = alg, .pricing = rules[i],
+                              .partial_size = 2, .stall_limit = 4 };
+      alg__Status status = alg__run_lp_opts(A, b, x, c, &opts);
+      test_that(status == alg__status_ok);
+      test_that(fabs(alg__dot_prod(c, 0, x, 0) + 0.05) < 0.001);
+      test_that(fabs(alg__elt(x, 5, 0) - 1) < 0.001);
+    }
+  }
+
+  alg__free_matrix(x);
+  alg__free_matrix(c);
+  alg__free_matrix(b);
+  alg__free_matrix(A);
+
+  return test_success;
+}
+
+// A xorshift64* generator, as in algbench, for problems too big to write out.
+static uint64_t rand_state;
+
+static float rand_unit() {
+  rand_state ^= rand_state >> 12;
+  rand_state ^= rand_state << 25;
+  rand_state ^= rand_state >> 27;
+  return (double)((rand_state * 2685821657736338717ULL) >> 11) / 9007199254740992.0;
+}
+
+int test_lp_roundoff() {
+  // This LP is feasible and bounded: b = A x0 with x0 >= 0, and c = A^T y + s
+  // with s >= 0. Over its pivots, the tableau's objective row drifts enough
+  // to give columns positive scores with no pivot row, which once made it
+  // look unbounded.
+  int m = 64, n = 192;
+  rand_state = 7920;
+  alg__Mat A = alg__alloc_matrix(m, n);
+  alg__Mat b = alg__alloc_matrix(m, 1);
+  alg__Mat c = alg__alloc_matrix(n, 1);
+  alg__Mat x = alg__alloc_matrix(n, 1);
+  alg__Mat y = alg__alloc_matrix(n, 1);
+  for (int i = 0; i < m; ++i) {
+    for (int j = 0; j < n; ++j) alg__elt(A, i, j) = 2 * rand_unit() - 1;
+    alg__elt(b, i, 0) = 0;
+  }
+  for (int j = 0; j < n; ++j) {
+    float x0 = (rand_unit() < 0.5 ? 0 : rand_unit());
+    for (int i = 0; i < m; ++i) alg__elt(b, i, 0) += alg__elt(A, i, j) * x0;
+  }
+  float dual[64];
+  for (int i = 0; i < m; ++i) dual[i] = 2 * rand_unit() - 1;
+  for (int j = 0; j < n; ++j) {
+    alg__elt(c, j, 0) = rand_unit();
+    for (int i = 0; i < m; ++i) alg__elt(c, j, 0) += alg__elt(A, i, j) * dual[i];
+  }
+
+  alg__LPOptions revised_opts = { .algorithm = alg__lp_revised };
+  test_that(alg__run_lp_opts(A, b, y, c, &revised_opts) == alg__status_ok);
+  float best = alg__dot_prod(c, 0, y, 0);
+  for (int rule = alg__pricing_bland; rule <= alg__pricing_steepest; ++rule) {
+    alg__LPOptions opts = { .algorithm = alg__lp_tableau, .pricing = rule };
+    test_that(alg__run_lp_opts(A, b, x, c, &opts) == alg__status_ok);
+    test_that(fabs(alg__dot_prod(c, 0, x, 0) - best) < 0.001 * (1 + fabs(best)));
+  }
+
+  alg__free_matrix(y);
+  alg__free_matrix(x);
+  alg__free_matrix(c);
+  alg__free_matrix(b);
+  alg__free_matrix(A);
+
+  return test_success;
+}
+
+int test_threaded_pivots() {
+  // The phase 2 tableau of this LP is 33 x 32770, which is big enough for its
+  // pivots to be split across threads. Each row of a pivot is computed the
+  // same way on any thread, so the answers match exactly.
+  int m = 32, n = 32768;
+  rand_state = 2021;
+  alg__Mat A = alg__alloc_matrix(m, n);
+  alg__Mat b = alg__alloc_matrix(m, 1);
+  alg__Mat c = alg__alloc_matrix(n, 1);
+  alg__Mat x = alg__alloc_matrix(n, 1);
+  alg__Mat y = alg__alloc_matrix(n, 1);
+  for (int i = 0; i < m; ++i) {
+    for (int j = 0; j < n; ++j) alg__elt(A, i, j) = 2 * rand_unit() - 1;
+    alg__elt(b, i, 0) = 0;
+  }
+  for (int j = 0; j < n; j += 64) {
+    for (int i = 0; i < m; ++i) alg__elt(b, i, 0) += alg__elt(A, i, j);
+  }
+  for (int j = 0; j < n; ++j) alg__elt(c, j, 0) = rand_unit();
+
+  alg__LPOptions opts = { .algorithm = alg__lp_tableau, .pricing = alg__pricing_dantzig,
+                          .num_threads = 1 };
+  test_that(alg__run_lp_opts(A, b, x, c, &opts) == alg__status_ok);
+  opts.num_threads = 4;
+  test_that(alg__run_lp_opts(A, b, y, c, &opts) == alg__status_ok);
+  for (int j = 0; j < n; ++j) test_that(alg__elt(x, j, 0) == alg__elt(y, j, 0));
+  test_that(alg__dot_prod(c, 0, x, 0) == alg__dot_prod(c, 0, y, 0));
+
+  alg__free_matrix(y);
+  alg__free_matrix(x);
+  alg__free_matrix(c);
+  alg__free_matrix(b);
+  alg__free_matrix(A);
+
+  return test_success;
+}
+
+int test_warm_start() {
+  // This is the problem from test_lp_pt2.
+  alg__Mat A = alg__alloc_matrix(3, 5);
+  alg__set_matrix(A,  1,  0,  0,  0,  1,
+                      0,  1,  0,  4, -5,
+                      0,  0,  1, -4,  1 );
+  alg__Mat b = alg__alloc_matrix(3, 1);
+  alg__Mat c = alg__alloc_matrix(5, 1);
+  alg__set_matrix(c, 0, 0, 0, 3, 2);
+  alg__Mat x = alg__alloc_matrix(5, 1);
+  alg__Mat y = alg__alloc_matrix(5, 1);
+
+  for (int alg = alg__lp_tableau; alg <= alg__lp_revised; ++alg) {
+    alg__Basis basis = alg__alloc_basis();
+    alg__LPOptions opts = { .algorithm = alg, .basis = basis };
+
+    alg__set_matrix(b, 7, -7, -5);
+    alg__Status status = alg__run_lp_opts(A, b, x, c, &opts);
+    test_that(status == alg__status_ok);
+
+    // The optimal basis {0, 3, 4} stays feasible, and so optimal, for this b.
+    alg__set_matrix(b, 8, -7, -5);
+    status = alg__run_lp_opts(A, b, x, c, &opts);
+    test_that(status == alg__status_ok);
+    float ans[] = { 5, 0, 0, 2, 3 };
+    for (int i = 0; i < 5; ++i) {
+      test_that(fabs(alg__elt(x, i, 0) - ans[i]) < 0.001);
+    }
+
+    // Here that basis is infeasible, so we expect the same answer as a cold
+    // start.
+    alg__set_matrix(b, 7, -7, 3);
+    status = alg__run_lp_opts(A, b, x, c, &opts);
+    test_that(status == alg__status_ok);
+    alg__LPOptions cold_opts = { .algorithm = alg };
+    status = alg__run_lp_opts(A, b, y, c, &cold_opts);
+    test_that(status == alg__status_ok);
+    for (int i = 0; i < 5; ++i) {
+      test_that(fabs(alg__elt(x, i, 0) - alg__elt(y, i, 0)) < 0.001);
+    }
+
+    // A basis for a different shape of A is ignored.
+    alg__Mat A2 = alg__alloc_matrix(1, 2);
+    alg__set_matrix(A2, 1, 1);
+    alg__Mat b2 = alg__alloc_matrix(1, 1);
+    alg__set_matrix(b2, 3);
+    alg__Mat c2 = alg__alloc_matrix(2, 1);
+    alg__set_matrix(c2, 2, 1);
+    alg__Mat x2 = alg__alloc_matrix(2, 1);
+    status = alg__run_lp_opts(A2, b2, x2, c2, &opts);
+    test_that(status == alg__status_ok);
+    test_that(fabs(alg__elt(x2, 0, 0) - 0) < 0.001);
+    test_that(fabs(alg__elt(x2, 1, 0) - 3) < 0.001);
+
+    alg__free_matrix(x2);
+    alg__free_matrix(c2);
+    alg__free_matrix(b2);
+    alg__free_matrix(A2);
+    alg__free_basis(basis);
+  }
+
+  alg__free_matrix(y);
+  alg__free_matrix(x);
+  alg__free_matrix(c);
+  alg__free_matrix(b);
+  alg__free_matrix(A);
+
+  return test_success;
+}
+
+int test_dual_simplex() {
+  // Maximize x0 + 1.1 x1 with x0 + 2 x1 <= 4 and 3 x0 + x1 <= 6, using
+  // slack columns. The optimum is x = (1.6, 1.2).
+  alg__Mat A = alg__alloc_matrix(2, 4);
+  alg__set_matrix(A, 1, 2, 1, 0,
+                     3, 1, 0, 1 );
+  alg__Mat b = alg__alloc_matrix(2, 1);
+  alg__set_matrix(b, 4, 6);
+  alg__Mat c = alg__alloc_matrix(4, 1);
+  alg__set_matrix(c, -1, -1.1, 0, 0);
+  alg__Mat x = alg__alloc_matrix(4, 1);
+
+  alg__Basis basis = alg__alloc_basis();
+  alg__LPOptions opts = { .algorithm = alg__lp_revised, .basis = basis };
+  alg__Status status = alg__run_lp_opts(A, b, x, c, &opts);
+  test_that(status == alg__status_ok);
+  test_that(fabs(alg__elt(x, 0, 0) - 1.6) < 0.001);
+  test_that(fabs(alg__elt(x, 1, 0) - 1.2) < 0.001);
+
+  // Add the cut x0 + x1 <= 2.5 with a new row and slack column. The optimum
+  // moves to x = (1, 1.5).
+  alg__Mat A2 = alg__alloc_matrix(3, 5);
+  alg__set_matrix(A2, 1, 2, 1, 0, 0,
+                      3, 1, 0, 1, 0,
+                      1, 1, 0, 0, 1 );
+  alg__Mat b2 = alg__alloc_matrix(3, 1);
+  alg__set_matrix(b2, 4, 6, 2.5);
+  alg__Mat c2 = alg__alloc_matrix(5, 1);
+  alg__set_matrix(c2, -1, -1.1, 0, 0, 0);
+  alg__Mat x2 = alg__alloc_matrix(5, 1);
+  alg__Mat y2 = alg__alloc_matrix(5, 1);
+
+  alg__extend_basis(basis, 1, 1);
+  status = alg__run_lp_opts(A2, b2, x2, c2, &opts);
+  test_that(status == alg__status_ok);
+  test_that(fabs(alg__elt(x2, 0, 0) - 1.0) < 0.001);
+  test_that(fabs(alg__elt(x2, 1, 0) - 1.5) < 0.001);
+
+  // Tightening the cut to x0 + x1 <= 1 gives the same answer as a cold start.
+  alg__set_matrix(b2, 4, 6, 1);
+  status = alg__run_lp_opts(A2, b2, x2, c2, &opts);
+  test_that(status == alg__status_ok);
+  alg__LPOptions cold_opts = { .algorithm = alg__lp_revised };
+  status = alg__run_lp_opts(A2, b2, y2, c2, &cold_opts);
+  test_that(status == alg__status_ok);
+  for (int i = 0; i < 5; ++i) test_that(fabs(alg__elt(x2, i, 0) - alg__elt(y2, i, 0)) < 0.001);
+
+  // The cut x0 + x1 <= -1 leaves no feasible point.
+  alg__set_matrix(b2, 4, 6, -1);
+  status = alg__run_lp_opts(A2, b2, x2, c2, &opts);
+  test_that(status == alg__status_no_soln);
+
+  alg__free_basis(basis);
+  alg__free_matrix(y2);
+  alg__free_matrix(x2);
+  alg__free_matrix(c2);
+  alg__free_matrix(b2);
+  alg__free_matrix(A2);
+  alg__free_matrix(x);
+  alg__free_matrix(c);
+  alg__free_matrix(b);
+  alg__free_matrix(A);
+
+  return test_success;
+}
+
+int test_interior_lp() {
+  // This is the problem from test_lp_pt2, whose answer is a unique vertex.
+  alg__Mat A = alg__alloc_matrix(3, 5);
+  alg__set_matrix(A,  1,  0,  0,  0,  1,
+                      0,  1,  0,  4, -5,
+                      0,  0,  1, -4,  1 );
+  alg__Mat b = alg__alloc_matrix(3, 1);
+  alg__set_matrix(b, 7, -7, -5);
+  alg__Mat c = alg__alloc_matrix(5, 1);
+  alg__set_matrix(c, 0, 0, 0, 3, 2);
+  alg__Mat x = alg__alloc_matrix(5, 1);
+  float ans[] = { 4, 0, 0, 2, 3 };
+
+  alg__LPOptions opts = { .algorithm = alg__lp_interior };
+  alg__Status status = alg__run_lp_opts(A, b, x, c, &opts);
+  test_that(status == alg__status_ok);
+  for (int i = 0; i < 5; ++i) test_that(fabs(alg__elt(x, i, 0) - ans[i]) < 0.001);
+
+  // The crossover ends at the vertex itself, and stores its basis.
+  alg__Basis basis = alg__alloc_basis();
+  opts = (alg__LPOptions) { .algorithm = alg__lp_interior, .crossover = 1, .basis = basis };
+  status = alg__run_lp_opts(A, b, x, c, &opts);
+  test_that(status == alg__status_ok);
+  for (int i = 0; i < 5; ++i) test_that(alg__elt(x, i, 0) == ans[i]);
+  opts = (alg__LPOptions) { .algorithm = alg__lp_revised, .basis = basis };
+  status = alg__run_lp_opts(A, b, x, c, &opts);
+  test_that(status == alg__status_ok);
+  for (int i = 0; i < 5; ++i) test_that(fabs(alg__elt(x, i, 0) - ans[i]) < 0.001);
+
+  // A repeated row makes A D A^T singular; the solve skips its copy.
+  alg__Mat A_dup = alg__alloc_matrix(4, 5);
+  alg__set_matrix(A_dup,  1,  0,  0,  0,  1,
+                          1,  0,  0,  0,  1,
+                          0,  1,  0,  4, -5,
+                          0,  0,  1, -4,  1 );
+  alg__Mat b_dup = alg__alloc_matrix(4, 1);
+  alg__set_matrix(b_dup, 7, 7, -7, -5);
+  opts = (alg__LPOptions) { .algorithm = alg__lp_interior };
+  status = alg__run_lp_opts(A_dup, b_dup, x, c, &opts);
+  test_that(status == alg__status_ok);
+  for (int i = 0; i < 5; ++i) test_that(fabs(alg__elt(x, i, 0) - ans[i]) < 0.001);
+  alg__free_matrix(b_dup);
+  alg__free_matrix(A_dup);
+
+  // The l1 problem from test_l1_min, with the interior point method chosen
+  // through a context.
+  alg__Mat A2 = alg__alloc_matrix(2, 3);
+  alg__set_matrix(A2,  4,  4,  1,
+                       8,  0,  1 );
+  alg__Mat b2 = alg__alloc_matrix(2, 1);
+  alg__set_matrix(b2, 8, 8);
+  alg__Mat x2 = alg__alloc_matrix(3, 1);
+  alg__Context ctx = alg__alloc_context();
+  ctx->lp_opts.algorithm = alg__lp_interior;
+  status = alg__l1_min_ctx(ctx, A2, b2, x2);
+  test_that(status == alg__status_ok);
+  test_that(fabs(alg__elt(x2, 0, 0) - 1) < 0.001);
+  test_that(fabs(alg__elt(x2, 1, 0) - 1) < 0.001);
+  test_that(fabs(alg__elt(x2, 2, 0) - 0) < 0.001);
+
+  // Neither x0 + x1 = -1 nor min -x0 with x0 - x1 = 1 has an answer.
+  alg__Mat A3 = alg__alloc_matrix(1, 2);
+  alg__Mat b3 = alg__alloc_matrix(1, 1);
+  alg__Mat c3 = alg__alloc_matrix(2, 1);
+  alg__Mat x3 = alg__alloc_matrix(2, 1);
+  opts = (alg__LPOptions) { .algorithm = alg__lp_interior };
+  alg__set_matrix(A3, 1, 1);
+  alg__set_matrix(b3, -1);
+  alg__set_matrix(c3, 1, 1);
+  test_that(alg__run_lp_opts(A3, b3, x3, c3, &opts) == alg__status_no_soln);
+  alg__set_matrix(A3, 1, -1);
+  alg__set_matrix(b3, 1);
+  alg__set_matrix(c3, -1, 0);
+  test_that(alg__run_lp_opts(A3, b3, x3, c3, &opts) == alg__status_unbdd_soln);
+
+  // -8 x0 - 8 x1 = 16 has no solutions with x >= 0, even though x2, which is
+  // in no row, is a ray along which c^T x falls.
+  alg__Mat A4 = alg__alloc_matrix(1, 3);
+  alg__Mat b4 = alg__alloc_matrix(1, 1);
+  alg__Mat c4 = alg__alloc_matrix(3, 1);
+  alg__Mat x4 = alg__alloc_matrix(3, 1);
+  alg__set_matrix(A4, -8, -8, 0);
+  alg__set_matrix(b4, 16);
+  alg__set_matrix(c4, 1, -2, -3);
+  test_that(alg__run_lp_opts(A4, b4, x4, c4, &opts) == alg__status_no_soln);
+
+  // x = (0, 0, 0, 3/4) + t (2, 0, 0, 1) is a feasible ray along which c^T x
+  // falls; the iterations blow up before x is a ray, and the simplex method
+  // then finds one.
+  alg__Mat A5 = alg__alloc_matrix(1, 4);
+  alg__Mat b5 = alg__alloc_matrix(1, 1);
+  alg__Mat c5 = alg__alloc_matrix(4, 1);
+  alg__Mat x5 = alg__alloc_matrix(4, 1);
+  alg__set_matrix(A5, -2, 1, 2, 4);
+  alg__set_matrix(b5, 3);
+  alg__set_matrix(c5, -4, 5, 6, 0);
+  test_that(alg__run_lp_opts(A5, b5, x5, c5, &opts) == alg__status_unbdd_soln);
+  opts.presolve = 1;
+  test_that(alg__run_lp_opts(A5, b5, x5, c5, &opts) == alg__status_unbdd_soln);
+
+  alg__free_matrix(x5);
+  alg__free_matrix(c5);
+  alg__free_matrix(b5);
+  alg__free_matrix(A5);
+  alg__free_matrix(x4);
+  alg__free_matrix(c4);
+  alg__free_matrix(b4);
+  alg__free_matrix(A4);
+  alg__free_matrix(x3);
+  alg__free_matrix(c3);
+  alg__free_matrix(b3);
+  alg__free_matrix(A3);
+  alg__free_context(ctx);
+  alg__free_matrix(x2);
+  alg__free_matrix(b2);
+  alg__free_matrix(A2);
+  alg__free_basis(basis);
+  alg__free_matrix(x);
+  alg__free_matrix(c);
+  alg__free_matrix(b);
+  alg__free_matrix(A);
+
+  return test_success;
+}
+
+int test_presolve() {
+  // Row 1 doubles row 0, row 2 is empty, row 3 fixes x4 = 2, x5 has a large
+  // entry, and x6 is in no row.
+  alg__Mat A = alg__alloc_matrix(5, 7);
+  alg__set_matrix(A,  1,  1,  1,  1,  0,    0,  0,
+                      2,  2,  2,  2,  0,    0,  0,
+                      0,  0,  0,  0,  0,    0,  0,
+                      0,  0,  0,  0,  5,    0,  0,
+                      1,  0, -1,  0,  1, 1000,  0 );
+  alg__Mat b = alg__alloc_matrix(5, 1);
+  alg__set_matrix(b, 4, 8, 0, 10, 3);
+  alg__Mat c = alg__alloc_matrix(7, 1);
+  alg__set_matrix(c, 1, 3, 2, 5, 0, 1, 1);
+  alg__Mat x = alg__alloc_matrix(7, 1);
+  float ans[] = { 2.5, 0, 1.5, 0, 2, 0, 0 };
+
+  for (int algorithm = alg__lp_tableau; algorithm <= alg__lp_interior; ++algorithm) {
+    alg__LPOptions opts = { .algorithm = algorithm, .presolve = 1 };
+    alg__Status status = alg__run_lp_opts(A, b, x, c, &opts);
+    test_that(status == alg__status_ok);
+    for (int i = 0; i < 7; ++i) test_that(fabs(alg__elt(x, i, 0) - ans[i]) < 0.001);
+  }
+
+  // The free x0 appears only in row 1, which then just defines it, and x3 is
+  // fixed at 1. The answer is x0 = x2 - x1 = -2.
+  alg__Mat A2 = alg__alloc_matrix(2, 4);
+  alg__set_matrix(A2,  0,  1,  1,  1,
+                       1,  1, -1,  0 );
+  alg__Mat b2 = alg__alloc_matrix(2, 1);
+  alg__set_matrix(b2, 3, 0);
+  alg__Mat c2 = alg__alloc_matrix(4, 1);
+  alg__set_matrix(c2, 1, 1, 1, 7);
+  alg__Mat lo = alg__alloc_matrix(4, 1);
+  alg__set_matrix(lo, -INFINITY, 0, 0, 1);
+  alg__Mat hi = alg__alloc_matrix(4, 1);
+  alg__set_matrix(hi, INFINITY, INFINITY, INFINITY, 1);
+  alg__Mat x2 = alg__alloc_matrix(4, 1);
+  alg__LPOptions opts = { .presolve = 1 };
+  alg__Status status = alg__run_lp_bounded(A2, b2, x2, c2, lo, hi, &opts);
+  test_that(status == alg__status_ok);
+  test_that(fabs(alg__elt(x2, 0, 0) + 2) < 0.001);
+  test_that(fabs(alg__elt(x2, 1, 0) - 2) < 0.001);
+  test_that(fabs(alg__elt(x2, 2, 0) - 0) < 0.001);
+  test_that(fabs(alg__elt(x2, 3, 0) - 1) < 0.001);
+
+  // The l1 and linf problems find the same answers with presolve as without.
+  alg__Mat A3 = alg__alloc_matrix(2, 3);
+  alg__set_matrix(A3,  4,  4,  1,
+                       8,  0,  1 );
+  alg__Mat b3 = alg__alloc_matrix(2, 1);
+  alg__set_matrix(b3, 8, 8);
+  alg__Mat x3 = alg__alloc_matrix(3, 1);
+  alg__Mat y3 = alg__alloc_matrix(3, 1);
+  alg__Context ctx = alg__alloc_context();
+  for (int is_linf = 0; is_linf < 2; ++is_linf) {
+    ctx->lp_opts.presolve = 0;
+    status = (is_linf ? alg__linf_min_ctx : alg__l1_min_ctx)(ctx, A3, b3, x3);
+    test_that(status == alg__status_ok);
+    ctx->lp_opts.presolve = 1;
+    status = (is_linf ? alg__linf_min_ctx : alg__l1_min_ctx)(ctx, A3, b3, y3);
+    test_that(status == alg__status_ok);
+    for (int i = 0; i < 3; ++i) test_that(fabs(alg__elt(x3, i, 0) - alg__elt(y3, i, 0)) < 0.001);
+  }
+
+  // An empty row with b_i != 0 and rows that disagree have no solutions,
+  // and an empty column with negative cost is unbounded when the rest is
+  // feasible.
+  alg__Mat A4 = alg__alloc_matrix(2, 2);
+  alg__Mat b4 = alg__alloc_matrix(2, 1);
+  alg__Mat c4 = alg__alloc_matrix(2, 1);
+  alg__Mat x4 = alg__alloc_matrix(2, 1);
+  opts = (alg__LPOptions) { .presolve = 1 };
+  alg__set_matrix(A4, 1, 1,
+                      0, 0);
+  alg__set_matrix(b4, 1, 1);
+  alg__set_matrix(c4, 1, 1);
+  test_that(alg__run_lp_opts(A4, b4, x4, c4, &opts) == alg__status_no_soln);
+  alg__set_matrix(A4, 1, 2,
+                      2, 4);
+  alg__set_matrix(b4, 1, 3);
+  test_that(alg__run_lp_opts(A4, b4, x4, c4, &opts) == alg__status_no_soln);
+  alg__set_matrix(A4, 1, 0,
+                      2, 0);
+  alg__set_matrix(b4, 1, 2);
+  alg__set_matrix(c4, 1, -1);
+  test_that(alg__run_lp_opts(A4, b4, x4, c4, &opts) == alg__status_unbdd_soln);
+
+  // Here the empty column x2 has negative cost, but -8 x0 - 8 x1 = 16 has no
+  // solutions with x >= 0.
+  alg__Mat A5 = alg__alloc_matrix(1, 3);
+  alg__Mat b5 = alg__alloc_matrix(1, 1);
+  alg__Mat c5 = alg__alloc_matrix(3, 1);
+  alg__Mat x5 = alg__alloc_matrix(3, 1);
+  alg__set_matrix(A5, -8, -8, 0);
+  alg__set_matrix(b5, 16);
+  alg__set_matrix(c5, 1, -2, -3);
+  for (int algorithm = alg__lp_tableau; algorithm <= alg__lp_interior; ++algorithm) {
+    opts = (alg__LPOptions) { .algorithm = algorithm, .presolve = 1 };
+    test_that(alg__run_lp_opts(A5, b5, x5, c5, &opts) == alg__status_no_soln);
+  }
+
+  alg__free_matrix(x5);
+  alg__free_matrix(c5);
+  alg__free_matrix(b5);
+  alg__free_matrix(A5);
+  alg__free_matrix(x4);
+  alg__free_matrix(c4);
+  alg__free_matrix(b4);
+  alg__free_matrix(A4);
+  alg__free_context(ctx);
+  alg__free_matrix(y3);
+  alg__free_matrix(x3);
+  alg__free_matrix(b3);
+  alg__free_matrix(A3);
+  alg__free_matrix(x2);
+  alg__free_matrix(hi);
+  alg__free_matrix(lo);
+  alg__free_matrix(c2);
+  alg__free_matrix(b2);
+  alg__free_matrix(A2);
+  alg__free_matrix(x);
+  alg__free_matrix(c);
+  alg__free_matrix(b);
+  alg__free_matrix(A);
+
+  return test_success;
+}
+
+typedef struct {
+  int    num_calls;
+  int    bad_phase;
+  double last_objective;
+} PivotLog;
+
+static void log_pivot(void *data, int phase, double objective, int entering, int leaving) {
+  (void)entering;
+  (void)leaving;
+  PivotLog *log = data;
+  log->num_calls++;
+  if (phase != 1 && phase != 2) log->bad_phase = 1;
+  if (phase == 2) log->last_objective = objective;
+}
+
+int test_solve_stats() {
+  alg__Mat A = alg__alloc_matrix(2, 4);
+  alg__set_matrix(A,  1,  1,  1,  0,
+                      1, -1,  0,  1 );
+  alg__Mat b = alg__alloc_matrix(2, 1);
+  alg__set_matrix(b, 4, 1);
+  alg__Mat c = alg__alloc_matrix(4, 1);
+  alg__set_matrix(c, 1, 1, -1, -1);
+  alg__Mat x = alg__alloc_matrix(4, 1);
+
+  for (int algorithm = alg__lp_tableau; algorithm <= alg__lp_revised; ++algorithm) {
+    alg__SolveStats stats;
+    PivotLog        log   = {0};
+    alg__LPOptions  opts  = { .algorithm = algorithm, .stats = &stats,
+                              .on_pivot = log_pivot, .on_pivot_data = &log };
+    alg__Status status = alg__run_lp_opts(A, b, x, c, &opts);
+    test_that(status == alg__status_ok);
+    test_that(fabs(stats.objective + 5) < 0.001);
+    test_that(stats.phase1_pivots > 0 && stats.phase2_pivots > 0);
+    test_that(log.num_calls == stats.phase1_pivots + stats.phase2_pivots);
+    test_that(!log.bad_phase);
+    test_that(fabs(log.last_objective + 5) < 0.001);
+    test_that(stats.interior_iters == 0);
+    test_that(stats.scratch_bytes > 0);
+  }
+
+  // With a context, scratch_bytes is the scratch the solve needed.
+  alg__Context ctx = alg__alloc_context();
+  alg__SolveStats stats;
+  ctx->lp_opts = (alg__LPOptions) { .algorithm = alg__lp_interior, .stats = &stats };
+  test_that(alg__run_lp_ctx(ctx, A, b, x, c) == alg__status_ok);
+  test_that(stats.interior_iters > 0);
+  test_that(fabs(stats.objective + 5) < 0.001);
+  test_that(stats.scratch_bytes > 0);
+  test_that(stats.scratch_bytes <= alg__scratch_bytes(alg__problem_lp, 2, 4, &ctx->lp_opts));
+
+  // A failed solve has no objective.
+  alg__set_matrix(b, -4, 1);
+  ctx->lp_opts.algorithm = alg__lp_revised;
+  test_that(alg__run_lp_ctx(ctx, A, b, x, c) == alg__status_no_soln);
+  test_that(isnan(stats.objective));
+
+  alg__free_context(ctx);
+  alg__free_matrix(A);
+  alg__free_matrix(b);
+  alg__free_matrix(c);
+  alg__free_matrix(x);
+
+  return test_success;
+}
+
+int test_stepped_lp() {
+  alg__Mat A = alg__alloc_matrix(2, 4);
+  alg__set_matrix(A,  1,  1,  1,  0,
+                      1, -1,  0,  1 );
+  alg__Mat b = alg__alloc_matrix(2, 1);
+  alg__set_matrix(b, 4, 1);
+  alg__Mat c = alg__alloc_matrix(4, 1);
+  alg__set_matrix(c, 1, 1, -1, -1);
+  alg__Mat x = alg__alloc_matrix(4, 1);
+  alg__Mat y = alg__alloc_matrix(4, 1);
+  float ans[] = { 0, 0, 4, 1 };
+
+  // One pivot per step takes several steps to reach the same answer.
+  alg__LPSolver solver = alg__start_lp(A, b, x, c, NULL, NULL, NULL);
+  int num_steps = 1;
+  alg__Status status;
+  while ((status = alg__step_lp(solver, 1, 0)) == alg__status_in_progress) num_steps++;
+  test_that(status == alg__status_ok);
+  test_that(num_steps > 4);
+  for (int j = 0; j < 4; ++j) test_that(fabs(alg__elt(x, j, 0) - ans[j]) < 0.001);
+  test_that(alg__step_lp(solver, 1, 0) == alg__status_ok);
+  alg__free_lp_solver(solver);
+
+  // Two solves can take turns, and a tiny time budget still makes progress.
+  alg__SolveStats stats;
+  alg__LPOptions  opts = { .stats = &stats };
+  alg__LPSolver s1 = alg__start_lp(A, b, x, c, NULL, NULL, NULL);
+  alg__LPSolver s2 = alg__start_lp(A, b, y, c, NULL, NULL, &opts);
+  alg__Status st1 = alg__status_in_progress, st2 = alg__status_in_progress;
+  while (st1 == alg__status_in_progress || st2 == alg__status_in_progress) {
+    st1 = alg__step_lp(s1, 1, 0);
+    st2 = alg__step_lp(s2, 0, 1e-9);
+  }
+  test_that(st1 == alg__status_ok && st2 == alg__status_ok);
+  for (int j = 0; j < 4; ++j) test_that(fabs(alg__elt(y, j, 0) - ans[j]) < 0.001);
+  test_that(stats.phase1_pivots + stats.phase2_pivots == 4);
+  test_that(fabs(stats.objective + 5) < 0.001);
+  alg__free_lp_solver(s1);
+  alg__free_lp_solver(s2);
+
+  // A solve can be dropped part way through.
+  solver = alg__start_lp(A, b, x, c, NULL, NULL, NULL);
+  test_that(alg__step_lp(solver, 1, 0) == alg__status_in_progress);
+  alg__free_lp_solver(solver);
+
+  // Bound flips change x but not the basis, so they don't use up a step.
+  // Here x_3 enters the basis, and then x_1 and x_2 flip to their bounds.
+  alg__Mat A_flip  = alg__alloc_matrix(1, 3);
+  alg__Mat b_flip  = alg__alloc_matrix(1, 1);
+  alg__Mat c_flip  = alg__alloc_matrix(3, 1);
+  alg__Mat x_flip  = alg__alloc_matrix(3, 1);
+  alg__Mat hi_flip = alg__alloc_matrix(3, 1);
+  alg__set_matrix(A_flip, 1, 1, 1);
+  alg__set_matrix(b_flip, 10);
+  alg__set_matrix(c_flip, -1, -2, 0);
+  alg__set_matrix(hi_flip, 1, 1, INFINITY);
+  solver = alg__start_lp(A_flip, b_flip, x_flip, c_flip, NULL, hi_flip, &opts);
+  num_steps = 1;
+  while ((status = alg__step_lp(solver, 1, 0)) == alg__status_in_progress) num_steps++;
+  test_that(status == alg__status_ok);
+  test_that(stats.bound_flips == 2);
+  test_that(num_steps == stats.phase1_pivots + stats.phase2_pivots + 1);
+  test_that(fabs(alg__elt(x_flip, 2, 0) - 8) < 0.001);
+  alg__free_lp_solver(solver);
+  alg__free_matrix(hi_flip);
+  alg__free_matrix(x_flip);
+  alg__free_matrix(c_flip);
+  alg__free_matrix(b_flip);
+  alg__free_matrix(A_flip);
+
+  // Errors come from the first step.
+  alg__Mat lo = alg__alloc_matrix(3, 1);
+  solver = alg__start_lp(A, b, x, c, lo, NULL, NULL);
+  test_that(alg__step_lp(solver, 0, 0) == alg__status_input_error);
+  alg__free_lp_solver(solver);
+  alg__set_matrix(b, -4, 1);
+  solver = alg__start_lp(A, b, x, c, NULL, NULL, NULL);
+  test_that(alg__step_lp(solver, 0, 0) == alg__status_no_soln);
+  alg__free_lp_solver(solver);
+
+  alg__free_matrix(A);
+  alg__free_matrix(b);
+  alg__free_matrix(c);
+  alg__free_matrix(x);
+  alg__free_matrix(y);
+  alg__free_matrix(lo);
+
+  return test_success;
+}
+
+int test_context() {
+  alg__Context ctx = alg__alloc_context();
+
+  // This is the problem from test_l1_min.
+  alg__Mat A = alg__alloc_matrix(2, 3);
+  alg__set_matrix(A,  4,  4,  1,
+                      8,  0,  1 );
+  alg__Mat b = alg__alloc_matrix(2, 1);
+  alg__set_matrix(b, 8, 8);
+  alg__Mat x = alg__alloc_matrix(3, 1);
+
+  alg__Status status = alg__l1_min_ctx(ctx, A, b, x);
+  test_that(status == alg__status_ok);
+  test_that(ctx->err_str == NULL);
+  test_that(fabs(alg__elt(x, 0, 0) - 1) < 0.001);
+  test_that(fabs(alg__elt(x, 1, 0) - 1) < 0.001);
+  test_that(fabs(alg__elt(x, 2, 0) - 0) < 0.001);
+
+  // The scratch memory has grown to fit, so a second solve of the same shape
+  // fits in it.
+  size_t scratch_size = ctx->scratch_size;
+  test_that(scratch_size > 0);
+  status = alg__l1_min_ctx(ctx, A, b, x);
+  test_that(status == alg__status_ok);
+  test_that(ctx->scratch_size == scratch_size);
+
+  ctx->lp_opts.algorithm = alg__lp_revised;
+  status = alg__l1_min_ctx(ctx, A, b, x);
+  test_that(status == alg__status_ok);
+  test_that(fabs(alg__elt(x, 0, 0) - 1) < 0.001);
+
+  status = alg__l2_min_ctx(ctx, A, b, x);
+  test_that(status == alg__status_ok);
+
+  // Errors are reported in the context.
+  alg__Mat y = alg__alloc_matrix(2, 1);
+  alg__set_matrix(y, 3, 4);
+  status = alg__linf_min_ctx(ctx, A, b, y);
+  test_that(status == alg__status_input_error);
+  test_that(ctx->err_str != NULL);
+  status = alg__QR_ctx(ctx, y, NULL);
+  test_that(status == alg__status_ok);
+  test_that(ctx->err_str == NULL);
+
+  alg__free_matrix(y);
+  alg__free_matrix(x);
+  alg__free_matrix(b);
+  alg__free_matrix(A);
+  alg__free_context(ctx);
+
+  return test_success;
+}
+
+int test_workspace() {
+  // These are the problems from test_lp_pt2 and test_l1_min.
+  alg__Mat A_lp = alg__alloc_matrix(3, 5);
+  alg__set_matrix(A_lp,  1,  0,  0,  0,  1,
+                         0,  1,  0,  4, -5,
+                         0,  0,  1, -4,  1 );
+  alg__Mat b_lp = alg__alloc_matrix(3, 1);
+  alg__set_matrix(b_lp, 7, -7, -5);
+  alg__Mat c_lp = alg__alloc_matrix(5, 1);
+  alg__set_matrix(c_lp, 0, 0, 0, 3, 2);
+  alg__Mat x_lp = alg__alloc_matrix(5, 1);
+
+  alg__Mat A = alg__alloc_matrix(2, 3);
+  alg__set_matrix(A,  4,  4,  1,
+                      8,  0,  1 );
+  alg__Mat b = alg__alloc_matrix(2, 1);
+  alg__set_matrix(b, 8, 8);
+  alg__Mat x = alg__alloc_matrix(3, 1);
+  alg__Mat Q = alg__alloc_matrix(3, 2);
+  alg__Mat R = alg__alloc_matrix(2, 2);
+
+  // With scratch memory of the queried size, each solve fits in it, so the
+  // context never replaces it with memory of its own.
+  alg__Basis basis = alg__alloc_basis();
+  for (int algorithm = alg__lp_tableau; algorithm <= alg__lp_interior; ++algorithm) {
+    for (int use_basis = 0; use_basis < 2; ++use_basis) {
+      alg__Context   ctx  = alg__alloc_context();
+      alg__LPOptions opts = { .algorithm = algorithm, .basis = (use_basis ? basis : NULL),
+                              .crossover = use_basis, .presolve = use_basis };
+      ctx->lp_opts = opts;
+      size_t bytes = 0;
+      alg__ProblemType types[] = { alg__problem_lp, alg__problem_l1, alg__problem_l2,
+                                   alg__problem_linf };
+      for (int i = 0; i < 4; ++i) {
+        size_t b_i = (i == 0 ? alg__scratch_bytes(types[i], 3, 5, &opts) :
+                               alg__scratch_bytes(types[i], 2, 3, &opts));
+        if (b_i > bytes) bytes = b_i;
+      }
+      if (alg__QR_scratch_bytes(3, 2) > bytes) bytes = alg__QR_scratch_bytes(3, 2);
+      test_that(bytes > 0);
+      void *mem = malloc(bytes);
+      alg__set_scratch(ctx, mem, bytes);
+
+      test_that(alg__run_lp_ctx(ctx, A_lp, b_lp, x_lp, c_lp) == alg__status_ok);
+      test_that(ctx->scratch_want <= alg__scratch_bytes(alg__problem_lp, 3, 5, &opts));
+      test_that(fabs(alg__elt(x_lp, 3, 0) - 2) < 0.001);
+
+      test_that(alg__l1_min_ctx(ctx, A, b, x) == alg__status_ok);
+      test_that(ctx->scratch_want <= alg__scratch_bytes(alg__problem_l1, 2, 3, &opts));
+      test_that(fabs(alg__elt(x, 0, 0) - 1) < 0.001);
+
+      test_that(alg__l2_min_ctx(ctx, A, b, x) == alg__status_ok);
+      test_that(ctx->scratch_want <= alg__scratch_bytes(alg__problem_l2, 2, 3, &opts));
+
+      test_that(alg__linf_min_ctx(ctx, A, b, x) == alg__status_ok);
+      test_that(ctx->scratch_want <= alg__scratch_bytes(alg__problem_linf, 2, 3, &opts));
+
+      alg__set_matrix(Q, 1, 2,
+                         3, 4,
+                         5, 6);
+      test_that(alg__QR_ctx(ctx, Q, R) == alg__status_ok);
+      test_that(ctx->scratch_want <= alg__QR_scratch_bytes(3, 2));
+
+      test_that(ctx->scratch == mem && ctx->scratch_size == bytes);
+      alg__free_context(ctx);
+      free(mem);
+    }
+  }
+
+  // Reserved scratch memory is owned by the context, and is not grown by a
+  // solve that fits.
+  alg__Context ctx = alg__alloc_context();
+  size_t bytes = alg__scratch_bytes(alg__problem_linf, 2, 3, NULL);
+  alg__reserve_scratch(ctx, bytes);
+  test_that(ctx->scratch_size == bytes);
+  test_that(alg__linf_min_ctx(ctx, A, b, x) == alg__status_ok);
+  test_that(ctx->scratch_size == bytes);
+
+  // Memory too small for a solve is not grown; the solve still succeeds.
+  char *small = malloc(64);
+  alg__set_scratch(ctx, small, 64);
+  test_that(alg__l1_min_ctx(ctx, A, b, x) == alg__status_ok);
+  test_that(ctx->scratch == small && ctx->scratch_size == 64);
+  test_that(fabs(alg__elt(x, 0, 0) - 1) < 0.001);
+
+  // Misaligned memory is used from its first 16-byte aligned address.
+  char *block = malloc(bytes + 1), *mem = block + 1;
+  alg__set_scratch(ctx, mem, bytes);
+  test_that((uintptr_t)ctx->scratch % 16 == 0);
+  test_that(ctx->scratch >= mem && ctx->scratch + ctx->scratch_size == mem + bytes);
+  test_that(alg__l1_min_ctx(ctx, A, b, x) == alg__status_ok);
+  test_that(fabs(alg__elt(x, 0, 0) - 1) < 0.001);
+  alg__free_context(ctx);
+  free(block);
+  free(small);
+
+  alg__free_basis(basis);
+  alg__free_matrix(R);
+  alg__free_matrix(Q);
+  alg__free_matrix(x);
+  alg__free_matrix(b);
+  alg__free_matrix(A);
+  alg__free_matrix(x_lp);
+  alg__free_matrix(c_lp);
+  alg__free_matrix(b_lp);
+  alg__free_matrix(A_lp);
+
+  return test_success;
+}
+
+int test_batch() {
+  // These are the problems from test_lp_pt2, test_l1_min, test_l2_min, and
+  // test_linf_min, and one with no solutions, each repeated several times.
+  alg__Mat A_lp = alg__alloc_matrix(3, 5);
+  alg__set_matrix(A_lp,  1,  0,  0,  0,  1,
+                         0,  1,  0,  4, -5,
+                         0,  0,  1, -4,  1 );
+  alg__Mat b_lp = alg__alloc_matrix(3, 1);
+  alg__set_matrix(b_lp, 7, -7, -5);
+  alg__Mat c_lp = alg__alloc_matrix(5, 1);
+  alg__set_matrix(c_lp, 0, 0, 0, 3, 2);
+
+  alg__Mat A_l1 = alg__alloc_matrix(2, 3);
+  alg__set_matrix(A_l1,  4,  4,  1,
+                         8,  0,  1 );
+  alg__Mat b_l1 = alg__alloc_matrix(2, 1);
+  alg__set_matrix(b_l1, 8, 8);
+
+  alg__Mat A_l2 = alg__alloc_matrix(2, 3);
+  alg__set_matrix(A_l2,  5,  2,  3,
+                         1,  4, -3 );
+  alg__Mat b_l2 = alg__alloc_matrix(2, 1);
+  alg__set_matrix(b_l2, 7, 5);
+
+  alg__Mat A_linf = alg__alloc_matrix(1, 2);
+  alg__set_matrix(A_linf, 1, -2);
+  alg__Mat b_linf = alg__alloc_matrix(1, 1);
+  alg__set_matrix(b_linf, -3);
+
+  alg__Mat A_none = alg__alloc_matrix(1, 1);
+  alg__set_matrix(A_none, 0);
+  alg__Mat b_none = alg__alloc_matrix(1, 1);
+  alg__set_matrix(b_none, 1);
+
+  float lp_ans[]   = { 4, 0, 0, 2, 3 };
+  float l1_ans[]   = { 1, 1, 0 };
+  float linf_ans[] = { -1, 1 };
+
+  enum { num_copies = 8, num_problems = 5 * num_copies };
+  alg__Problem problems[num_problems];
+  for (int i = 0; i < num_problems; ++i) {
+    alg__Problem *p = problems + i;
+    switch (i % 5) {
+      case 0: *p = (alg__Problem) { .type = alg__problem_lp,   .A = A_lp,   .b = b_lp,
+                                    .c = c_lp }; break;
+      case 1: *p = (alg__Problem) { .type = alg__problem_l1,   .A = A_l1,   .b = b_l1   }; break;
+      case 2: *p = (alg__Problem) { .type = alg__problem_l2,   .A = A_l2,   .b = b_l2   }; break;
+      case 3: *p = (alg__Problem) { .type = alg__problem_linf, .A = A_linf, .b = b_linf }; break;
+      case 4: *p = (alg__Problem) { .type = alg__problem_l2,   .A = A_none, .b = b_none }; break;
+    }
+    p->x = alg__alloc_matrix(p->A->ncols, 1);
+  }
+
+  alg__Status status = alg__solve_batch(problems, num_problems, 4, NULL);
+  test_that(status == alg__status_no_soln);
+
+  for (int i = 0; i < num_problems; ++i) {
+    alg__Problem *p = problems + i;
+    float *ans = NULL;
+    switch (i % 5) {
+      case 0: ans = lp_ans;   break;
+      case 1: ans = l1_ans;   break;
+      case 2: ans = l1_ans;   break;  // test_l2_min also expects (1 1 0).
+      case 3: ans = linf_ans; break;
+    }
+    if (ans == NULL) {
+      test_that(p->status == alg__status_no_soln);
+      test_that(p->err_str != NULL);
+    } else {
+      test_that(p->status == alg__status_ok);
+      test_that(p->err_str == NULL);
+      for (int r = 0; r < p->x->nrows; ++r) {
+        test_that(fabs(alg__elt(p->x, r, 0) - ans[r]) < 0.001);
+      }
+    }
+    alg__free_matrix(p->x);
+  }
+
+  alg__Mat mats[] = { A_lp, b_lp, c_lp, A_l1, b_l1, A_l2, b_l2,
+                      A_linf, b_linf, A_none, b_none };
+  for (int i = 0; i < 11; ++i) alg__free_matrix(mats[i]);
+
+  return test_success;
+}
+
+int test_sparse() {
+  // We build A = ( 5 4 0 )
+  //              ( 2 0 4 )
+  // from triplets, with the 4 in the top row split into duplicates.
+  int   rows[] = { 0, 1, 0, 1, 0 };
+  int   cols[] = { 1, 0, 1, 2, 0 };
+  float vals[] = { 1, 2, 3, 4, 5 };
+
+  alg__Mat B = alg__alloc_matrix(2, 1);
+  alg__set_matrix(B, 1, 3);
+
+  for (int is_csr = 0; is_csr < 2; ++is_csr) {
+    alg__SpMat A = alg__alloc_sparse(2, 3, 5, rows, cols, vals, is_csr);
+    test_that(A->nnz == 4);
+
+    test_that(alg__sp_dot_prod(A, 0, B, 0) == 11);
+    test_that(alg__sp_dot_prod(A, 1, B, 0) ==  4);
+    test_that(alg__sp_dot_prod(A, 2, B, 0) == 12);
+
+    alg__sp_mul_and_add(-1, A, 2, B, 0);
+    test_that(alg__elt(B, 0, 0) ==  1);
+    test_that(alg__elt(B, 1, 0) == -1);
+    alg__sp_mul_and_add( 1, A, 2, B, 0);
+
+    alg__free_sparse(A);
+  }
+  alg__free_matrix(B);
+
+  int bad_rows[] = { 0, 2 };
+  test_that(alg__alloc_sparse(2, 3, 2, bad_rows, cols, vals, 0) == NULL);
+
+  // These are the problems from test_lp_pt2, test_l1_min, test_l2_min, and
+  // test_linf_min.
+  alg__Mat A = alg__alloc_matrix(3, 5);
+  alg__set_matrix(A,  1,  0,  0,  0,  1,
+                      0,  1,  0,  4, -5,
+                      0,  0,  1, -4,  1 );
+  alg__Mat b = alg__alloc_matrix(3, 1);
+  alg__set_matrix(b, 7, -7, -5);
+  alg__Mat c = alg__alloc_matrix(5, 1);
+  alg__set_matrix(c, 0, 0, 0, 3, 2);
+  alg__Mat x = alg__alloc_matrix(5, 1);
+
+  alg__SpMat S = alg__sparse_from_matrix(A, 1);
+  test_that(S->nnz == 8);
+  alg__Status status = alg__sp_run_lp(S, b, x, c);
+  test_that(status == alg__status_ok);
+  float ans[] = { 4, 0, 0, 2, 3 };
+  for (int i = 0; i < 5; ++i) {
+    test_that(fabs(alg__elt(x, i, 0) - ans[i]) < 0.001);
+  }
+  alg__free_sparse(S);
+  alg__free_matrix(x);
+  alg__free_matrix(c);
+  alg__free_matrix(b);
+  alg__free_matrix(A);
+
+  A = alg__alloc_matrix(2, 3);
+  alg__set_matrix(A,  4,  4,  1,
+                      8,  0,  1 );
+  b = alg__alloc_matrix(2, 1);
+  alg__set_matrix(b, 8, 8);
+  x = alg__alloc_matrix(3, 1);
+  S = alg__sparse_from_matrix(A, 0);
+  status = alg__sp_l1_min(S, b, x);
+  test_that(status == alg__status_ok);
+  test_that(fabs(alg__elt(x, 0, 0) - 1) < 0.001);
+  test_that(fabs(alg__elt(x, 1, 0) - 1) < 0.001);
+  test_that(fabs(alg__elt(x, 2, 0) - 0) < 0.001);
+  alg__free_sparse(S);
+
+  alg__set_matrix(A,  5,  2,  3,
+                      1,  4, -3 );
+  alg__set_matrix(b, 7, 5);
+  S = alg__sparse_from_matrix(A, 0);
+  status = alg__sp_l2_min(S, b, x);
+  test_that(status == alg__status_ok);
+  test_that(fabs(alg__elt(x, 0, 0) - 1) < 0.001);
+  test_that(fabs(alg__elt(x, 1, 0) - 1) < 0.001);
+  test_that(fabs(alg__elt(x, 2, 0) - 0) < 0.001);
+  alg__free_sparse(S);
+
+  // A has a zero row here, so there are no solutions.
+  alg__set_matrix(A,  5,  2,  3,
+                      0,  0,  0 );
+  S = alg__sparse_from_matrix(A, 1);
+  status = alg__sp_l2_min(S, b, x);
+  test_that(status == alg__status_no_soln);
+  alg__free_sparse(S);
+  alg__free_matrix(x);
+  alg__free_matrix(b);
+  alg__free_matrix(A);
+
+  A = alg__alloc_matrix(1, 2);
+  alg__set_matrix(A, 1, -2);
+  b = alg__alloc_matrix(1, 1);
+  alg__set_matrix(b, -3);
+  x = alg__alloc_matrix(2, 1);
+  S = alg__sparse_from_matrix(A, 1);
+  status = alg__sp_linf_min(S, b, x);
+  test_that(status == alg__status_ok);
+  test_that(fabs(alg__elt(x, 0, 0) - -1) < 0.001);
+  test_that(fabs(alg__elt(x, 1, 0) -  1) < 0.001);
+  alg__free_sparse(S);
+  alg__free_matrix(x);
+  alg__free_matrix(b);
+  alg__free_matrix(A);
+
+  return test_success;
+}
+
+int test_refinement() {
+  // The 4 x 4 Hilbert matrix is ill-conditioned enough that float solves
+  // are only good to about 4 digits.
+  int n = 4;
+  alg__Mat A = alg__alloc_matrix(n, n);
+  alg__Mat b = alg__alloc_matrix64(n, 1);
+  alg__Mat x = alg__alloc_matrix64(n, 1);
+  alg__Mat c = alg__alloc_matrix(n, 1);
+  double ans[] = { 1, 2, 1, 2 };
+  for (int i = 0; i < n; ++i) {
+    alg__elt64(b, i, 0) = 0;
+    for (int j = 0; j < n; ++j) {
+      alg__elt(A, i, j) = 1.0 / (i + j + 1);
+      alg__elt64(b, i, 0) += alg__elt(A, i, j) * ans[j];
+    }
+    alg__elt(c, i, 0) = 1;
+  }
+  alg__round_matrix(b);
+
+  alg__Status status = alg__l2_min_refined(A, b, x);
+  test_that(status == alg__status_ok);
+  for (int j = 0; j < n; ++j) {
+    test_that(fabs(alg__elt64(x, j, 0) - ans[j]) < 1e-10);
+    test_that(alg__elt(x, j, 0) == (float)alg__elt64(x, j, 0));
+  }
+
+  // Since A is square, the only feasible point is the answer.
+  alg__LPAlgorithm algorithms[] = { alg__lp_tableau, alg__lp_revised };
+  for (int t = 0; t < 2; ++t) {
+    alg__LPOptions opts = { .algorithm = algorithms[t], .refine = 1 };
+    memset(x->data64, 0, n * sizeof(double));
+    status = alg__run_lp_opts(A, b, x, c, &opts);
+    test_that(status == alg__status_ok);
+    for (int j = 0; j < n; ++j) test_that(fabs(alg__elt64(x, j, 0) - ans[j]) < 1e-10);
+  }
+
+  // Refinement also works with a wide A, where it finds the min-norm x.
+  alg__Mat A2 = alg__alloc_matrix(2, 3);
+  alg__set_matrix(A2, 4, 4, 1,
+                      8, 0, 1 );
+  alg__Mat b2 = alg__alloc_matrix64(2, 1);
+  alg__set_matrix64(b2, 0.1, 0.3);
+  alg__Mat x2 = alg__alloc_matrix64(3, 1);
+  alg__L2Factor F = alg__l2_factor(A2);
+  status = alg__l2_solve_refined(F, A2, b2, x2);
+  test_that(status == alg__status_ok);
+
+  // The min-norm x = A^T y, where A A^T y = b.
+  double y0 = (0.1 * 65 - 0.3 * 33) / (33.0 * 65 - 33 * 33);
+  double y1 = (0.3 * 33 - 0.1 * 33) / (33.0 * 65 - 33 * 33);
+  double ans2[] = { 4 * y0 + 8 * y1, 4 * y0, y0 + y1 };
+  for (int j = 0; j < 3; ++j) test_that(fabs(alg__elt64(x2, j, 0) - ans2[j]) < 1e-12);
+
+  alg__Mat x3 = alg__copy_matrix(x2);
+  test_that(x3->data64 != NULL && alg__elt64(x3, 2, 0) == alg__elt64(x2, 2, 0));
+
+  alg__free_matrix(x3);
+  alg__free_l2_factor(F);
+  alg__free_matrix(x2);
+  alg__free_matrix(b2);
+  alg__free_matrix(A2);
+  alg__free_matrix(c);
+  alg__free_matrix(x);
+  alg__free_matrix(b);
+  alg__free_matrix(A);
+
+  return test_success;
+}
+
+// Returns true if A and B have the same size and entries, as matrices.
+static int same_matrix(alg__Mat A, alg__Mat B) {
+  int nrows = (A->is_transposed ? A->ncols : A->nrows);
+  int ncols = (A->is_transposed ? A->nrows : A->ncols);
+  if (nrows != (B->is_transposed ? B->ncols : B->nrows)) return 0;
+  if (ncols != (B->is_transposed ? B->nrows : B->ncols)) return 0;
+  for (int i = 0; i < nrows; ++i) {
+    for (int j = 0; j < ncols; ++j) {
+      if (alg__elt(A, i, j) != alg__elt(B, i, j)) return 0;
+    }
+  }
+  return 1;
+}
+
+int test_binary_files() {
+  char path[] = "/tmp/algtest_XXXXXX";
+  close(mkstemp(path));
+
+  // A matrix with double entries, a view with rows that aren't contiguous,
+  // and a transposed view all come back the same, double entries included.
+  int m = 37, n = 19;
+  alg__Mat A = alg__alloc_matrix64(m, n);
+  for (int i = 0; i < m; ++i) {
+    for (int j = 0; j < n; ++j) alg__elt64(A, i, j) = sin(i * 0.37 + j * j * 0.11) / 3 + (i % 9 == j % 9);
+  }
+  alg__round_matrix(A);
+  alg__Mat V  = alg__view(A, 3, 2, 20, 9);
+  alg__Mat Vt = alg__view_transpose(V);
+  alg__Mat mats[] = { A, V, Vt };
+  for (int t = 0; t < 3; ++t) {
+    test_that(alg__save_matrix(mats[t], path) == alg__status_ok);
+    alg__Mat M = alg__map_matrix(path);
+    test_that(M != NULL);
+    test_that(same_matrix(M, mats[t]));
+    test_that(M->data64 != NULL && alg__elt64(M, 0, 1) == alg__elt64(mats[t], 0, 1));
+    alg__free_matrix(M);
+  }
+
+  // A mapped matrix works in the solvers, and changes to it stay out of the
+  // file.
+  alg__Mat b  = alg__alloc_matrix(20, 1);
+  alg__Mat x  = alg__alloc_matrix(9, 1);
+  alg__Mat x2 = alg__alloc_matrix(9, 1);
+  for (int i = 0; i < 20; ++i) alg__elt(b, i, 0) = i % 3;
+  test_that(alg__save_matrix(V, path) == alg__status_ok);
+  alg__Mat M = alg__map_matrix(path);
+  test_that(alg__l2_lsq(V, b, x) == alg__status_ok);
+  test_that(alg__l2_lsq(M, b, x2) == alg__status_ok);
+  test_that(same_matrix(x, x2));
+  alg__elt(M, 0, 0) = 100;
+  alg__free_matrix(M);
+  M = alg__map_matrix(path);
+  test_that(alg__elt(M, 0, 0) == alg__elt(V, 0, 0));
+  alg__free_matrix(M);
+
+  // Sparse matrices in both forms.
+  for (int is_csr = 0; is_csr < 2; ++is_csr) {
+    alg__SpMat S = alg__sparse_from_matrix(A, is_csr);
+    test_that(alg__save_sparse(S, path) == alg__status_ok);
+    test_that(alg__map_matrix(path) == NULL);
+    alg__SpMat S2 = alg__map_sparse(path);
+    test_that(S2 != NULL);
+    test_that(S2->nrows == m && S2->ncols == n && S2->nnz == S->nnz && S2->is_csr == is_csr);
+    int nmajor = (is_csr ? m : n);
+    test_that(memcmp(S2->start, S->start, (nmajor + 1) * sizeof(int)) == 0);
+    test_that(memcmp(S2->idx,   S->idx,   S->nnz * sizeof(int))        == 0);
+    test_that(memcmp(S2->vals,  S->vals,  S->nnz * sizeof(float))      == 0);
+    alg__free_sparse(S2);
+    alg__free_sparse(S);
+  }
+
+  // Missing, truncated, and foreign files are rejected.
+  test_that(truncate(path, 100) == 0);
+  test_that(alg__map_sparse(path) == NULL);
+  FILE *f = fopen(path, "w");
+  fprintf(f, "This is not a matrix file; it is only text of some length.\n"
+             "This is not a matrix file; it is only text of some length.\n");
+  fclose(f);
+  test_that(alg__map_matrix(path) == NULL);
+  unlink(path);
+  test_that(alg__map_matrix(path) == NULL);
+
+  alg__free_matrix(x2);
+  alg__free_matrix(x);
+  alg__free_matrix(b);
+  alg__free_matrix(Vt);
+  alg__free_matrix(V);
+  alg__free_matrix(A);
+
   return test_success;
 }
 
 int main(int argc, char **argv) {
   set_verbose(0);  // Set this to 1 while debugging a test.
   start_all_tests(argv[0]);
-  run_tests(test_basic_ops, test_QR,
-            test_lp_pt1, test_lp_pt2, test_l2_min,
-            test_l2_error_cases, test_no_soln_cases,
+  run_tests(test_basic_ops, test_long_vector_ops, test_gemm, test_views, test_QR,
+            test_QR_methods, test_lp_pt1, test_lp_pt2, test_l2_min,
+            test_l2_factor, test_l2_error_cases, test_l2_lsq,
+            test_qr_updates, test_rls, test_no_soln_cases,
             test_lp_errors, test_l1_min,
-            test_linf_min);
+            test_linf_min, test_revised_lp, test_bounded_lp, test_pricing, test_lp_roundoff,
+            test_threaded_pivots,
+            test_warm_start, test_dual_simplex, test_interior_lp, test_presolve, test_solve_stats,
+            test_stepped_lp,
+            test_context, test_workspace, test_batch, test_sparse, test_refinement,
+            test_binary_files);
   return end_all_tests();
 }